@@ -1,11 +1,17 @@
+#ifndef ASYNC_DOWNLOADING_HPP
+#define ASYNC_DOWNLOADING_HPP
+
 #include <boost/asio/strand.hpp>
 #include <boost/asio/signal_set.hpp>
 #include <boost/beast/core/tcp_stream.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/core/flat_buffer.hpp>
 
+#include <charconv>
 #include <iostream>
+#include <memory_resource>
 #include <optional>
+#include <sstream>
 #include <thread>
 
 #include <multipart_form_data/multipart_form_data.hpp>
@@ -15,11 +21,84 @@ namespace asio = boost::asio;
 namespace http = boost::beast::http;      
 using tcp = boost::asio::ip::tcp;
 
+// Print the progress of the upload, it is invoked in the thread of the progress reporter.
+void print_progress(const multipart_form_data::progress_event& event)
+{
+    std::ostringstream line;
+
+    line << "upload " << event.download_id << ": " << event.received_bytes << " of " << event.content_length 
+        << " bytes, " << event.files_count << " files";
+
+    if (event.is_finished)
+    {
+        line << ", finished: " << event.result.message();
+    }
+
+    line << "\n";
+
+    std::cout << line.str();
+}
+
+// Statistics of all downloads that are shared between all sessions
+struct server_statistics
+{
+    multipart_form_data::histogram_registry latency_histograms;
+    multipart_form_data::download_registry active_downloads;
+    multipart_form_data::download_metrics metrics;
+    // Limit of the receiving rate of the whole server, it is unlimited until it is set with /rate_limit
+    multipart_form_data::token_bucket rate_limit{};
+    // Queues of the packet writes to each device of the output files
+    multipart_form_data::disk_schedulers disk_scheduling{};
+    // Files that are open at once, the rest of the descriptors is left for the connections
+    multipart_form_data::descriptor_budget file_descriptors{1024};
+    // Slows the downloads down and rejects the new ones under memory and I/O pressure
+    multipart_form_data::admission_controller admission_control{};
+    // Progress of the uploads that is printed at most once per second and per 16 MB of each upload
+    std::atomic<uint64_t> uploads_count{0};
+    multipart_form_data::progress_reporter progress{print_progress, std::chrono::seconds(1), 16 * 1024 * 1024};
+    // Threads that process the downloaded files, so the I/O threads keep reading the connections meanwhile
+    multipart_form_data::post_processing_pool post_processing{2};
+};
+
+// Format the table of active downloads
+std::string format_active_downloads(const multipart_form_data::download_registry& active_downloads)
+{
+    std::ostringstream result;
+
+    result << "id\tpeer\tphase\telapsed_ms\tidle_ms\treceived_bytes\twritten_bytes\tfiles\trate_bytes_per_second\t"
+        << "receive_rtt_us\tretransmits\treceive_window\tfile\n";
+
+    for (const multipart_form_data::download_info& download : active_downloads.snapshot())
+    {
+        result 
+            << download.id << "\t" 
+            << download.peer << "\t"
+            << multipart_form_data::to_string(download.phase) << "\t"
+            << std::chrono::duration_cast<std::chrono::milliseconds>(download.elapsed).count() << "\t"
+            << std::chrono::duration_cast<std::chrono::milliseconds>(download.idle).count() << "\t"
+            << download.bytes_received << "\t"
+            << download.bytes_written << "\t"
+            << download.files_count << "\t"
+            << download.receive_rate << "\t"
+            << download.tcp_info.receive_rtt.count() << "\t"
+            << download.tcp_info.retransmits << "\t"
+            << download.tcp_info.receive_window << "\t"
+            << download.file_path.string() << "\n";
+    }
+
+    return result.str();
+}
+
 class http_session : public std::enable_shared_from_this<http_session>
 {
     public:
-        explicit http_session(tcp::socket&& socket)
-            : _stream(std::move(socket)), _form_data{_stream, _buffer}
+        http_session(
+            tcp::socket&& socket, 
+            server_statistics& statistics, 
+            std::pmr::memory_resource& buffer_pool, 
+            size_t packets_size)
+            : _stream(std::move(socket)), _memory_resource{&buffer_pool}, _form_data{_stream, _buffer, &_memory_resource}, 
+            _statistics{statistics}, _packets_size{packets_size}, _rate_limit{0, 256 * 1024, &statistics.rate_limit}
         {
             _response.keep_alive(true);
             _response.version(11);
@@ -53,6 +132,9 @@ class http_session : public std::enable_shared_from_this<http_session>
             // Clear previous body data
             _response.body().clear();
 
+            // Clear previous content type as it is set only for some responses
+            _response.erase(http::field::content_type);
+
             // Set unlimited body to prevent "body limit exceeded" error
             _request_parser->body_limit(boost::none);
 
@@ -85,9 +167,44 @@ class http_session : public std::enable_shared_from_this<http_session>
             // Reset the timeout
             beast::get_lowest_layer(_stream).expires_never();
 
+            // Dump the states of all active downloads
+            if (_request_parser->get().target() == "/downloads")
+            {
+                _response.body() = format_active_downloads(_statistics.active_downloads);
+
+                return do_write_response(true);
+            }
+
+            // Export downloading metrics in Prometheus format
+            if (_request_parser->get().target() == "/metrics")
+            {
+                _response.set(http::field::content_type, "text/plain; version=0.0.4");
+                _response.body() = _statistics.metrics.render();
+
+                return do_write_response(true);
+            }
+
+            std::string_view target{_request_parser->get().target().data(), _request_parser->get().target().size()};
+
+            // Change the limit of the receiving rate of the whole server
+            if (target.starts_with("/rate_limit?bytes_per_second="))
+            {
+                uint64_t rate = 0;
+
+                std::from_chars(target.data() + target.find('=') + 1, target.data() + target.size(), rate);
+
+                _statistics.rate_limit.limit(rate, _statistics.rate_limit.burst());
+
+                return do_write_response(true);
+            }
+
             _form_data.async_download(
                 _request_parser->get()[http::field::content_type], 
                 {
+                    .packets_size = _packets_size,
+
+                    .adaptive_packets_size = true,
+
                     .on_read_file_header_handler = 
                         [](std::string_view file_name, int& some_data, std::string& some_string)
                         {
@@ -102,7 +219,47 @@ class http_session : public std::enable_shared_from_this<http_session>
                             some_string = "world";
                             std::cout << "body: " << some_data << "\t" << some_string << "\n";
                             std::cout << file_path << " is downloaded!\n";
-                        }
+                        },
+
+                    .latency_histograms = &_statistics.latency_histograms,
+
+                    .active_downloads = &_statistics.active_downloads,
+
+                    .metrics = &_statistics.metrics,
+
+                    .sample_tcp_info = true,
+
+                    .tune_socket = true,
+
+                    .content_length = _request_parser->content_length().value_or(0),
+
+                    .rate_limit = &_rate_limit,
+
+                    .disk_scheduling = &_statistics.disk_scheduling,
+
+                    .file_descriptors = &_statistics.file_descriptors,
+
+                    .admission_control = &_statistics.admission_control,
+
+                    .progress = &_statistics.progress,
+
+                    .progress_id = ++_statistics.uploads_count,
+
+                    .post_processing = &_statistics.post_processing,
+
+                    .on_process_file_handler = 
+                        [](const std::filesystem::path& file_path)
+                        {
+                            std::error_code error_code;
+                            std::ostringstream line;
+
+                            line << file_path << " is processed: " << std::filesystem::file_size(file_path, error_code) << " bytes\n";
+
+                            std::cout << line.str();
+                        },
+
+                    // Respond only after the files are processed
+                    .wait_for_post_processing = true
                 },
                 beast::bind_front_handler(
                     &http_session::on_download_files, 
@@ -193,14 +350,28 @@ class http_session : public std::enable_shared_from_this<http_session>
         beast::flat_buffer _buffer{};
         std::optional<http::request_parser<http::string_body>> _request_parser;
         http::response<http::string_body> _response;
+        // Pool of the connection that downloads allocate from, the session runs in the strand so it doesn't need locks.
+        // Large receive buffers are passed to the shared huge page pool
+        std::pmr::unsynchronized_pool_resource _memory_resource;
         multipart_form_data::downloader<beast::tcp_stream, beast::flat_buffer> _form_data;
+        server_statistics& _statistics;
+        size_t _packets_size;
+        // Limit of the receiving rate of the connection, it is limited by the one of the server as well
+        multipart_form_data::token_bucket _rate_limit;
 };
 
 class listener : public std::enable_shared_from_this<listener>
 {
     public:
-        listener(asio::io_context& io_context, tcp::endpoint endpoint)
-            :_io_context(io_context), _acceptor(asio::make_strand(io_context))
+        listener(
+            asio::io_context& io_context, 
+            tcp::endpoint endpoint, 
+            server_statistics& statistics,
+            std::pmr::memory_resource& buffer_pool,
+            size_t packets_size,
+            bool reuse_port = false)
+            :_io_context(io_context), _acceptor(asio::make_strand(io_context)), _statistics(statistics), 
+            _buffer_pool(buffer_pool), _packets_size(packets_size)
         {
             beast::error_code error_code;
             
@@ -218,6 +389,17 @@ class listener : public std::enable_shared_from_this<listener>
                 return;
             }
 
+            // Let acceptors of several threads listen on the same port, the kernel balances connections between them
+            if (reuse_port)
+            {
+                _acceptor.set_option(asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true), error_code);
+                if (error_code)
+                {
+                    std::cerr << error_code.message();
+                    return;
+                }
+            }
+
             _acceptor.bind(endpoint, error_code);
             if (error_code)
             {
@@ -260,7 +442,10 @@ class listener : public std::enable_shared_from_this<listener>
             {
                 // Create the session and run it
                 std::make_shared<http_session>(
-                    std::move(socket))->run();
+                    std::move(socket),
+                    _statistics,
+                    _buffer_pool,
+                    _packets_size)->run();
             }
 
             // Accept another connection
@@ -269,17 +454,88 @@ class listener : public std::enable_shared_from_this<listener>
         
         asio::io_context& _io_context;
         tcp::acceptor _acceptor;
+        server_statistics& _statistics;
+        std::pmr::memory_resource& _buffer_pool;
+        size_t _packets_size;
 };
 
+// Print latency percentiles of all downloading phases
+void print_latency_histograms(const multipart_form_data::histogram_registry& latency_histograms)
+{
+    constexpr std::pair<multipart_form_data::latency_phase, std::string_view> phases[]{
+        {multipart_form_data::latency_phase::header_parsing, "header parsing"},
+        {multipart_form_data::latency_phase::packet_reading, "packet reading"},
+        {multipart_form_data::latency_phase::packet_writing, "packet writing"},
+        {multipart_form_data::latency_phase::hook_execution, "hook execution"},
+        {multipart_form_data::latency_phase::request, "request"}};
+
+    for (const auto& [phase, name] : phases)
+    {
+        multipart_form_data::histogram histogram = latency_histograms.snapshot(phase);
+
+        std::cout 
+            << name << ": count " << histogram.count() 
+            << ", p50 " << histogram.percentile(50).count() 
+            << "ns, p99 " << histogram.percentile(99).count() 
+            << "ns, max " << histogram.max().count() << "ns\n";
+    }
+}
+
 void async_downloading_example()
 {
+    // Statistics of all downloads, they have to outlive the sessions that are destroyed with io_context
+    server_statistics statistics;
+
+    // Huge pages for receive buffers per NUMA node, they are reused by the next connections after the previous ones are closed
+    multipart_form_data::numa_pools buffer_pools;
+
+    // Run the I/O thread on the node which memory the NIC writes received packets to, if it is known,
+    // and take the buffers from the pool of this node
+    if (int numa_node = multipart_form_data::network_interface_numa_node("eth0"); numa_node >= 0)
+    {
+        std::error_code pin_error_code;
+
+        multipart_form_data::pin_thread_to_numa_node(numa_node, pin_error_code);
+
+        if (pin_error_code)
+        {
+            std::cerr << "pinning to NUMA node " << numa_node << " failed: " << pin_error_code.message() << "\n";
+        }
+    }
+
+    multipart_form_data::huge_page_pool& buffer_pool = buffer_pools.local_pool();
+
+    // Tune the packets size for the filesystem where the files are placed, 
+    // the benchmark is run only at the first start on the host and its result is cached outside of the directory,
+    // so an uploaded file can't replace it
+    std::error_code calibration_error_code;
+
+    multipart_form_data::calibration calibration = multipart_form_data::calibrate(
+        "..",
+        std::filesystem::temp_directory_path() / "multipart_form_data_calibration",
+        calibration_error_code);
+
+    if (calibration_error_code)
+    {
+        std::cerr << "calibration failed: " << calibration_error_code.message() << "\n";
+    }
+
+    std::cout 
+        << "packets size " << calibration.packets_size 
+        << ", write rate " << static_cast<uint64_t>(calibration.write_rate) 
+        << " B/s, scan rate " << static_cast<uint64_t>(calibration.scan_rate) << " B/s"
+        << (calibration.is_cached ? " (cached)\n" : "\n");
+
     // The io_context is required for all I/O
     asio::io_context io_context{1};
 
     // Create and launch a listening port
     std::make_shared<listener>(
         io_context,
-        tcp::endpoint{asio::ip::make_address("127.0.0.1"), 12345})->run();
+        tcp::endpoint{asio::ip::make_address("127.0.0.1"), 12345},
+        statistics,
+        buffer_pool,
+        calibration.packets_size)->run();
 
     // Capture SIGINT and SIGTERM to perform a clean shutdown
     asio::signal_set signals(io_context, SIGINT, SIGTERM);
@@ -293,4 +549,12 @@ void async_downloading_example()
         });
 
     io_context.run();
-}
\ No newline at end of file
+
+    print_latency_histograms(statistics.latency_histograms);
+
+    std::cout 
+        << "huge pages: NUMA node " << buffer_pool.numa_node() << ", mapped " << buffer_pool.mapped_bytes() 
+        << " bytes, reserved " << buffer_pool.reserved_huge_page_bytes() << " bytes\n";
+}
+
+#endif
\ No newline at end of file
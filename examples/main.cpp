@@ -1,8 +1,16 @@
 #include <async_downloading.hpp>
 #include <sync_downloading.hpp>
+#include <sharded_downloading.hpp>
+#include <socket_tuning_benchmark.hpp>
+#include <uring_benchmark.hpp>
 
 int main()
 {
     async_downloading_example();
     // sync_downloading_example();
+    // pooled_sync_downloading_example();
+    // sharded_downloading_example();
+    // sharded_upload_benchmark();
+    // socket_tuning_benchmark();
+    // uring_benchmark();
 }
\ No newline at end of file
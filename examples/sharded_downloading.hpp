@@ -0,0 +1,355 @@
+#ifndef SHARDED_DOWNLOADING_HPP
+#define SHARDED_DOWNLOADING_HPP
+
+#include <async_downloading.hpp>
+
+#include <boost/asio/write.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <latch>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Server that runs one shard per core. Each shard has its own io_context, thread pinned to the core, acceptor
+// on the shared port(SO_REUSEPORT), buffer pool on the NUMA node of the core and statistics, so shards share nothing
+// while they download and the kernel distributes connections between them.
+class sharded_server
+{
+    public:
+        struct shard
+        {
+            // Pool and statistics are declared before io_context to outlive the sessions that are destroyed with it
+            std::optional<multipart_form_data::huge_page_pool> buffer_pool;
+            server_statistics statistics;
+            asio::io_context io_context{1};
+            std::thread thread;
+            int cpu{0};
+        };
+
+        // Maximum amount of deallocated buffers that each shard keeps for reuse
+        static constexpr size_t shard_cached_bytes = 64 * 1024 * 1024;
+
+        /**
+         * @brief Start the shards and wait until all of them listen on the endpoint.
+         *
+         * @param shards_count number of shards, shards are pinned to the cores in order.
+         * @param endpoint endpoint that all shards listen on.
+         * @param packets_size packets size of the downloaders.
+         */
+        sharded_server(size_t shards_count, tcp::endpoint endpoint, size_t packets_size)
+        {
+            std::latch listening_shards{static_cast<std::ptrdiff_t>(shards_count)};
+
+            size_t cores_count = std::max(std::thread::hardware_concurrency(), 1u);
+
+            for (size_t i = 0; i < shards_count; ++i)
+            {
+                shard& current_shard = *_shards.emplace_back(std::make_unique<shard>());
+
+                current_shard.cpu = static_cast<int>(i % cores_count);
+                current_shard.thread = std::thread{
+                    [&current_shard, &listening_shards, endpoint, packets_size]()
+                    {
+                        run_shard(current_shard, endpoint, packets_size, listening_shards);
+                    }};
+            }
+
+            listening_shards.wait();
+        }
+
+        sharded_server(const sharded_server&) = delete;
+        sharded_server& operator=(const sharded_server&) = delete;
+
+        ~sharded_server()
+        {
+            stop();
+        }
+
+        // Stop all shards and wait for their threads.
+        void stop()
+        {
+            for (std::unique_ptr<shard>& current_shard : _shards)
+            {
+                current_shard->io_context.stop();
+            }
+
+            for (std::unique_ptr<shard>& current_shard : _shards)
+            {
+                if (current_shard->thread.joinable())
+                {
+                    current_shard->thread.join();
+                }
+            }
+        }
+
+        const std::vector<std::unique_ptr<shard>>& shards() const noexcept
+        {
+            return _shards;
+        }
+
+    private:
+        static void run_shard(
+            shard& current_shard,
+            tcp::endpoint endpoint,
+            size_t packets_size,
+            std::latch& listening_shards)
+        {
+            std::error_code pin_error_code;
+
+            multipart_form_data::pin_thread_to_cpu(current_shard.cpu, pin_error_code);
+
+            if (pin_error_code)
+            {
+                std::cerr << "pinning to CPU " << current_shard.cpu << " failed: " << pin_error_code.message() << "\n";
+            }
+
+            // Create the pool after the thread is pinned to place its memory on the node of the core
+            current_shard.buffer_pool.emplace(
+                shard_cached_bytes,
+                std::pmr::get_default_resource(),
+                multipart_form_data::current_numa_node());
+
+            std::make_shared<listener>(
+                current_shard.io_context,
+                endpoint,
+                current_shard.statistics,
+                *current_shard.buffer_pool,
+                packets_size,
+                true)->run();
+
+            listening_shards.count_down();
+
+            current_shard.io_context.run();
+        }
+
+        std::vector<std::unique_ptr<shard>> _shards{};
+};
+
+// Print the statistics of each shard and their total
+void print_shards_statistics(const sharded_server& server)
+{
+    uint64_t total_downloads = 0;
+    uint64_t total_bytes_received = 0;
+
+    for (size_t i = 0; i < server.shards().size(); ++i)
+    {
+        const sharded_server::shard& current_shard = *server.shards()[i];
+
+        std::cout
+            << "shard " << i << ": CPU " << current_shard.cpu
+            << ", NUMA node " << current_shard.buffer_pool->numa_node()
+            << ", downloads " << current_shard.statistics.metrics.downloads()
+            << ", received " << current_shard.statistics.metrics.bytes_received() << " bytes"
+            << ", mapped " << current_shard.buffer_pool->mapped_bytes() << " bytes\n";
+
+        total_downloads += current_shard.statistics.metrics.downloads();
+        total_bytes_received += current_shard.statistics.metrics.bytes_received();
+    }
+
+    std::cout << "total: downloads " << total_downloads << ", received " << total_bytes_received << " bytes\n";
+}
+
+void sharded_downloading_example(size_t shards_count = std::max(std::thread::hardware_concurrency(), 1u))
+{
+    std::error_code calibration_error_code;
+
+    multipart_form_data::calibration calibration = multipart_form_data::calibrate(
+        "..",
+        std::filesystem::temp_directory_path() / "multipart_form_data_calibration",
+        calibration_error_code);
+
+    if (calibration_error_code)
+    {
+        std::cerr << "calibration failed: " << calibration_error_code.message() << "\n";
+    }
+
+    sharded_server server{
+        shards_count,
+        tcp::endpoint{asio::ip::make_address("127.0.0.1"), 12345},
+        calibration.packets_size};
+
+    std::cout << "listening with " << shards_count << " shards\n";
+
+    // Wait for SIGINT or SIGTERM in the main thread to perform a clean shutdown
+    asio::io_context signals_context{1};
+    asio::signal_set signals(signals_context, SIGINT, SIGTERM);
+    signals.async_wait([](const beast::error_code&, int) {});
+
+    signals_context.run();
+
+    server.stop();
+
+    print_shards_statistics(server);
+}
+
+// Upload the data to the server as a file by each client concurrently for the specified number of times.
+// Return the upload throughput of all clients in bytes per second.
+double measure_upload_throughput(
+    tcp::endpoint endpoint,
+    size_t clients_count,
+    size_t uploads_per_client,
+    const std::string& data)
+{
+    constexpr std::string_view boundary{"multipart_form_data_benchmark_boundary"};
+
+    std::vector<std::thread> clients;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < clients_count; ++i)
+    {
+        clients.emplace_back(
+            [&endpoint, &data, boundary, uploads_per_client, i]()
+            {
+                // The data is shared by all clients, so only the part header and the closing boundary are their own
+                std::string part_header =
+                    "--" + std::string{boundary} + "\r\n"
+                    "Content-Disposition: form-data; name=\"file\"; "
+                    "filename=\"multipart_form_data_benchmark_" + std::to_string(i) + ".bin\"\r\n"
+                    "Content-Type: application/octet-stream\r\n\r\n";
+                std::string closing_boundary = "\r\n--" + std::string{boundary} + "--\r\n";
+
+                http::request<http::empty_body> request{http::verb::post, "/", 11};
+                request.set(http::field::content_type, "multipart/form-data; boundary=" + std::string{boundary});
+                request.content_length(part_header.size() + data.size() + closing_boundary.size());
+
+                asio::io_context io_context{1};
+                beast::error_code error_code;
+
+                // The session closes the connection after the download, so each upload uses a new one
+                for (size_t j = 0; j < uploads_per_client && !error_code; ++j)
+                {
+                    tcp::socket socket{io_context};
+
+                    socket.connect(endpoint, error_code);
+
+                    http::request_serializer<http::empty_body> serializer{request};
+
+                    if (!error_code)
+                    {
+                        http::write_header(socket, serializer, error_code);
+                    }
+
+                    if (!error_code)
+                    {
+                        asio::write(
+                            socket,
+                            std::array<asio::const_buffer, 3>{
+                                asio::buffer(part_header), asio::buffer(data), asio::buffer(closing_boundary)},
+                            error_code);
+                    }
+
+                    beast::flat_buffer buffer;
+                    http::response<http::string_body> response;
+
+                    if (!error_code)
+                    {
+                        http::read(socket, buffer, response, error_code);
+                    }
+
+                    if (!error_code && response.body().rfind("Successfully", 0) != 0)
+                    {
+                        std::cerr << "benchmark client " << i << " failed: " << response.body() << "\n";
+                        return;
+                    }
+                }
+
+                if (error_code)
+                {
+                    std::cerr << "benchmark client " << i << " failed: " << error_code.message() << "\n";
+                }
+            });
+    }
+
+    for (std::thread& client : clients)
+    {
+        client.join();
+    }
+
+    std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+    return static_cast<double>(clients_count * uploads_per_client * data.size()) / std::max(duration.count(), 1e-9);
+}
+
+/**
+ * @brief Measure how the upload throughput scales with the number of shards from 1 to the specified one,
+ * doubling it each step. Each shard is loaded by two concurrent clients, so it always has a download to serve.
+ *
+ * @param max_shards_count maximum number of shards.
+ * @param upload_size size of each uploaded file.
+ * @param uploads_per_client number of files that each client uploads.
+ */
+void sharded_upload_benchmark(
+    size_t max_shards_count = std::max(std::thread::hardware_concurrency(), 1u),
+    size_t upload_size = 64 * 1024 * 1024,
+    size_t uploads_per_client = 4)
+{
+    constexpr size_t clients_per_shard = 2;
+
+    tcp::endpoint endpoint{asio::ip::make_address("127.0.0.1"), 12346};
+
+    std::error_code calibration_error_code;
+
+    multipart_form_data::calibration calibration = multipart_form_data::calibrate(
+        "..",
+        std::filesystem::temp_directory_path() / "multipart_form_data_calibration",
+        calibration_error_code);
+
+    // Data that doesn't contain the boundary and is not compressible by the filesystem
+    std::string data(upload_size, '\0');
+
+    uint32_t state = 2463534242;
+
+    for (char& byte : data)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        byte = static_cast<char>(state);
+    }
+
+    double single_shard_throughput = 0;
+
+    for (size_t shards_count = 1; ; shards_count = std::min(shards_count * 2, max_shards_count))
+    {
+        double throughput = 0;
+
+        {
+            sharded_server server{shards_count, endpoint, calibration.packets_size};
+
+            throughput = measure_upload_throughput(endpoint, shards_count * clients_per_shard, uploads_per_client, data);
+        }
+
+        if (shards_count == 1)
+        {
+            single_shard_throughput = throughput;
+        }
+
+        std::cout
+            << "shards " << shards_count
+            << ": " << static_cast<uint64_t>(throughput / (1024 * 1024)) << " MB/s"
+            << ", speedup " << throughput / std::max(single_shard_throughput, 1e-9) << "\n";
+
+        if (shards_count == max_shards_count)
+        {
+            break;
+        }
+    }
+
+    // Remove the uploaded files that the sessions place in the parent directory
+    for (size_t i = 0; i < max_shards_count * clients_per_shard; ++i)
+    {
+        std::error_code remove_error_code;
+
+        std::filesystem::remove(
+            std::filesystem::path{".."} / ("multipart_form_data_benchmark_" + std::to_string(i) + ".bin"),
+            remove_error_code);
+    }
+}
+
+#endif
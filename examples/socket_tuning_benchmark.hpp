@@ -0,0 +1,273 @@
+#ifndef SOCKET_TUNING_BENCHMARK_HPP
+#define SOCKET_TUNING_BENCHMARK_HPP
+
+#include <boost/asio/write.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <multipart_form_data/multipart_form_data.hpp>
+
+// Stream that counts reads from the next layer. Each read stands for a wakeup of the reading by the socket,
+// so it shows how many times the downloader is woken up per amount of data.
+template<typename next_layer_t>
+class read_counting_stream
+{
+    public:
+        using executor_type = typename next_layer_t::executor_type;
+
+        template<typename ...arguments_t>
+        explicit read_counting_stream(arguments_t&&... arguments)
+            : _next_layer{std::forward<arguments_t>(arguments)...}
+        {}
+
+        next_layer_t& next_layer() noexcept
+        {
+            return _next_layer;
+        }
+
+        const next_layer_t& next_layer() const noexcept
+        {
+            return _next_layer;
+        }
+
+        executor_type get_executor() noexcept
+        {
+            return _next_layer.get_executor();
+        }
+
+        uint64_t reads_count() const noexcept
+        {
+            return _reads_count;
+        }
+
+        void reset_reads_count() noexcept
+        {
+            _reads_count = 0;
+        }
+
+        template<typename mutable_buffers_t>
+        size_t read_some(const mutable_buffers_t& buffers)
+        {
+            ++_reads_count;
+
+            return _next_layer.read_some(buffers);
+        }
+
+        template<typename mutable_buffers_t>
+        size_t read_some(const mutable_buffers_t& buffers, boost::beast::error_code& error_code)
+        {
+            ++_reads_count;
+
+            return _next_layer.read_some(buffers, error_code);
+        }
+
+        template<typename mutable_buffers_t, typename token_t>
+        auto async_read_some(const mutable_buffers_t& buffers, token_t&& token)
+        {
+            ++_reads_count;
+
+            return _next_layer.async_read_some(buffers, std::forward<token_t>(token));
+        }
+
+        template<typename const_buffers_t>
+        size_t write_some(const const_buffers_t& buffers)
+        {
+            return _next_layer.write_some(buffers);
+        }
+
+        template<typename const_buffers_t>
+        size_t write_some(const const_buffers_t& buffers, boost::beast::error_code& error_code)
+        {
+            return _next_layer.write_some(buffers, error_code);
+        }
+
+        template<typename const_buffers_t, typename token_t>
+        auto async_write_some(const const_buffers_t& buffers, token_t&& token)
+        {
+            return _next_layer.async_write_some(buffers, std::forward<token_t>(token));
+        }
+
+    private:
+        next_layer_t _next_layer;
+        uint64_t _reads_count{0};
+};
+
+// Result of one run of the socket tuning benchmark
+struct socket_tuning_result
+{
+    uint64_t reads_count{0};
+    double throughput{0};
+    bool is_successful{false};
+};
+
+// Upload the file of the specified size over loopback by small paced writes, the way slow clients do, and download it 
+// with the specified tuning. Return the number of reads of the request body and the throughput in bytes per second.
+socket_tuning_result measure_socket_tuning(
+    bool tune_socket, 
+    size_t upload_size, 
+    size_t write_size, 
+    std::chrono::microseconds write_interval,
+    size_t packets_size)
+{
+    namespace asio = boost::asio;
+    namespace beast = boost::beast;
+    namespace http = beast::http;
+    using tcp = asio::ip::tcp;
+
+    constexpr std::string_view boundary{"multipart_form_data_benchmark_boundary"};
+
+    asio::io_context io_context{1};
+    tcp::acceptor acceptor{io_context, tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}};
+
+    socket_tuning_result result;
+
+    std::filesystem::path file_path = std::filesystem::temp_directory_path() / "multipart_form_data_benchmark.bin";
+
+    std::thread server{
+        [&]()
+        {
+            read_counting_stream<tcp::socket> stream{io_context};
+            beast::flat_buffer buffer;
+            http::request_parser<http::empty_body> request_parser;
+            beast::error_code error_code;
+
+            // Set unlimited body to prevent "body limit exceeded" error
+            request_parser.body_limit(boost::none);
+
+            acceptor.accept(stream.next_layer(), error_code);
+
+            if (!error_code)
+            {
+                http::read_header(stream, buffer, request_parser, error_code);
+            }
+
+            if (error_code)
+            {
+                std::cerr << "benchmark server failed: " << error_code.message() << "\n";
+                return;
+            }
+
+            // Count only the reads of the request body
+            stream.reset_reads_count();
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            multipart_form_data::downloader<read_counting_stream<tcp::socket>, beast::flat_buffer> form_data{stream, buffer};
+
+            form_data.sync_download(
+                request_parser.get()[http::field::content_type],
+                {
+                    .packets_size = packets_size,
+
+                    .on_read_file_header_handler =
+                        [&file_path](std::string_view)
+                        {
+                            return file_path;
+                        },
+
+                    .tune_socket = tune_socket,
+
+                    .content_length = request_parser.content_length().value_or(0)
+                },
+                error_code);
+
+            std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+            if (error_code)
+            {
+                std::cerr << "benchmark server failed: " << error_code.message() << "\n";
+                return;
+            }
+
+            result.reads_count = stream.reads_count();
+            result.throughput = static_cast<double>(upload_size) / std::max(duration.count(), 1e-9);
+            result.is_successful = true;
+        }};
+
+    tcp::socket socket{io_context};
+    beast::error_code error_code;
+
+    socket.connect(acceptor.local_endpoint(), error_code);
+
+    // Send each write right away as a separate segment
+    socket.set_option(tcp::no_delay(true), error_code);
+
+    std::string part_header =
+        "--" + std::string{boundary} + "\r\n"
+        "Content-Disposition: form-data; name=\"file\"; filename=\"benchmark.bin\"\r\n\r\n";
+    std::string closing_boundary = "\r\n--" + std::string{boundary} + "--\r\n";
+
+    http::request<http::empty_body> request{http::verb::post, "/", 11};
+    request.set(http::field::content_type, "multipart/form-data; boundary=" + std::string{boundary});
+    request.content_length(part_header.size() + upload_size + closing_boundary.size());
+
+    http::request_serializer<http::empty_body> serializer{request};
+    http::write_header(socket, serializer, error_code);
+
+    asio::write(socket, asio::buffer(part_header), error_code);
+
+    std::string data(write_size, 'x');
+
+    for (size_t written_size = 0; written_size < upload_size && !error_code; written_size += write_size)
+    {
+        asio::write(socket, asio::buffer(data.data(), std::min(write_size, upload_size - written_size)), error_code);
+
+        std::this_thread::sleep_for(write_interval);
+    }
+
+    asio::write(socket, asio::buffer(closing_boundary), error_code);
+
+    server.join();
+
+    std::error_code remove_error_code;
+    std::filesystem::remove(file_path, remove_error_code);
+
+    return result;
+}
+
+/**
+ * @brief Compare the number of reads per GB and the throughput of the downloading with and without the socket tuning.
+ *
+ * @param upload_size size of the uploaded file.
+ * @param write_size size of each write of the client.
+ * @param write_interval pause of the client after each write.
+ * @param packets_size packets size of the downloader, the low watermark is a part of it.
+ */
+void socket_tuning_benchmark(
+    size_t upload_size = 1024 * 1024 * 1024,
+    size_t write_size = 8 * 1024,
+    std::chrono::microseconds write_interval = std::chrono::microseconds{20},
+    size_t packets_size = 4 * 1024 * 1024)
+{
+    constexpr double gigabyte = 1024 * 1024 * 1024;
+
+    for (bool tune_socket : {false, true})
+    {
+        socket_tuning_result result = measure_socket_tuning(
+            tune_socket, 
+            upload_size, 
+            write_size, 
+            write_interval, 
+            packets_size);
+
+        if (!result.is_successful)
+        {
+            continue;
+        }
+
+        std::cout
+            << (tune_socket ? "tuned: " : "untuned: ")
+            << static_cast<uint64_t>(static_cast<double>(result.reads_count) * gigabyte / static_cast<double>(upload_size))
+            << " reads per GB, " << static_cast<uint64_t>(result.throughput / (1024 * 1024)) << " MB/s\n";
+    }
+}
+
+#endif
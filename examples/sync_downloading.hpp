@@ -4,9 +4,19 @@
 #include <boost/beast/http.hpp>
 #include <boost/beast/core/flat_buffer.hpp>
 
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <thread>
+#include <vector>
+
+#include <poll.h>
 
 #include <multipart_form_data/multipart_form_data.hpp>
 
@@ -15,16 +25,176 @@ namespace http = beast::http;
 namespace asio = boost::asio;
 using tcp = boost::asio::ip::tcp;
 
-// Handles an HTTP server connection
-void do_session(tcp::socket& socket)
+// Socket whose blocking reads and writes fail with asio::error::timed_out once the expiry passes. Blocking operations
+// of tcp::socket can't time out(asio waits in poll again after SO_RCVTIMEO expires), so the socket is in non-blocking mode
+// and each operation polls for the readiness with the rest of the time before the expiry. The downloader sets the expiry
+// by operations_timeout before each read, so a client that stops sending doesn't hold the thread.
+class deadline_socket
+{
+    public:
+        using executor_type = tcp::socket::executor_type;
+
+        explicit deadline_socket(asio::io_context& io_context)
+            : _socket{io_context}
+        {}
+
+        // Take the accepted connection, its operations don't expire until the expiry is set.
+        void assign(tcp::socket&& socket)
+        {
+            beast::error_code error_code;
+
+            _socket = std::move(socket);
+            _socket.non_blocking(true, error_code);
+            _expiry.reset();
+        }
+
+        executor_type get_executor() noexcept
+        {
+            return _socket.get_executor();
+        }
+
+        tcp::socket::native_handle_type native_handle()
+        {
+            return _socket.native_handle();
+        }
+
+        void expires_after(std::chrono::steady_clock::duration timeout)
+        {
+            _expiry = std::chrono::steady_clock::now() + timeout;
+        }
+
+        void expires_never()
+        {
+            _expiry.reset();
+        }
+
+        template<typename mutable_buffer_sequence>
+        size_t read_some(const mutable_buffer_sequence& buffers, beast::error_code& error_code)
+        {
+            return transfer(POLLIN, [this, &buffers, &error_code]() { return _socket.read_some(buffers, error_code); }, error_code);
+        }
+
+        template<typename mutable_buffer_sequence>
+        size_t read_some(const mutable_buffer_sequence& buffers)
+        {
+            beast::error_code error_code;
+            size_t bytes_transferred = read_some(buffers, error_code);
+
+            if (error_code)
+            {
+                throw beast::system_error{error_code};
+            }
+
+            return bytes_transferred;
+        }
+
+        template<typename const_buffer_sequence>
+        size_t write_some(const const_buffer_sequence& buffers, beast::error_code& error_code)
+        {
+            return transfer(POLLOUT, [this, &buffers, &error_code]() { return _socket.write_some(buffers, error_code); }, error_code);
+        }
+
+        template<typename const_buffer_sequence>
+        size_t write_some(const const_buffer_sequence& buffers)
+        {
+            beast::error_code error_code;
+            size_t bytes_transferred = write_some(buffers, error_code);
+
+            if (error_code)
+            {
+                throw beast::system_error{error_code};
+            }
+
+            return bytes_transferred;
+        }
+
+        void shutdown(tcp::socket::shutdown_type type, beast::error_code& error_code)
+        {
+            _socket.shutdown(type, error_code);
+        }
+
+        void close(beast::error_code& error_code)
+        {
+            _socket.close(error_code);
+        }
+
+    private:
+        // Repeat the non-blocking operation until it isn't blocked or the expiry passes.
+        template<typename operation_t>
+        size_t transfer(short events, operation_t operation, beast::error_code& error_code)
+        {
+            for (;;)
+            {
+                size_t bytes_transferred = operation();
+
+                if (error_code != asio::error::would_block)
+                {
+                    return bytes_transferred;
+                }
+
+                int timeout = -1;
+
+                if (_expiry)
+                {
+                    timeout = static_cast<int>(std::max<int64_t>(
+                        std::chrono::ceil<std::chrono::milliseconds>(*_expiry - std::chrono::steady_clock::now()).count(), 
+                        0));
+                }
+
+                pollfd socket_events{.fd = _socket.native_handle(), .events = events, .revents = 0};
+
+                int result = ::poll(&socket_events, 1, timeout);
+
+                if (result == 0)
+                {
+                    error_code = asio::error::timed_out;
+
+                    return 0;
+                }
+
+                if (result < 0 && errno != EINTR)
+                {
+                    error_code = beast::error_code{errno, boost::system::generic_category()};
+
+                    return 0;
+                }
+            }
+        }
+
+        tcp::socket _socket;
+        std::optional<std::chrono::steady_clock::time_point> _expiry{};
+};
+
+// Limit the next blocking operations of the stream if the stream can time out.
+template<typename stream_t>
+void expire_after(stream_t& stream, std::chrono::milliseconds timeout)
+{
+    if constexpr (requires { stream.expires_after(timeout); })
+    {
+        if (timeout != std::chrono::milliseconds::zero())
+        {
+            stream.expires_after(timeout);
+        }
+    }
+}
+
+// Handles requests of an HTTP server connection with the buffer and the downloader that can be reused 
+// for the next connections. If the stream can time out and the idle timeout is set then the connection is closed 
+// when the next request header doesn't come in time, and the reads of the request body are limited by 
+// the operations timeout.
+template<typename stream_t>
+void serve_connection(
+    stream_t& socket, 
+    beast::flat_buffer& buffer, 
+    multipart_form_data::downloader<stream_t, beast::flat_buffer>& form_data,
+    std::chrono::milliseconds idle_timeout = std::chrono::milliseconds::zero(),
+    std::chrono::steady_clock::duration operations_timeout = std::chrono::seconds(30))
 {
     beast::error_code error_code;
 
     int some_data = 5;
-    beast::flat_buffer buffer;
     std::optional<http::request_parser<http::string_body>> request_parser;
     http::response<http::string_body> response;
-    multipart_form_data::downloader form_data{socket, buffer};
 
     for(;;)
     {
@@ -41,6 +211,9 @@ void do_session(tcp::socket& socket)
         // Clear the buffer for each request
         buffer.clear();
 
+        // Wait for the next request, its header has to come in whole within the idle timeout
+        expire_after(socket, idle_timeout);
+
         // Read a request
         http::read_header(socket, buffer, *request_parser, error_code);
         
@@ -52,6 +225,7 @@ void do_session(tcp::socket& socket)
         std::vector<std::filesystem::path> file_paths = form_data.sync_download(
             request_parser->get()[http::field::content_type], 
             {
+                .operations_timeout = operations_timeout,
                 .on_read_file_header_handler = 
                     [](std::string_view file_name, int& some_data, std::string& some_string)
                     {
@@ -90,7 +264,8 @@ void do_session(tcp::socket& socket)
         response.result(200);
         response.prepare_payload();
 
-        // Send the response
+        // Send the response, the client that doesn't read it doesn't hold the connection longer than the idle timeout
+        expire_after(socket, idle_timeout);
         http::write(socket, response, error_code);
 
         if (error_code)
@@ -105,6 +280,15 @@ void do_session(tcp::socket& socket)
     // At this point the connection is closed gracefully
 }
 
+// Handles an HTTP server connection
+void do_session(tcp::socket& socket)
+{
+    beast::flat_buffer buffer;
+    multipart_form_data::downloader form_data{socket, buffer};
+
+    serve_connection(socket, buffer, form_data);
+}
+
 //------------------------------------------------------------------------------
 
 void sync_downloading_example()
@@ -133,4 +317,186 @@ void sync_downloading_example()
     {
         std::cerr << ex.what() << "\n";
     }
-}
\ No newline at end of file
+}
+
+//------------------------------------------------------------------------------
+
+// Queue of accepted connections that wait for a free worker. Its capacity is the admission limit, 
+// connections that don't fit are rejected right away instead of waiting for a worker indefinitely.
+class connection_queue
+{
+    public:
+        explicit connection_queue(size_t capacity)
+            : _capacity{capacity}
+        {}
+
+        // Move the socket to the queue if there is room for it, otherwise leave it to the caller.
+        bool try_push(tcp::socket& socket)
+        {
+            {
+                std::lock_guard lock{_mutex};
+
+                if (_is_closed || _sockets.size() >= _capacity)
+                {
+                    return false;
+                }
+
+                _sockets.push_back(std::move(socket));
+            }
+
+            _condition.notify_one();
+
+            return true;
+        }
+
+        // Wait for the next connection, there is none if the queue is closed.
+        std::optional<tcp::socket> pop()
+        {
+            std::unique_lock lock{_mutex};
+
+            _condition.wait(lock, [this]() { return _is_closed || !_sockets.empty(); });
+
+            if (_sockets.empty())
+            {
+                return std::nullopt;
+            }
+
+            std::optional<tcp::socket> socket{std::move(_sockets.front())};
+            _sockets.pop_front();
+
+            return socket;
+        }
+
+        // Wake up all workers and stop giving them connections.
+        void close()
+        {
+            {
+                std::lock_guard lock{_mutex};
+
+                _is_closed = true;
+            }
+
+            _condition.notify_all();
+        }
+
+    private:
+        size_t _capacity;
+        std::mutex _mutex{};
+        std::condition_variable _condition{};
+        std::deque<tcp::socket> _sockets{};
+        bool _is_closed{false};
+};
+
+// Worker that serves connections from the queue one by one. Its socket, buffer and downloader are reused 
+// for all connections, so the memory and the number of threads of the server are bounded by the number of workers.
+// Every blocking operation of the connection is limited, either by the idle timeout for the request header 
+// and the response or by the operations timeout for the reads of the request body, so a client that stalls 
+// doesn't hold the worker longer than that.
+class sync_worker
+{
+    public:
+        sync_worker(
+            asio::io_context& io_context, 
+            connection_queue& queue,
+            std::chrono::milliseconds idle_timeout = std::chrono::milliseconds(5000),
+            std::chrono::steady_clock::duration operations_timeout = std::chrono::seconds(30))
+            : 
+            _socket{io_context}, 
+            _form_data{_socket, _buffer}, 
+            _queue{queue}, 
+            _idle_timeout{idle_timeout}, 
+            _operations_timeout{operations_timeout}
+        {}
+
+        sync_worker(const sync_worker&) = delete;
+        sync_worker& operator=(const sync_worker&) = delete;
+
+        void run()
+        {
+            while (std::optional<tcp::socket> socket = _queue.pop())
+            {
+                // The downloader refers to the worker's socket, so the connection is moved into it
+                _socket.assign(std::move(*socket));
+
+                serve_connection(_socket, _buffer, _form_data, _idle_timeout, _operations_timeout);
+
+                beast::error_code error_code;
+                _socket.close(error_code);
+            }
+        }
+
+    private:
+        deadline_socket _socket;
+        beast::flat_buffer _buffer{};
+        multipart_form_data::downloader<deadline_socket, beast::flat_buffer> _form_data;
+        connection_queue& _queue;
+        std::chrono::milliseconds _idle_timeout;
+        std::chrono::steady_clock::duration _operations_timeout;
+};
+
+// Reject the connection that exceeds the admission limit
+void reject_connection(tcp::socket& socket)
+{
+    beast::error_code error_code;
+
+    http::response<http::string_body> response{http::status::service_unavailable, 11};
+    response.set(http::field::retry_after, "1");
+    response.keep_alive(false);
+    response.body() = "Too many connections\n";
+    response.prepare_payload();
+
+    http::write(socket, response, error_code);
+
+    socket.shutdown(tcp::socket::shutdown_send, error_code);
+    socket.close(error_code);
+}
+
+void pooled_sync_downloading_example(
+    size_t workers_count = std::max(std::thread::hardware_concurrency(), 1u) * 4, 
+    size_t max_queued_connections = 64)
+{
+    // The io_context is required for all I/O, it has to outlive the sockets of the workers
+    asio::io_context ioc{1};
+
+    connection_queue queue{max_queued_connections};
+    std::vector<std::unique_ptr<sync_worker>> workers;
+    std::vector<std::thread> worker_threads;
+
+    try
+    {
+        for (size_t i = 0; i < workers_count; ++i)
+        {
+            sync_worker& worker = *workers.emplace_back(std::make_unique<sync_worker>(ioc, queue));
+
+            worker_threads.emplace_back([&worker]() { worker.run(); });
+        }
+
+        // The acceptor receives incoming connections
+        tcp::acceptor acceptor{ioc, tcp::endpoint{asio::ip::make_address("127.0.0.1"), 12345}};
+        for(;;)
+        {
+            // This will receive the new connection
+            tcp::socket socket{ioc};
+
+            // Block until we get a connection
+            acceptor.accept(socket);
+
+            // Pass the connection to the workers or reject it if too many connections wait for them
+            if (!queue.try_push(socket))
+            {
+                reject_connection(socket);
+            }
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << ex.what() << "\n";
+    }
+
+    queue.close();
+
+    for (std::thread& worker_thread : worker_threads)
+    {
+        worker_thread.join();
+    }
+}
@@ -0,0 +1,444 @@
+#ifndef URING_BENCHMARK_HPP
+#define URING_BENCHMARK_HPP
+
+#include <async_downloading.hpp>
+
+#include <boost/asio/write.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Session of the benchmark server that downloads one request with the stream of the specified type
+// and closes the connection.
+template<typename stream_t>
+class density_session : public std::enable_shared_from_this<density_session<stream_t>>
+{
+    public:
+        template<typename ...stream_arguments_t>
+        density_session(
+            const std::filesystem::path& output_directory,
+            multipart_form_data::download_metrics& metrics,
+            std::atomic<size_t>& completed_downloads,
+            stream_arguments_t&&... stream_arguments)
+            : _stream{std::forward<stream_arguments_t>(stream_arguments)...}, _form_data{_stream, _buffer},
+            _output_directory{output_directory}, _metrics{metrics}, _completed_downloads{completed_downloads}
+        {
+            // Set unlimited body to prevent "body limit exceeded" error
+            _request_parser.body_limit(boost::none);
+        }
+
+        void run()
+        {
+            http::async_read_header(_stream, _buffer, _request_parser,
+                beast::bind_front_handler(
+                    &density_session::on_read_header,
+                    this->shared_from_this()));
+        }
+
+    private:
+        void on_read_header(beast::error_code error_code, std::size_t bytes_transferred)
+        {
+            boost::ignore_unused(bytes_transferred);
+
+            if (error_code)
+            {
+                return;
+            }
+
+            _form_data.async_download(
+                _request_parser.get()[http::field::content_type],
+                {
+                    .packets_size = 64 * 1024,
+
+                    .output_directory = _output_directory,
+
+                    .metrics = &_metrics
+                },
+                beast::bind_front_handler(
+                    &density_session::on_download_files,
+                    this->shared_from_this()),
+                this->shared_from_this());
+        }
+
+        void on_download_files(beast::error_code error_code, std::vector<std::filesystem::path>&& file_paths)
+        {
+            boost::ignore_unused(file_paths);
+
+            if (error_code)
+            {
+                std::cerr << "benchmark download failed: " << error_code.message() << "\n";
+            }
+
+            _completed_downloads.fetch_add(1, std::memory_order_relaxed);
+
+            beast::error_code shutdown_error_code;
+
+            _stream.socket().shutdown(tcp::socket::shutdown_send, shutdown_error_code);
+        }
+
+        stream_t _stream;
+        beast::flat_buffer _buffer{};
+        http::request_parser<http::empty_body> _request_parser{};
+        multipart_form_data::downloader<stream_t, beast::flat_buffer> _form_data;
+        const std::filesystem::path& _output_directory;
+        multipart_form_data::download_metrics& _metrics;
+        std::atomic<size_t>& _completed_downloads;
+};
+
+// Result of one run of the connection density benchmark
+struct density_result
+{
+    // Growth of the resident memory since the start of the run
+    size_t idle_resident_bytes{0};
+    // Memory of the downloaders' buffers and of the provided buffers that hold the received data
+    size_t idle_receive_bytes{0};
+    double throughput{0};
+};
+
+// Get the resident memory of the process.
+size_t resident_bytes()
+{
+    std::ifstream statm{"/proc/self/statm"};
+    size_t size = 0;
+    size_t resident_pages = 0;
+
+    statm >> size >> resident_pages;
+
+    return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+// Open the specified number of connections that upload the first half of the file and pause, so the server holds
+// all of them at once, then upload the second halves. Return the memory while the connections are idle 
+// and the throughput of the second halves. Sessions use uring_stream if it is requested, 
+// otherwise beast::tcp_stream that reads through the asio reactor(epoll). Clients run in the child process, 
+// so the descriptors of the server process are left to the connections and the files.
+density_result measure_connection_density(size_t connections_count, size_t upload_size, bool use_uring)
+{
+    std::filesystem::path output_directory =
+        std::filesystem::temp_directory_path() / "multipart_form_data_uring_benchmark";
+
+    std::filesystem::create_directories(output_directory);
+
+    size_t baseline_resident_bytes = resident_bytes();
+
+    asio::io_context io_context{1};
+    std::optional<multipart_form_data::uring_context> uring_context;
+    tcp::acceptor acceptor{io_context, tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}};
+    multipart_form_data::download_metrics metrics;
+    std::atomic<size_t> completed_downloads{0};
+    std::atomic<size_t> receive_bytes{0};
+
+    constexpr std::string_view boundary{"multipart_form_data_benchmark_boundary"};
+
+    // Files have unique names, otherwise the downloader looks for a free name among all of them
+    auto part_header =
+        [boundary](size_t i)
+        {
+            return 
+                "--" + std::string{boundary} + "\r\n"
+                "Content-Disposition: form-data; name=\"file\"; filename=\"benchmark_" + std::to_string(i) + ".bin\"\r\n\r\n";
+        };
+    std::string closing_boundary = "\r\n--" + std::string{boundary} + "--\r\n";
+    std::string data(upload_size / 2, 'x');
+
+    // The byte of the server lets the clients send the second halves, closing of the pipe lets them exit
+    int control_pipe[2];
+
+    if (pipe(control_pipe) != 0)
+    {
+        std::cerr << "pipe failed: " << std::strerror(errno) << "\n";
+
+        return {};
+    }
+
+    // The child is forked before the server thread is started and before the ring is set up
+    pid_t client_pid = fork();
+
+    if (client_pid < 0)
+    {
+        std::cerr << "fork failed: " << std::strerror(errno) << "\n";
+
+        close(control_pipe[0]);
+        close(control_pipe[1]);
+
+        return {};
+    }
+
+    if (client_pid == 0)
+    {
+        close(control_pipe[1]);
+
+        http::request<http::empty_body> request{http::verb::post, "/", 11};
+        request.set(http::field::content_type, "multipart/form-data; boundary=" + std::string{boundary});
+
+        asio::io_context client_context{1};
+        std::vector<tcp::socket> clients;
+        beast::error_code error_code;
+
+        clients.reserve(connections_count);
+
+        for (size_t i = 0; i < connections_count && !error_code; ++i)
+        {
+            tcp::socket& client = clients.emplace_back(client_context);
+
+            client.connect(acceptor.local_endpoint(), error_code);
+
+            std::string client_part_header = part_header(i);
+
+            request.content_length(client_part_header.size() + 2 * data.size() + closing_boundary.size());
+
+            http::request_serializer<http::empty_body> serializer{request};
+
+            if (!error_code)
+            {
+                http::write_header(client, serializer, error_code);
+            }
+
+            if (!error_code)
+            {
+                asio::write(client, std::array<asio::const_buffer, 2>{asio::buffer(client_part_header), asio::buffer(data)}, error_code);
+            }
+        }
+
+        char signal = 0;
+
+        if (!error_code && read(control_pipe[0], &signal, 1) == 1)
+        {
+            for (tcp::socket& client : clients)
+            {
+                asio::write(client, std::array<asio::const_buffer, 2>{asio::buffer(data), asio::buffer(closing_boundary)}, error_code);
+
+                if (error_code)
+                {
+                    break;
+                }
+            }
+
+            // The connections are kept until the server has downloaded all of them
+            if (!error_code)
+            {
+                read(control_pipe[0], &signal, 1);
+            }
+        }
+
+        if (error_code)
+        {
+            std::cerr << "benchmark client failed: " << error_code.message() << "\n";
+        }
+
+        _exit(error_code ? 1 : 0);
+    }
+
+    close(control_pipe[0]);
+
+    // The ring is set up after the fork, so the client process doesn't share it
+    if (use_uring)
+    {
+        uring_context.emplace(io_context);
+    }
+
+    std::function<void()> do_accept =
+        [&]()
+        {
+            acceptor.async_accept(
+                [&](beast::error_code error_code, tcp::socket socket)
+                {
+                    if (error_code)
+                    {
+                        return;
+                    }
+
+                    if (uring_context)
+                    {
+                        std::make_shared<density_session<multipart_form_data::uring_stream>>(
+                            output_directory, metrics, completed_downloads, *uring_context, std::move(socket))->run();
+                    }
+                    else
+                    {
+                        std::make_shared<density_session<beast::tcp_stream>>(
+                            output_directory, metrics, completed_downloads, std::move(socket))->run();
+                    }
+
+                    do_accept();
+                });
+        };
+
+    do_accept();
+
+    std::thread server{
+        [&io_context]()
+        {
+            io_context.run();
+        }};
+
+    // The client process exits before the server lets it only if it fails
+    auto is_client_failed =
+        [client_pid]()
+        {
+            return waitpid(client_pid, nullptr, WNOHANG) == client_pid;
+        };
+
+    density_result result;
+    bool is_client_alive = true;
+
+    // Let the server take the first halves before the memory is measured
+    while (is_client_alive && metrics.bytes_received() < connections_count * (part_header(0).size() + data.size()))
+    {
+        is_client_alive = !is_client_failed();
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    if (is_client_alive)
+    {
+        result.idle_resident_bytes = resident_bytes() - baseline_resident_bytes;
+
+        asio::post(
+            io_context,
+            [&]()
+            {
+                size_t taken_buffers_bytes = uring_context ? 
+                    (uring_context->buffers_count() - uring_context->free_buffers()) * uring_context->buffer_size() : 0;
+
+                receive_bytes = static_cast<size_t>(metrics.buffer_memory()) + taken_buffers_bytes;
+            });
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        char signal = 0;
+
+        write(control_pipe[1], &signal, 1);
+
+        while (is_client_alive && completed_downloads.load(std::memory_order_relaxed) < connections_count)
+        {
+            is_client_alive = !is_client_failed();
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+        result.idle_receive_bytes = receive_bytes.load();
+        result.throughput = static_cast<double>(connections_count * data.size()) / std::max(duration.count(), 1e-9);
+    }
+
+    close(control_pipe[1]);
+
+    if (is_client_alive)
+    {
+        waitpid(client_pid, nullptr, 0);
+    }
+
+    // Sessions are over, so the streams don't use the uring context anymore
+    asio::post(
+        io_context,
+        [&]()
+        {
+            acceptor.close();
+            io_context.stop();
+        });
+
+    server.join();
+
+    uring_context.reset();
+
+    std::error_code remove_error_code;
+    std::filesystem::remove_all(output_directory, remove_error_code);
+
+    return result;
+}
+
+/**
+ * @brief Compare the resident memory with idle connections and the throughput of the downloading
+ * through the asio reactor(epoll) and through io_uring multishot receive with provided buffers.
+ * The server needs two descriptors for each connection including the file.
+ * The hard limit of descriptors is raised if the process is allowed to, otherwise the number of connections
+ * is reduced to the limit. Each mode runs in its own process, so the memory that the allocator keeps
+ * after one mode isn't counted in the other.
+ *
+ * @param connections_count number of concurrent connections.
+ * @param upload_size size of the file that each connection uploads.
+ */
+void uring_benchmark(size_t connections_count = 10000, size_t upload_size = 64 * 1024)
+{
+    rlimit descriptors_limit{};
+
+    if (getrlimit(RLIMIT_NOFILE, &descriptors_limit) == 0)
+    {
+        rlim_t required_descriptors = static_cast<rlim_t>(2 * connections_count + 64);
+
+        descriptors_limit.rlim_cur = std::max(descriptors_limit.rlim_max, required_descriptors);
+        descriptors_limit.rlim_max = descriptors_limit.rlim_cur;
+
+        // Raising of the hard limit requires CAP_SYS_RESOURCE, otherwise the hard limit is used
+        if (setrlimit(RLIMIT_NOFILE, &descriptors_limit) != 0)
+        {
+            getrlimit(RLIMIT_NOFILE, &descriptors_limit);
+            descriptors_limit.rlim_cur = descriptors_limit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &descriptors_limit);
+        }
+
+        size_t max_connections_count = (static_cast<size_t>(descriptors_limit.rlim_cur) - 64) / 2;
+
+        if (connections_count > max_connections_count)
+        {
+            std::cerr << "descriptors limit allows only " << max_connections_count << " connections\n";
+
+            connections_count = max_connections_count;
+        }
+    }
+
+    {
+        asio::io_context io_context{1};
+        multipart_form_data::uring_context uring_context{io_context};
+
+        if (!uring_context.is_available())
+        {
+            std::cerr << "io_uring is not available: " << uring_context.setup_error().message() << "\n";
+        }
+    }
+
+    for (bool use_uring : {false, true})
+    {
+        pid_t pid = fork();
+
+        if (pid < 0)
+        {
+            std::cerr << "fork failed: " << std::strerror(errno) << "\n";
+
+            return;
+        }
+
+        if (pid == 0)
+        {
+            density_result result = measure_connection_density(connections_count, upload_size, use_uring);
+
+            std::cout
+                << (use_uring ? "io_uring: " : "epoll: ") << connections_count << " connections"
+                << ", idle resident " << result.idle_resident_bytes / (1024 * 1024) << " MB"
+                << ", idle receive buffers " << result.idle_receive_bytes / (1024 * 1024) << " MB"
+                << ", " << static_cast<uint64_t>(result.throughput / (1024 * 1024)) << " MB/s" << std::endl;
+
+            _exit(0);
+        }
+
+        waitpid(pid, nullptr, 0);
+    }
+}
+
+#endif
@@ -0,0 +1,270 @@
+#ifndef MULTIPART_FORM_DATA_ADMISSION_CONTROLLER_HPP
+#define MULTIPART_FORM_DATA_ADMISSION_CONTROLLER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <string>
+
+#if defined(__linux__)
+    #include <fstream>
+#endif
+
+namespace multipart_form_data
+{
+    // Levels of the pressure that the admission controller reacts to. The pressure is the share of the time in percents
+    // that some tasks were stalled on the resource over the last 10 seconds(PSI "some avg10"), the maximum one of
+    // memory and I/O, or the one that is equivalent to the latency of the packet writes.
+    struct admission_thresholds
+    {
+        // The pressure from which the reading of the downloads is slowed down and the new downloads use the smallest packets.
+        // The slowdown grows with the pressure up to reject_pressure.
+        //
+        // Default value is 10.
+        double throttle_pressure{10.0};
+        // The pressure from which the new downloads are rejected with multipart_form_data::error::overloaded.
+        // The downloads that are in progress are not rejected, their receiving rate is throttled_rate then.
+        //
+        // Default value is 40.
+        double reject_pressure{40.0};
+        // The smoothed latency of the packet writes that is equivalent to throttle_pressure, the equivalent pressure
+        // grows proportionally to the latency. If it is zero then the latency is not taken into account.
+        //
+        // Default value is 50 milliseconds.
+        std::chrono::steady_clock::duration write_latency_target{std::chrono::milliseconds(50)};
+        // The receiving rate of each download in bytes per second at reject_pressure.
+        //
+        // Default value is 1 MB per second.
+        uint64_t throttled_rate{1024 * 1024};
+        // The interval of sampling of the pressure files. The pressure is sampled by the downloader that asks
+        // for it first after the interval is over, so no thread is needed. It is also the time in which the write latency
+        // halves while there are no writes.
+        //
+        // Default value is 1 second.
+        std::chrono::steady_clock::duration sample_interval{std::chrono::seconds(1)};
+    };
+
+    // Controller of the admission of the downloads under the pressure of memory and I/O. It samples the pressure stall
+    // information of Linux(/proc/pressure/memory and /proc/pressure/io) and the latency of the packet writes
+    // that the downloaders observe. Under a moderate pressure the downloads are slowed down, so the clients are held back
+    // by the flow control of the connections, and under a high one the new downloads are rejected, so the latency
+    // of the downloads in progress stays stable. The pressure files are not sampled on other platforms or if they are
+    // absent, then only the write latency is taken into account.
+    // It can be shared between any number of downloaders working in different threads.
+    class admission_controller
+    {
+        public:
+            explicit admission_controller(admission_thresholds thresholds = {}) noexcept
+                : _thresholds{thresholds}
+            {}
+
+            admission_controller(const admission_controller&) = delete;
+            admission_controller& operator=(const admission_controller&) = delete;
+
+            const admission_thresholds& thresholds() const noexcept
+            {
+                return _thresholds;
+            }
+
+            double memory_pressure() const noexcept
+            {
+                return _memory_pressure.load(std::memory_order_relaxed);
+            }
+
+            double io_pressure() const noexcept
+            {
+                return _io_pressure.load(std::memory_order_relaxed);
+            }
+
+            // Smoothed latency of the packet writes. It halves with each sample interval without writes, so the latency
+            // that rejected the new downloads doesn't stay forever when the writes are over.
+            std::chrono::nanoseconds write_latency() const noexcept
+            {
+                return std::chrono::nanoseconds{decayed_write_latency(
+                    _write_latency.load(std::memory_order_relaxed),
+                    std::chrono::steady_clock::now().time_since_epoch().count())};
+            }
+
+            // Number of downloads that were rejected since the controller is created.
+            uint64_t rejected_downloads() const noexcept
+            {
+                return _rejected_downloads.load(std::memory_order_relaxed);
+            }
+
+            /**
+             * @brief Get the current pressure, the pressure files are sampled if the sample interval is over.
+             *
+             * @return The maximum one of memory and I/O pressures and the pressure equivalent to the write latency.
+             */
+            double pressure() noexcept
+            {
+                std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                int64_t now_time = now.time_since_epoch().count();
+                int64_t sample_time = _next_sample_time.load(std::memory_order_relaxed);
+
+                // Only the thread that moves the time of the next sample reads the files
+                if (now_time >= sample_time &&
+                    _next_sample_time.compare_exchange_strong(
+                        sample_time,
+                        (now + _thresholds.sample_interval).time_since_epoch().count(),
+                        std::memory_order_relaxed))
+                {
+                    sample();
+                }
+
+                double result = std::max(memory_pressure(), io_pressure());
+
+                if (_thresholds.write_latency_target.count() > 0)
+                {
+                    result = std::max(
+                        result,
+                        _thresholds.throttle_pressure * static_cast<double>(write_latency().count()) /
+                            static_cast<double>(std::chrono::nanoseconds{_thresholds.write_latency_target}.count()));
+                }
+
+                return result;
+            }
+
+            /**
+             * @brief Sample the pressure files right away, e.g. from a timer. Otherwise they are sampled
+             * once per sample interval when the pressure is requested.
+             */
+            void sample() noexcept
+            {
+#if defined(__linux__)
+                _memory_pressure.store(read_pressure("/proc/pressure/memory"), std::memory_order_relaxed);
+                _io_pressure.store(read_pressure("/proc/pressure/io"), std::memory_order_relaxed);
+#endif
+            }
+
+            /**
+             * @brief Decide whether the new download is admitted and account it as rejected if it is not.
+             *
+             * @return False if the pressure is not lower than the reject pressure.
+             */
+            bool admit() noexcept
+            {
+                if (pressure() < _thresholds.reject_pressure)
+                {
+                    return true;
+                }
+
+                _rejected_downloads.fetch_add(1, std::memory_order_relaxed);
+
+                return false;
+            }
+
+            /**
+             * @brief Check whether the downloads have to be slowed down.
+             */
+            bool is_throttled() noexcept
+            {
+                return pressure() >= _thresholds.throttle_pressure;
+            }
+
+            /**
+             * @brief Get the pause of the reading after the received bytes. It grows with the pressure from zero
+             * at the throttle pressure to the time of receiving of the bytes at the throttled rate at the reject pressure.
+             *
+             * @param bytes number of the received bytes.
+             */
+            std::chrono::nanoseconds read_delay(uint64_t bytes) noexcept
+            {
+                double throttle = (pressure() - _thresholds.throttle_pressure) /
+                    std::max(_thresholds.reject_pressure - _thresholds.throttle_pressure, 1e-9);
+
+                if (throttle <= 0 || _thresholds.throttled_rate == 0)
+                {
+                    return std::chrono::nanoseconds::zero();
+                }
+
+                return std::chrono::nanoseconds{static_cast<int64_t>(
+                    std::min(throttle, 1.0) * static_cast<double>(bytes) * 1e9 / static_cast<double>(_thresholds.throttled_rate))};
+            }
+
+            /**
+             * @brief Account the latency of the packet write that the downloader observed.
+             */
+            void record_write_latency(std::chrono::steady_clock::duration latency) noexcept
+            {
+                int64_t sample = std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count();
+                int64_t now_time = std::chrono::steady_clock::now().time_since_epoch().count();
+                int64_t smoothed = _write_latency.load(std::memory_order_relaxed);
+
+                // Exponential moving average over the last 8 writes, the previous value decays with the time since
+                // the previous write first
+                while (true)
+                {
+                    int64_t decayed = decayed_write_latency(smoothed, now_time);
+
+                    if (_write_latency.compare_exchange_weak(smoothed, decayed + (sample - decayed) / 8, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+
+                _last_write_time.store(now_time, std::memory_order_relaxed);
+            }
+
+        private:
+            // Decay the smoothed write latency by half per sample interval since the last write.
+            int64_t decayed_write_latency(int64_t smoothed, int64_t now_time) const noexcept
+            {
+                int64_t idle_time = now_time - _last_write_time.load(std::memory_order_relaxed);
+                int64_t half_time = _thresholds.sample_interval.count();
+
+                if (smoothed <= 0 || idle_time <= 0 || half_time <= 0)
+                {
+                    return smoothed;
+                }
+
+                return static_cast<int64_t>(
+                    static_cast<double>(smoothed) * std::exp2(-static_cast<double>(idle_time) / static_cast<double>(half_time)));
+            }
+
+#if defined(__linux__)
+            // Read the "some avg10" value of the pressure file, it is zero if the file is absent, e.g. the kernel
+            // is older than 4.20 or it is built without PSI.
+            static double read_pressure(const char* path) noexcept
+            {
+                try
+                {
+                    std::ifstream file{path};
+                    std::string line;
+
+                    while (std::getline(file, line))
+                    {
+                        size_t average_position = line.find("avg10=");
+
+                        if (line.starts_with("some") && average_position != std::string::npos)
+                        {
+                            return std::strtod(line.c_str() + average_position + 6, nullptr);
+                        }
+                    }
+                }
+                catch (const std::exception&)
+                {
+                    // The pressure is unknown
+                }
+
+                return 0;
+            }
+#endif
+
+            const admission_thresholds _thresholds;
+            std::atomic<double> _memory_pressure{0};
+            std::atomic<double> _io_pressure{0};
+            std::atomic<int64_t> _write_latency{0};
+            // Time since the epoch of the steady clock in its ticks when the last write latency is recorded
+            std::atomic<int64_t> _last_write_time{0};
+            // Time since the epoch of the steady clock in its ticks when the pressure files are sampled next time
+            std::atomic<int64_t> _next_sample_time{0};
+            std::atomic<uint64_t> _rejected_downloads{0};
+    };
+};
+
+#endif
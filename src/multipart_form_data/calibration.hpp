@@ -0,0 +1,383 @@
+#ifndef MULTIPART_FORM_DATA_CALIBRATION_HPP
+#define MULTIPART_FORM_DATA_CALIBRATION_HPP
+
+#include <multipart_form_data/cpu_dispatch.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#if defined(__linux__)
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace multipart_form_data
+{
+    // Parameters of the downloading process that are tuned for the filesystem of the output directory.
+    struct calibration
+    {
+        // The size of packets that gives the write rate close to the best one with the least memory.
+        // It is supposed to be used as settings::packets_size.
+        size_t packets_size{10 * 1024 * 1024};
+        // Rate of writing files to the output directory with the chosen packets size in bytes per second.
+        double write_rate{0};
+        // Rate of searching the boundary in the received data in bytes per second.
+        double scan_rate{0};
+        // Whether the result is loaded from the cache file instead of running the benchmark.
+        bool is_cached{false};
+    };
+
+    namespace detail
+    {
+        // Version of the cache file format, cache files of other versions are ignored
+        constexpr std::string_view calibration_cache_version{"2"};
+
+        // Candidates for the packets size
+        constexpr std::array<size_t, 5> calibration_packets_sizes{
+            64 * 1024,
+            256 * 1024,
+            1024 * 1024,
+            4 * 1024 * 1024,
+            16 * 1024 * 1024};
+
+        // The packets size is chosen as the smallest one which write rate is not less than this part of the best rate
+        constexpr double calibration_rate_tolerance = 0.9;
+
+        // Key of the cache entry of the output directory: the host name and the device of the directory,
+        // so the hosts that share the cache file on a network storage and the directories on different devices
+        // don't reuse the result of each other.
+        inline std::string calibration_cache_key(const std::filesystem::path& output_directory)
+        {
+            std::string host_name{"localhost"};
+            uint64_t device = 0;
+
+#if defined(__linux__)
+            std::array<char, 256> host_name_storage{};
+
+            if (::gethostname(host_name_storage.data(), host_name_storage.size() - 1) == 0 && host_name_storage[0] != '\0')
+            {
+                host_name = host_name_storage.data();
+            }
+
+            struct stat directory_status{};
+
+            if (::stat(output_directory.c_str(), &directory_status) == 0)
+            {
+                device = static_cast<uint64_t>(directory_status.st_dev);
+            }
+#endif
+
+            return host_name + " " + std::to_string(device);
+        }
+
+        // Read the entries of the cache file, one line per key. The file of another version is treated as empty.
+        inline std::vector<std::string> read_calibration_entries(const std::filesystem::path& cache_path)
+        {
+            std::ifstream cache_file{cache_path};
+
+            std::string line;
+            std::vector<std::string> entries;
+
+            if (!std::getline(cache_file, line) || line != "version " + std::string{calibration_cache_version})
+            {
+                return entries;
+            }
+
+            while (std::getline(cache_file, line))
+            {
+                if (!line.empty())
+                {
+                    entries.push_back(std::move(line));
+                }
+            }
+
+            return entries;
+        }
+
+        // Load the entry of the key. The packets size outside of the candidates range is rejected, so the file
+        // that is damaged or planted can't make the downloader allocate huge packets.
+        inline bool load_calibration(const std::filesystem::path& cache_path, const std::string& key, calibration& result)
+        {
+            for (const std::string& entry : read_calibration_entries(cache_path))
+            {
+                std::istringstream entry_stream{entry};
+
+                std::string host_name, device;
+                uint64_t write_rate = 0, scan_rate = 0;
+
+                if (!(entry_stream >> host_name >> device >> result.packets_size >> write_rate >> scan_rate) || 
+                    host_name + " " + device != key)
+                {
+                    continue;
+                }
+
+                result.write_rate = static_cast<double>(write_rate);
+                result.scan_rate = static_cast<double>(scan_rate);
+
+                return 
+                    result.packets_size >= calibration_packets_sizes.front() && 
+                    result.packets_size <= calibration_packets_sizes.back();
+            }
+
+            return false;
+        }
+
+        // Replace the entry of the key and keep the ones of other hosts and devices. The file is written aside 
+        // and renamed over the old one, so the hosts that read it at the same time don't see a partial file.
+        inline void save_calibration(const std::filesystem::path& cache_path, const std::string& key, const calibration& result)
+        {
+            std::vector<std::string> entries = read_calibration_entries(cache_path);
+
+            std::filesystem::path temporary_path = cache_path;
+            temporary_path += "." + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+
+            {
+                std::ofstream cache_file{temporary_path, std::ios::trunc};
+
+                cache_file << "version " << calibration_cache_version << "\n";
+
+                for (const std::string& entry : entries)
+                {
+                    if (entry.compare(0, key.size() + 1, key + " ") != 0)
+                    {
+                        cache_file << entry << "\n";
+                    }
+                }
+
+                cache_file
+                    << key << " " 
+                    << result.packets_size << " "
+                    << static_cast<uint64_t>(result.write_rate) << " "
+                    << static_cast<uint64_t>(result.scan_rate) << "\n";
+            }
+
+            std::error_code error_code;
+            std::filesystem::rename(temporary_path, cache_path, error_code);
+
+            if (error_code)
+            {
+                std::filesystem::remove(temporary_path, error_code);
+            }
+        }
+
+        // Whether the path lies in the directory or in any of its subdirectories.
+        inline bool is_within_directory(const std::filesystem::path& path, const std::filesystem::path& directory)
+        {
+            std::error_code error_code;
+
+            std::filesystem::path relative_path = std::filesystem::weakly_canonical(path, error_code)
+                .lexically_relative(std::filesystem::weakly_canonical(directory, error_code));
+
+            return !error_code && !relative_path.empty() && *relative_path.begin() != "..";
+        }
+
+        // Write the specified amount of data to the file by packets the same way as the downloader does
+        // and flush it to the device. Return the write rate in bytes per second.
+        inline double measure_write_rate(
+            const std::filesystem::path& file_path,
+            const std::vector<char>& data,
+            size_t packets_size,
+            size_t total_size,
+            std::error_code& error_code)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            {
+                errno = 0;
+
+                std::ofstream file{file_path, std::ios::binary | std::ios::trunc};
+
+                if (!file.is_open())
+                {
+                    error_code = errno != 0 
+                        ? std::error_code{errno, std::generic_category()} 
+                        : std::make_error_code(std::errc::io_error);
+
+                    return 0;
+                }
+
+                for (size_t written_size = 0; written_size < total_size; written_size += packets_size)
+                {
+                    file.write(data.data(), std::min(packets_size, total_size - written_size));
+                }
+
+                if (!file)
+                {
+                    error_code = std::make_error_code(std::errc::io_error);
+
+                    return 0;
+                }
+            }
+
+#if defined(__linux__)
+            // Include the time of writing the data to the device, otherwise only the page cache is measured
+            int file_descriptor = ::open(file_path.c_str(), O_WRONLY);
+
+            if (file_descriptor >= 0)
+            {
+                ::fdatasync(file_descriptor);
+                ::close(file_descriptor);
+            }
+#endif
+
+            std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+            return static_cast<double>(total_size) / std::max(duration.count(), 1e-9);
+        }
+
+        // Search the boundary that is absent in the data the same way as the downloader does
+        // and return the scan rate in bytes per second.
+        inline double measure_scan_rate(const std::vector<char>& data, size_t total_size)
+        {
+            constexpr std::string_view boundary{"------------------------calibration"};
+
+            std::string_view scanned_data{data.data(), data.size()};
+            size_t scanned_size = 0;
+            // The results of the searches are kept, otherwise they can be optimized away
+            volatile size_t position = 0;
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            for (size_t i = 0; scanned_size < total_size; ++i)
+            {
+                // Shift the data to not repeat the same search
+                std::string_view packet = scanned_data.substr(i % 8);
+
+                position = detail::find(packet, boundary);
+                scanned_size += packet.size();
+            }
+
+            std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+            static_cast<void>(position);
+
+            return static_cast<double>(scanned_size) / std::max(duration.count(), 1e-9);
+        }
+    }
+
+    /**
+     * @brief Calibrate the downloading process for the filesystem of the output directory. It writes files
+     * of different packets sizes to the directory and chooses the packets size that gives the write rate close to the best one
+     * with the least memory, and measures the rate of searching the boundary. The result is saved to the cache file
+     * by the host name and the device of the directory, so the next calls on the same host load it instantly. 
+     * It is supposed to be called once at startup.
+     *
+     * @param output_directory directory where the downloaded files will be placed.
+     * @param cache_path path of the cache file. It has to be outside of the output directory, otherwise an uploaded file
+     * could replace it, and std::errc::invalid_argument is reported. Caching is disabled if it is empty.
+     * @param error_code operation status. If it is set then the default calibration is returned.
+     * @param benchmark_size amount of data that is written for each candidate packets size.
+     *
+     * @return Calibration of the downloading process.
+     */
+    inline calibration calibrate(
+        const std::filesystem::path& output_directory,
+        const std::filesystem::path& cache_path,
+        std::error_code& error_code,
+        size_t benchmark_size = 32 * 1024 * 1024)
+    {
+        calibration result{};
+
+        std::string cache_key = detail::calibration_cache_key(output_directory);
+
+        if (!cache_path.empty())
+        {
+            if (detail::is_within_directory(cache_path, output_directory))
+            {
+                error_code = std::make_error_code(std::errc::invalid_argument);
+
+                return result;
+            }
+
+            if (detail::load_calibration(cache_path, cache_key, result))
+            {
+                result.is_cached = true;
+
+                return result;
+            }
+
+            result = calibration{};
+        }
+
+        // Data that doesn't contain the boundary and is not compressible by the filesystem
+        std::vector<char> data(detail::calibration_packets_sizes.back());
+
+        uint32_t state = 2463534242;
+
+        for (char& byte : data)
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            byte = static_cast<char>(state);
+        }
+
+        // The name that isn't taken yet, so a file that is already in the directory is not overwritten
+        std::filesystem::path benchmark_path = output_directory / ".multipart_form_data_calibration.tmp";
+
+        for (size_t i = 1; std::filesystem::symlink_status(benchmark_path).type() != std::filesystem::file_type::not_found; ++i)
+        {
+            benchmark_path = output_directory / (".multipart_form_data_calibration." + std::to_string(i) + ".tmp");
+        }
+
+        std::array<double, detail::calibration_packets_sizes.size()> write_rates{};
+
+        for (size_t i = 0; i < write_rates.size(); ++i)
+        {
+            write_rates[i] = detail::measure_write_rate(
+                benchmark_path,
+                data,
+                detail::calibration_packets_sizes[i],
+                benchmark_size,
+                error_code);
+
+            if (error_code)
+            {
+                std::error_code remove_error_code;
+                std::filesystem::remove(benchmark_path, remove_error_code);
+
+                return calibration{};
+            }
+        }
+
+        // The result is valid even if the benchmark file is left, so the failure of the removal isn't reported
+        std::error_code remove_error_code;
+        std::filesystem::remove(benchmark_path, remove_error_code);
+
+        double best_write_rate = *std::max_element(write_rates.begin(), write_rates.end());
+
+        for (size_t i = 0; i < write_rates.size(); ++i)
+        {
+            if (write_rates[i] >= best_write_rate * detail::calibration_rate_tolerance)
+            {
+                result.packets_size = detail::calibration_packets_sizes[i];
+                result.write_rate = write_rates[i];
+
+                break;
+            }
+        }
+
+        result.scan_rate = detail::measure_scan_rate(data, benchmark_size);
+
+        if (!cache_path.empty())
+        {
+            detail::save_calibration(cache_path, cache_key, result);
+        }
+
+        return result;
+    }
+}
+
+#endif
@@ -0,0 +1,224 @@
+#ifndef MULTIPART_FORM_DATA_CPU_DISPATCH_HPP
+#define MULTIPART_FORM_DATA_CPU_DISPATCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// Vectorized kernels are compiled with target attributes, so they don't depend on the flags of the build
+// and are selected at runtime by the features of the CPU
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__)) && \
+    !defined(MULTIPART_FORM_DATA_DISABLE_CPU_DISPATCH)
+    #define MULTIPART_FORM_DATA_X86_DISPATCH
+    #include <immintrin.h>
+#endif
+
+namespace multipart_form_data
+{
+    // Instruction set extensions of the CPU that the vectorized kernels are selected by.
+    // They are false if the platform is not x86 or the kernels are disabled with MULTIPART_FORM_DATA_DISABLE_CPU_DISPATCH.
+    struct cpu_features
+    {
+        bool avx2{false};
+        bool avx512bw{false};
+    };
+
+    // Detect the features of the CPU once, including the support of their registers by the operating system.
+    inline const cpu_features& detected_cpu_features() noexcept
+    {
+        static const cpu_features features =
+            []() noexcept
+            {
+                cpu_features result;
+
+#if defined(MULTIPART_FORM_DATA_X86_DISPATCH)
+                __builtin_cpu_init();
+
+                result.avx2 = __builtin_cpu_supports("avx2");
+                result.avx512bw = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#endif
+
+                return result;
+            }();
+
+        return features;
+    }
+
+    namespace detail
+    {
+        // Kernel that returns the position of the first occurrence of the pattern in the data or std::string_view::npos.
+        using find_kernel = size_t (*)(const char* data, size_t size, const char* pattern, size_t pattern_size) noexcept;
+
+        inline size_t find_generic(const char* data, size_t size, const char* pattern, size_t pattern_size) noexcept
+        {
+            return std::string_view{data, size}.find(std::string_view{pattern, pattern_size});
+        }
+
+#if defined(MULTIPART_FORM_DATA_X86_DISPATCH)
+        // The vectorized kernels compare the first and the last bytes of the pattern with the bytes of the whole block
+        // at once and compare the rest of the pattern only at the positions where both of them match. The positions
+        // of the block are checked in the ascending order, so the first occurrence is found. The rest of the data
+        // that is shorter than the block is searched by the generic kernel.
+        __attribute__((target("avx2")))
+        inline size_t find_avx2(const char* data, size_t size, const char* pattern, size_t pattern_size) noexcept
+        {
+            constexpr size_t block_size = 32;
+
+            // The single byte is searched with memchr, which is vectorized by the C library already
+            if (pattern_size < 2 || size < pattern_size + 2 * block_size)
+            {
+                return find_generic(data, size, pattern, pattern_size);
+            }
+
+            const __m256i first_byte = _mm256_set1_epi8(pattern[0]);
+            const __m256i last_byte = _mm256_set1_epi8(pattern[pattern_size - 1]);
+
+            // Positions of the block where both the first and the last bytes match
+            auto match =
+                [&](size_t position) __attribute__((target("avx2")))
+                {
+                    __m256i first_block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + position));
+                    __m256i last_block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + position + pattern_size - 1));
+
+                    return _mm256_and_si256(_mm256_cmpeq_epi8(first_block, first_byte), _mm256_cmpeq_epi8(last_block, last_byte));
+                };
+
+            size_t position = 0;
+
+            // Two blocks are checked at once, most of them don't have any candidate
+            for (; position + pattern_size - 1 + 2 * block_size <= size; position += 2 * block_size)
+            {
+                __m256i low_matches = match(position);
+                __m256i high_matches = match(position + block_size);
+
+                if (_mm256_testz_si256(_mm256_or_si256(low_matches, high_matches), _mm256_set1_epi8(-1)))
+                {
+                    continue;
+                }
+
+                uint64_t candidates =
+                    static_cast<uint32_t>(_mm256_movemask_epi8(low_matches)) |
+                    static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(high_matches))) << block_size;
+
+                while (candidates != 0)
+                {
+                    size_t candidate = position + static_cast<size_t>(__builtin_ctzll(candidates));
+
+                    if (std::memcmp(data + candidate + 1, pattern + 1, pattern_size - 2) == 0)
+                    {
+                        return candidate;
+                    }
+
+                    candidates &= candidates - 1;
+                }
+            }
+
+            size_t tail_position = find_generic(data + position, size - position, pattern, pattern_size);
+
+            return tail_position == std::string_view::npos ? std::string_view::npos : position + tail_position;
+        }
+
+        __attribute__((target("avx512f,avx512bw")))
+        inline size_t find_avx512bw(const char* data, size_t size, const char* pattern, size_t pattern_size) noexcept
+        {
+            constexpr size_t block_size = 64;
+
+            if (pattern_size < 2 || size < pattern_size + 2 * block_size)
+            {
+                return find_avx2(data, size, pattern, pattern_size);
+            }
+
+            const __m512i first_byte = _mm512_set1_epi8(pattern[0]);
+            const __m512i last_byte = _mm512_set1_epi8(pattern[pattern_size - 1]);
+
+            // Positions of the block where both the first and the last bytes match
+            auto match =
+                [&](size_t position) __attribute__((target("avx512f,avx512bw")))
+                {
+                    return _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(data + position), first_byte) &
+                        _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(data + position + pattern_size - 1), last_byte);
+                };
+
+            size_t position = 0;
+
+            for (; position + pattern_size - 1 + 2 * block_size <= size; position += 2 * block_size)
+            {
+                uint64_t low_candidates = match(position);
+                uint64_t high_candidates = match(position + block_size);
+
+                if ((low_candidates | high_candidates) == 0)
+                {
+                    continue;
+                }
+
+                for (size_t block = 0; block < 2; ++block)
+                {
+                    uint64_t candidates = block == 0 ? low_candidates : high_candidates;
+
+                    while (candidates != 0)
+                    {
+                        size_t candidate = position + block * block_size + static_cast<size_t>(__builtin_ctzll(candidates));
+
+                        if (std::memcmp(data + candidate + 1, pattern + 1, pattern_size - 2) == 0)
+                        {
+                            return candidate;
+                        }
+
+                        candidates &= candidates - 1;
+                    }
+                }
+            }
+
+            size_t tail_position = find_avx2(data + position, size - position, pattern, pattern_size);
+
+            return tail_position == std::string_view::npos ? std::string_view::npos : position + tail_position;
+        }
+#endif
+
+        // Kernel of the search that is selected for the CPU and its name.
+        struct find_dispatch
+        {
+            find_kernel kernel;
+            std::string_view name;
+        };
+
+        inline const find_dispatch& selected_find() noexcept
+        {
+            static const find_dispatch dispatch =
+                []() noexcept
+                {
+#if defined(MULTIPART_FORM_DATA_X86_DISPATCH)
+                    if (detected_cpu_features().avx512bw)
+                    {
+                        return find_dispatch{find_avx512bw, "avx512bw"};
+                    }
+
+                    if (detected_cpu_features().avx2)
+                    {
+                        return find_dispatch{find_avx2, "avx2"};
+                    }
+#endif
+
+                    return find_dispatch{find_generic, "generic"};
+                }();
+
+            return dispatch;
+        }
+
+        // Find the first occurrence of the pattern with the kernel that is selected for the CPU. It is used for
+        // the search of the boundaries in the request body and of the fields in the file headers.
+        inline size_t find(std::string_view data, std::string_view pattern) noexcept
+        {
+            return selected_find().kernel(data.data(), data.size(), pattern.data(), pattern.size());
+        }
+    }
+
+    // Get the name of the search kernel that is selected for the CPU, e.g. to log it at startup.
+    inline std::string_view search_kernel() noexcept
+    {
+        return detail::selected_find().name;
+    }
+};
+
+#endif
@@ -0,0 +1,309 @@
+#ifndef MULTIPART_FORM_DATA_DESCRIPTOR_BUDGET_HPP
+#define MULTIPART_FORM_DATA_DESCRIPTOR_BUDGET_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace multipart_form_data
+{
+    // Budget of the file descriptors that the downloaders can hold at once, e.g. a part of RLIMIT_NOFILE that is left
+    // after the sockets. Each downloader takes a slot before it opens a file and returns it when the file is closed.
+    // If there is no free slot then the download waits for it in the first-come first-served order, so the server queues
+    // the uploads instead of failing them when the process runs out of descriptors(EMFILE).
+    // It can be shared between any number of downloaders working in different threads.
+    class descriptor_budget
+    {
+        public:
+            // Downloader that waits for a slot of the budget. It is owned by the downloader and reused for all of its files.
+            class waiter
+            {
+                public:
+                    virtual ~waiter() = default;
+
+                protected:
+                    // Invoked by the thread that returns the slot once it is granted to the waiter. It is invoked under
+                    // the mutex of the budget, so the waiter can't be destroyed meanwhile, but it can't use the budget.
+                    virtual void on_granted() noexcept
+                    {}
+
+                private:
+                    friend class descriptor_budget;
+
+                    // Next waiter in the queue
+                    waiter* _next{nullptr};
+                    bool _is_queued{false};
+                    bool _is_granted{false};
+            };
+
+            /**
+             * @param descriptors_count maximum number of files that are open at once.
+             */
+            explicit descriptor_budget(size_t descriptors_count)
+                : _descriptors_count{std::max<size_t>(1, descriptors_count)}
+            {}
+
+            descriptor_budget(const descriptor_budget&) = delete;
+            descriptor_budget& operator=(const descriptor_budget&) = delete;
+
+            /**
+             * @brief Change the maximum number of files that are open at once. If it is increased then
+             * the waiting downloaders get the new slots right away, if it is decreased then the files that are
+             * already open are not affected.
+             */
+            void descriptors_count(size_t descriptors_count)
+            {
+                bool is_granted = false;
+
+                {
+                    std::lock_guard lock{_mutex};
+
+                    _descriptors_count = std::max<size_t>(1, descriptors_count);
+
+                    while (grant())
+                    {
+                        is_granted = true;
+                    }
+                }
+
+                if (is_granted)
+                {
+                    _granted_condition.notify_all();
+                }
+            }
+
+            size_t descriptors_count() const
+            {
+                std::lock_guard lock{_mutex};
+
+                return _descriptors_count;
+            }
+
+            size_t used_descriptors() const
+            {
+                std::lock_guard lock{_mutex};
+
+                return _used_descriptors;
+            }
+
+            size_t waiting_downloads() const
+            {
+                std::lock_guard lock{_mutex};
+
+                return _waiters_count;
+            }
+
+            // Number of files that waited for a slot since the budget is created.
+            uint64_t delayed_files() const
+            {
+                std::lock_guard lock{_mutex};
+
+                return _delayed_files;
+            }
+
+            /**
+             * @brief Take a slot if there is a free one and nobody waits for it.
+             *
+             * @return True if the slot is taken, either right away or granted before.
+             */
+            bool try_acquire(waiter& descriptor_waiter)
+            {
+                std::lock_guard lock{_mutex};
+
+                return take(descriptor_waiter);
+            }
+
+            /**
+             * @brief Take a slot for the waiter. If there is no free slot then the waiter is queued
+             * and its on_granted is invoked once the slot is granted to it.
+             *
+             * @return True if the slot is taken, either right away or granted before.
+             */
+            bool acquire(waiter& descriptor_waiter)
+            {
+                std::lock_guard lock{_mutex};
+
+                if (take(descriptor_waiter) || descriptor_waiter._is_queued)
+                {
+                    return descriptor_waiter._is_granted;
+                }
+
+                descriptor_waiter._is_queued = true;
+                descriptor_waiter._next = nullptr;
+
+                if (_last_waiter)
+                {
+                    _last_waiter->_next = &descriptor_waiter;
+                }
+                else
+                {
+                    _first_waiter = &descriptor_waiter;
+                }
+
+                _last_waiter = &descriptor_waiter;
+
+                ++_waiters_count;
+                ++_delayed_files;
+
+                return false;
+            }
+
+            /**
+             * @brief Block the thread until the slot is granted to the waiter that is queued by acquire
+             * or the deadline expires. The waiter stays queued after the expiry, so it has to be canceled 
+             * if it doesn't wait anymore.
+             *
+             * @return True if the slot is granted.
+             */
+            bool wait(
+                waiter& descriptor_waiter, 
+                std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max())
+            {
+                std::unique_lock lock{_mutex};
+
+                auto is_done = [&descriptor_waiter]()
+                {
+                    return descriptor_waiter._is_granted || !descriptor_waiter._is_queued;
+                };
+
+                if (deadline == std::chrono::steady_clock::time_point::max())
+                {
+                    _granted_condition.wait(lock, is_done);
+                }
+                else
+                {
+                    _granted_condition.wait_until(lock, deadline, is_done);
+                }
+
+                return descriptor_waiter._is_granted;
+            }
+
+            /**
+             * @brief Return the slot of the waiter after its file is closed and grant it to the next waiting downloader.
+             * Does nothing if the waiter doesn't hold the slot.
+             */
+            void release(waiter& descriptor_waiter)
+            {
+                bool is_granted = false;
+
+                {
+                    std::lock_guard lock{_mutex};
+
+                    if (!descriptor_waiter._is_granted)
+                    {
+                        return;
+                    }
+
+                    descriptor_waiter._is_granted = false;
+                    --_used_descriptors;
+
+                    is_granted = grant();
+                }
+
+                if (is_granted)
+                {
+                    _granted_condition.notify_all();
+                }
+            }
+
+            /**
+             * @brief Remove the waiter from the queue or return its slot, e.g. if the downloader is destroyed
+             * while it waits.
+             */
+            void cancel(waiter& descriptor_waiter)
+            {
+                {
+                    std::lock_guard lock{_mutex};
+
+                    if (descriptor_waiter._is_queued)
+                    {
+                        waiter* previous_waiter = nullptr;
+
+                        for (waiter* current_waiter = _first_waiter; current_waiter != &descriptor_waiter; current_waiter = current_waiter->_next)
+                        {
+                            previous_waiter = current_waiter;
+                        }
+
+                        (previous_waiter ? previous_waiter->_next : _first_waiter) = descriptor_waiter._next;
+
+                        if (_last_waiter == &descriptor_waiter)
+                        {
+                            _last_waiter = previous_waiter;
+                        }
+
+                        descriptor_waiter._is_queued = false;
+                        --_waiters_count;
+                    }
+                }
+
+                release(descriptor_waiter);
+
+                _granted_condition.notify_all();
+            }
+
+        private:
+            // Take the free slot if nobody waits for it. It has to be invoked under the mutex.
+            bool take(waiter& descriptor_waiter) noexcept
+            {
+                if (descriptor_waiter._is_granted)
+                {
+                    return true;
+                }
+
+                if (_used_descriptors >= _descriptors_count || _first_waiter)
+                {
+                    return false;
+                }
+
+                ++_used_descriptors;
+
+                descriptor_waiter._is_granted = true;
+
+                return true;
+            }
+
+            // Grant the free slot to the first waiter. Return false if there is no free slot or no waiter.
+            // It has to be invoked under the mutex.
+            bool grant() noexcept
+            {
+                if (_used_descriptors >= _descriptors_count || !_first_waiter)
+                {
+                    return false;
+                }
+
+                waiter* next_waiter = _first_waiter;
+
+                _first_waiter = next_waiter->_next;
+
+                if (!_first_waiter)
+                {
+                    _last_waiter = nullptr;
+                }
+
+                --_waiters_count;
+                ++_used_descriptors;
+
+                next_waiter->_next = nullptr;
+                next_waiter->_is_queued = false;
+                next_waiter->_is_granted = true;
+                next_waiter->on_granted();
+
+                return true;
+            }
+
+            mutable std::mutex _mutex{};
+            std::condition_variable _granted_condition{};
+            size_t _descriptors_count;
+            size_t _used_descriptors{0};
+            // Queue of the waiting downloaders in the order of arrival
+            waiter* _first_waiter{nullptr};
+            waiter* _last_waiter{nullptr};
+            size_t _waiters_count{0};
+            uint64_t _delayed_files{0};
+    };
+};
+
+#endif
@@ -0,0 +1,318 @@
+#ifndef MULTIPART_FORM_DATA_DETAIL_HANDLER_ALLOCATOR_HPP
+#define MULTIPART_FORM_DATA_DETAIL_HANDLER_ALLOCATOR_HPP
+
+#include <boost/asio/associated_allocator.hpp>
+#include <boost/asio/associated_executor.hpp>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <memory_resource>
+#include <utility>
+
+namespace multipart_form_data
+{
+    namespace detail
+    {
+        // Memory of the intermediate handlers of asynchronous operations of one downloader. Operations of the downloading
+        // process are chained, so there are only a few of their states at once and their sizes repeat for each packet.
+        // Deallocated blocks are kept and reused, so after the first packet the operations don't allocate at all.
+        // Blocks are allocated from the upstream memory resource and each of them is returned to the one it was allocated
+        // from, even if the upstream is changed meanwhile. It is used by one downloading process at a time,
+        // so it doesn't need synchronization.
+        class handler_memory : public std::pmr::memory_resource
+        {
+            public:
+                // Maximum number of kept blocks, it is more than the depth of the operations' nesting
+                static constexpr size_t blocks_count = 8;
+
+                handler_memory() = default;
+                handler_memory(const handler_memory&) = delete;
+                handler_memory& operator=(const handler_memory&) = delete;
+
+                // The operations can't outlive the downloader, so the blocks that are still marked as used are returned too
+                ~handler_memory()
+                {
+                    for (block& current_block : _blocks)
+                    {
+                        if (current_block.pointer)
+                        {
+                            return_block(current_block);
+                        }
+                    }
+                }
+
+                // Set the memory resource that blocks are allocated from. Kept blocks are returned to the previous one,
+                // the used ones are returned to it when they are deallocated.
+                void upstream(std::pmr::memory_resource* upstream) noexcept
+                {
+                    if (upstream != _upstream)
+                    {
+                        release();
+                        _upstream = upstream;
+                    }
+                }
+
+                // Return all unused blocks to the memory resources they were allocated from.
+                void release() noexcept
+                {
+                    for (block& current_block : _blocks)
+                    {
+                        if (current_block.pointer && !current_block.is_used)
+                        {
+                            return_block(current_block);
+                        }
+                    }
+                }
+
+            private:
+                struct block
+                {
+                    void* pointer{nullptr};
+                    size_t size{0};
+                    bool is_used{false};
+                    // Memory resource that the block was allocated from
+                    std::pmr::memory_resource* upstream{nullptr};
+                };
+
+                // The memory that isn't kept in the blocks is prefixed with the memory resource it was allocated from.
+                // The prefix takes the whole alignment, so the returned memory is aligned as requested.
+                static size_t prefix_size(size_t alignment) noexcept
+                {
+                    return std::max(alignment, alignof(std::max_align_t));
+                }
+
+                void* allocate_unkept(size_t bytes, size_t alignment)
+                {
+                    size_t prefix = prefix_size(alignment);
+                    std::byte* memory = static_cast<std::byte*>(_upstream->allocate(bytes + prefix, prefix));
+
+                    std::memcpy(memory + prefix - sizeof(std::pmr::memory_resource*), &_upstream, sizeof(std::pmr::memory_resource*));
+
+                    return memory + prefix;
+                }
+
+                static void deallocate_unkept(void* pointer, size_t bytes, size_t alignment) noexcept
+                {
+                    size_t prefix = prefix_size(alignment);
+                    std::byte* memory = static_cast<std::byte*>(pointer) - prefix;
+                    std::pmr::memory_resource* upstream = nullptr;
+
+                    std::memcpy(&upstream, memory + prefix - sizeof(std::pmr::memory_resource*), sizeof(std::pmr::memory_resource*));
+
+                    upstream->deallocate(memory, bytes + prefix, prefix);
+                }
+
+                static void return_block(block& returned_block) noexcept
+                {
+                    returned_block.upstream->deallocate(returned_block.pointer, returned_block.size, alignof(std::max_align_t));
+                    returned_block = block{};
+                }
+
+                void* do_allocate(size_t bytes, size_t alignment) override
+                {
+                    if (alignment > alignof(std::max_align_t))
+                    {
+                        return allocate_unkept(bytes, alignment);
+                    }
+
+                    // The smallest unused block that fits and the block to replace if there is no such one
+                    block* fitting_block = nullptr;
+                    block* replaced_block = nullptr;
+
+                    for (block& current_block : _blocks)
+                    {
+                        if (current_block.is_used)
+                        {
+                            continue;
+                        }
+
+                        if (current_block.pointer && current_block.size >= bytes)
+                        {
+                            if (!fitting_block || current_block.size < fitting_block->size)
+                            {
+                                fitting_block = &current_block;
+                            }
+                        }
+                        else if (!replaced_block || !current_block.pointer)
+                        {
+                            replaced_block = &current_block;
+                        }
+                    }
+
+                    if (fitting_block)
+                    {
+                        fitting_block->is_used = true;
+
+                        return fitting_block->pointer;
+                    }
+
+                    // All blocks are used so the state is not kept
+                    if (!replaced_block)
+                    {
+                        return allocate_unkept(bytes, alignment);
+                    }
+
+                    if (replaced_block->pointer)
+                    {
+                        return_block(*replaced_block);
+                    }
+
+                    replaced_block->pointer = _upstream->allocate(bytes, alignof(std::max_align_t));
+                    replaced_block->size = bytes;
+                    replaced_block->is_used = true;
+                    replaced_block->upstream = _upstream;
+
+                    return replaced_block->pointer;
+                }
+
+                void do_deallocate(void* pointer, size_t bytes, size_t alignment) override
+                {
+                    for (block& current_block : _blocks)
+                    {
+                        if (current_block.pointer == pointer)
+                        {
+                            current_block.is_used = false;
+
+                            // The block of the previous upstream is not reused, so that upstream can be released
+                            if (current_block.upstream != _upstream)
+                            {
+                                return_block(current_block);
+                            }
+
+                            return;
+                        }
+                    }
+
+                    deallocate_unkept(pointer, bytes, alignment);
+                }
+                bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+                {
+                    return this == &other;
+                }
+
+                std::array<block, blocks_count> _blocks{};
+                std::pmr::memory_resource* _upstream{std::pmr::get_default_resource()};
+        };
+
+        // Allocator that is associated with the intermediate handlers of asynchronous operations so asio allocates
+        // their states from the memory resource of the downloading process.
+        template<typename value_t>
+        class handler_allocator
+        {
+            public:
+                using value_type = value_t;
+
+                explicit handler_allocator(std::pmr::memory_resource* memory_resource) noexcept
+                    :
+                    _memory_resource{memory_resource}
+                {}
+
+                template<typename other_value_t>
+                handler_allocator(const handler_allocator<other_value_t>& other) noexcept
+                    :
+                    _memory_resource{other.memory_resource()}
+                {}
+
+                value_t* allocate(size_t count)
+                {
+                    return static_cast<value_t*>(_memory_resource->allocate(count * sizeof(value_t), alignof(value_t)));
+                }
+
+                void deallocate(value_t* pointer, size_t count) noexcept
+                {
+                    _memory_resource->deallocate(pointer, count * sizeof(value_t), alignof(value_t));
+                }
+
+                std::pmr::memory_resource* memory_resource() const noexcept
+                {
+                    return _memory_resource;
+                }
+
+                template<typename other_value_t>
+                bool operator==(const handler_allocator<other_value_t>& other) const noexcept
+                {
+                    return _memory_resource == other.memory_resource();
+                }
+
+            private:
+                std::pmr::memory_resource* _memory_resource;
+        };
+
+        // Handler that is associated with the allocator over the memory resource.
+        // The executor that is associated with the wrapped handler is kept.
+        template<typename handler_t>
+        class memory_bound_handler
+        {
+            public:
+                memory_bound_handler(std::pmr::memory_resource* memory_resource, handler_t&& handler)
+                    :
+                    _memory_resource{memory_resource},
+                    _handler{std::move(handler)}
+                {}
+
+                template<typename ...arguments_t>
+                void operator()(arguments_t&&... arguments)
+                {
+                    _handler(std::forward<arguments_t>(arguments)...);
+                }
+
+                handler_allocator<void> get_allocator() const noexcept
+                {
+                    return handler_allocator<void>{_memory_resource};
+                }
+
+                const handler_t& handler() const noexcept
+                {
+                    return _handler;
+                }
+
+            private:
+                std::pmr::memory_resource* _memory_resource;
+                handler_t _handler;
+        };
+
+        // Associate the handler with the memory resource.
+        template<typename handler_t>
+        memory_bound_handler<std::decay_t<handler_t>> bind_memory_resource(
+            std::pmr::memory_resource* memory_resource,
+            handler_t&& handler)
+        {
+            return memory_bound_handler<std::decay_t<handler_t>>{memory_resource, std::forward<handler_t>(handler)};
+        }
+    }
+}
+
+namespace boost
+{
+    namespace asio
+    {
+        template<typename handler_t, typename allocator_t>
+        struct associated_allocator<multipart_form_data::detail::memory_bound_handler<handler_t>, allocator_t>
+        {
+            using type = multipart_form_data::detail::handler_allocator<void>;
+
+            static type get(
+                const multipart_form_data::detail::memory_bound_handler<handler_t>& handler,
+                const allocator_t& = allocator_t()) noexcept
+            {
+                return handler.get_allocator();
+            }
+        };
+
+        template<typename handler_t, typename executor_t>
+        struct associated_executor<multipart_form_data::detail::memory_bound_handler<handler_t>, executor_t>
+        {
+            using type = typename associated_executor<handler_t, executor_t>::type;
+
+            static type get(
+                const multipart_form_data::detail::memory_bound_handler<handler_t>& handler,
+                const executor_t& executor = executor_t()) noexcept
+            {
+                return associated_executor<handler_t, executor_t>::get(handler.handler(), executor);
+            }
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef MULTIPART_FORM_DATA_DETAIL_PACKETS_SIZE_CONTROLLER_HPP
+#define MULTIPART_FORM_DATA_DETAIL_PACKETS_SIZE_CONTROLLER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+
+namespace multipart_form_data
+{
+    namespace detail
+    {
+        // Controller of the packets size that adapts it to the receive rate of the connection and the write latency of the disk.
+        // The packet has to be big enough to be received for the target fill time, so slow connections don't hold
+        // large buffers and fast ones make fewer writes, and the write of the packet has to take a small part of that time,
+        // so the disk doesn't stall the connection.
+        class packets_size_controller
+        {
+            public:
+                // Weight of the last measurement in the smoothed estimates
+                static constexpr double smoothing_factor = 0.25;
+                // Minimal ratio of the packet receiving time to the packet writing time
+                static constexpr double write_latency_factor = 4;
+
+                packets_size_controller(
+                    size_t initial_packets_size,
+                    size_t min_packets_size,
+                    size_t max_packets_size,
+                    std::chrono::steady_clock::duration fill_time) noexcept
+                    :
+                    _min_packets_size{std::min(min_packets_size, max_packets_size)},
+                    _max_packets_size{max_packets_size},
+                    _fill_time{std::chrono::duration<double>(fill_time).count()},
+                    _packets_size{std::clamp(initial_packets_size, _min_packets_size, _max_packets_size)}
+                {}
+
+                size_t packets_size() const noexcept
+                {
+                    return _packets_size;
+                }
+
+                /**
+                 * @brief Update the estimates with the packet that was entirely received and written
+                 * and recalculate the packets size.
+                 *
+                 * @param packet_size size of the packet.
+                 * @param read_duration time of receiving the packet.
+                 * @param write_duration time of writing the packet.
+                 *
+                 * @return New packets size.
+                 */
+                size_t update(
+                    size_t packet_size,
+                    std::chrono::steady_clock::duration read_duration,
+                    std::chrono::steady_clock::duration write_duration) noexcept
+                {
+                    // Avoid infinite rate if the packet was already received by the kernel
+                    double read_time = std::max(std::chrono::duration<double>(read_duration).count(), 1e-6);
+                    double rate = static_cast<double>(packet_size) / read_time;
+                    double write_latency = std::chrono::duration<double>(write_duration).count();
+
+                    if (_rate == 0)
+                    {
+                        _rate = rate;
+                        _write_latency = write_latency;
+                    }
+                    else
+                    {
+                        _rate += (rate - _rate) * smoothing_factor;
+                        _write_latency += (write_latency - _write_latency) * smoothing_factor;
+                    }
+
+                    double target_packets_size = _rate * std::max(_fill_time, _write_latency * write_latency_factor);
+
+                    // Change the size at most twice at once to not overreact to bursts
+                    target_packets_size = std::clamp(
+                        target_packets_size,
+                        static_cast<double>(_packets_size) / 2,
+                        static_cast<double>(_packets_size) * 2);
+
+                    _packets_size = std::clamp(static_cast<size_t>(target_packets_size), _min_packets_size, _max_packets_size);
+
+                    return _packets_size;
+                }
+
+            private:
+                size_t _min_packets_size;
+                size_t _max_packets_size;
+                // Target time of receiving one packet in seconds
+                double _fill_time;
+                size_t _packets_size;
+                // Smoothed receive rate in bytes per second and write latency in seconds
+                double _rate{0};
+                double _write_latency{0};
+        };
+    }
+}
+
+#endif
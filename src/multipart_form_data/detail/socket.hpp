@@ -0,0 +1,50 @@
+#ifndef MULTIPART_FORM_DATA_DETAIL_SOCKET_HPP
+#define MULTIPART_FORM_DATA_DETAIL_SOCKET_HPP
+
+#include <boost/beast/core/stream_traits.hpp>
+#include <string>
+
+namespace multipart_form_data
+{
+    namespace detail
+    {
+        // Get the socket that lies under all layers of the stream.
+        // boost::beast::get_lowest_layer stops at boost::beast::basic_stream, so its socket is obtained additionally.
+        template<typename stream_t>
+        auto& lowest_socket(stream_t& stream) noexcept
+        {
+            auto& lowest_layer = boost::beast::get_lowest_layer(stream);
+
+            if constexpr (requires { lowest_layer.socket(); })
+            {
+                return lowest_layer.socket();
+            }
+            else
+            {
+                return lowest_layer;
+            }
+        }
+
+        // Get the string representation of the remote endpoint of the stream if it is an IP socket, otherwise empty string.
+        template<typename stream_t>
+        std::string remote_endpoint(stream_t& stream)
+        {
+            auto& socket = lowest_socket(stream);
+
+            if constexpr (requires (boost::system::error_code error_code) { socket.remote_endpoint(error_code).address(); })
+            {
+                boost::system::error_code error_code;
+                auto endpoint = socket.remote_endpoint(error_code);
+
+                if (!error_code)
+                {
+                    return endpoint.address().to_string() + ":" + std::to_string(endpoint.port());
+                }
+            }
+
+            return std::string{};
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef MULTIPART_FORM_DATA_DETAIL_SOCKET_TUNING_HPP
+#define MULTIPART_FORM_DATA_DETAIL_SOCKET_TUNING_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__linux__)
+    #include <sys/socket.h>
+#else
+    #include <boost/core/ignore_unused.hpp>
+#endif
+
+#include <multipart_form_data/detail/socket.hpp>
+
+namespace multipart_form_data
+{
+    namespace detail
+    {
+        // Tuning of the socket receiving for the bulk transfer of the request body. The low watermark(SO_RCVLOWAT)
+        // makes the socket readable only when enough data is received, so the body is read with fewer and larger reads
+        // instead of waking the reading up for each few KB. It has to be kept well below the rest of the body, otherwise
+        // the last bytes never make the socket readable. The original options are saved when the tuning is applied
+        // and are set back when it is restored.
+        class socket_receive_tuning
+        {
+            public:
+                /**
+                 * @brief Save the original options of the socket that lies under the stream and apply the tuning.
+                 *
+                 * @param stream stream which lowest layer is a socket.
+                 * @param receive_buffer_size size of the receive buffer(SO_RCVBUF), zero keeps the current one.
+                 * @param busy_poll time of busy polling(SO_BUSY_POLL), zero keeps the current one.
+                 *
+                 * @return Whether the socket is tuned. It is not if the stream is not a socket or the platform is not Linux.
+                 */
+                template<typename stream_t>
+                bool apply(stream_t& stream, size_t receive_buffer_size, std::chrono::microseconds busy_poll) noexcept
+                {
+#if defined(__linux__)
+                    auto& socket = lowest_socket(stream);
+
+                    if constexpr (requires { socket.native_handle(); })
+                    {
+                        _socket = socket.native_handle();
+
+                        if (!get_option(SO_RCVLOWAT, _original_low_watermark))
+                        {
+                            _socket = -1;
+
+                            return false;
+                        }
+
+                        _low_watermark = _original_low_watermark;
+
+                        // The kernel reports the doubled size of the buffer, which includes its bookkeeping overhead
+                        if (receive_buffer_size != 0 && get_option(SO_RCVBUF, _original_receive_buffer_size))
+                        {
+                            _original_receive_buffer_size /= 2;
+                            _is_receive_buffer_size_changed = set_option(SO_RCVBUF, static_cast<int>(receive_buffer_size));
+                        }
+
+#if defined(SO_BUSY_POLL)
+                        // Increasing the busy polling time above net.core.busy_read requires CAP_NET_ADMIN
+                        if (busy_poll.count() != 0 && get_option(SO_BUSY_POLL, _original_busy_poll))
+                        {
+                            _is_busy_poll_changed = set_option(SO_BUSY_POLL, static_cast<int>(busy_poll.count()));
+                        }
+#endif
+
+                        return true;
+                    }
+                    else
+                    {
+                        return false;
+                    }
+#else
+                    boost::ignore_unused(stream, receive_buffer_size, busy_poll);
+
+                    return false;
+#endif
+                }
+
+                // Set the low watermark if the socket is tuned and it differs from the current one.
+                void low_watermark(size_t bytes) noexcept
+                {
+#if defined(__linux__)
+                    int low_watermark = static_cast<int>(std::max<size_t>(std::min<size_t>(bytes, INT32_MAX), 1));
+
+                    if (_socket >= 0 && low_watermark != _low_watermark && set_option(SO_RCVLOWAT, low_watermark))
+                    {
+                        _low_watermark = low_watermark;
+                    }
+#else
+                    boost::ignore_unused(bytes);
+#endif
+                }
+
+                // Set the original options back.
+                void restore() noexcept
+                {
+#if defined(__linux__)
+                    if (_socket < 0)
+                    {
+                        return;
+                    }
+
+                    if (_low_watermark != _original_low_watermark)
+                    {
+                        set_option(SO_RCVLOWAT, _original_low_watermark);
+                    }
+
+                    // The size is locked once it is set, so the kernel doesn't autotune the buffer of this connection anymore
+                    if (_is_receive_buffer_size_changed)
+                    {
+                        set_option(SO_RCVBUF, _original_receive_buffer_size);
+                    }
+
+#if defined(SO_BUSY_POLL)
+                    if (_is_busy_poll_changed)
+                    {
+                        set_option(SO_BUSY_POLL, _original_busy_poll);
+                    }
+#endif
+
+                    *this = socket_receive_tuning{};
+#endif
+                }
+
+            private:
+#if defined(__linux__)
+                bool get_option(int option, int& value) const noexcept
+                {
+                    socklen_t value_length = sizeof(value);
+
+                    return getsockopt(_socket, SOL_SOCKET, option, &value, &value_length) == 0;
+                }
+
+                bool set_option(int option, int value) const noexcept
+                {
+                    return setsockopt(_socket, SOL_SOCKET, option, &value, sizeof(value)) == 0;
+                }
+#endif
+
+                int _socket{-1};
+                int _low_watermark{1};
+                int _original_low_watermark{1};
+                int _original_receive_buffer_size{0};
+                int _original_busy_poll{0};
+                bool _is_receive_buffer_size_changed{false};
+                bool _is_busy_poll_changed{false};
+        };
+    }
+}
+
+#endif
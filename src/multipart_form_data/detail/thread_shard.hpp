@@ -0,0 +1,27 @@
+#ifndef MULTIPART_FORM_DATA_DETAIL_THREAD_SHARD_HPP
+#define MULTIPART_FORM_DATA_DETAIL_THREAD_SHARD_HPP
+
+#include <atomic>
+#include <cstddef>
+
+namespace multipart_form_data
+{
+    namespace detail
+    {
+        // Size of the cache line that is used to align per-thread shards to avoid false sharing.
+        inline constexpr size_t cache_line_size = 64;
+
+        // Get the index of the shard that belongs to the calling thread.
+        // Threads are assigned to shards in round-robin order on their first call, so concurrently working threads
+        // write to different shards while there are enough shards for them.
+        inline size_t thread_shard_index(size_t shards_count) noexcept
+        {
+            static std::atomic<size_t> next_thread_index{0};
+            thread_local const size_t thread_index = next_thread_index.fetch_add(1, std::memory_order_relaxed);
+
+            return thread_index % shards_count;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,329 @@
+#ifndef MULTIPART_FORM_DATA_DISK_SCHEDULER_HPP
+#define MULTIPART_FORM_DATA_DISK_SCHEDULER_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(__linux__)
+    #include <sys/stat.h>
+#else
+    #include <boost/core/ignore_unused.hpp>
+#endif
+
+namespace multipart_form_data
+{
+    // Scheduler of the packet writes of all downloaders to one device. At most queue_depth writes are in flight at once,
+    // the other ones wait for a free slot and get it in the order of start-time fair queuing, so each download
+    // gets the share of the device that is proportional to its weight. The downloader doesn't read the next packet
+    // while its write waits, so the download that writes more than its share is slowed down by the flow control of
+    // the connection. The slot is taken only on contention paths under the mutex, writes don't wait if the queue is not full.
+    class disk_scheduler
+    {
+        public:
+            // Write that waits for a slot of the scheduler. It is owned by the downloader and reused for all of its writes.
+            class waiter
+            {
+                public:
+                    virtual ~waiter() = default;
+
+                protected:
+                    // Invoked by the thread that releases the slot once it is granted to the waiter. It is invoked under
+                    // the mutex of the scheduler, so the waiter can't be destroyed meanwhile, but it can't use the scheduler.
+                    virtual void on_granted() noexcept
+                    {}
+
+                private:
+                    friend class disk_scheduler;
+
+                    // Scheduler of the previous write, virtual times of different schedulers are not comparable
+                    disk_scheduler* _scheduler{nullptr};
+                    // Virtual times of the start of the waiting write and of the end of the previous one
+                    uint64_t _start_tag{0};
+                    uint64_t _finish_tag{0};
+                    bool _is_queued{false};
+                    bool _is_granted{false};
+            };
+
+            /**
+             * @param queue_depth maximum number of writes that are in flight at once.
+             */
+            explicit disk_scheduler(size_t queue_depth = 4)
+                : _queue_depth{std::max<size_t>(1, queue_depth)}
+            {}
+
+            disk_scheduler(const disk_scheduler&) = delete;
+            disk_scheduler& operator=(const disk_scheduler&) = delete;
+
+            /**
+             * @brief Change the maximum number of writes that are in flight at once. If it is increased then
+             * the waiting writes get the new slots right away.
+             */
+            void queue_depth(size_t queue_depth)
+            {
+                bool is_granted = false;
+
+                {
+                    std::lock_guard lock{_mutex};
+
+                    _queue_depth = std::max<size_t>(1, queue_depth);
+
+                    while (grant())
+                    {
+                        is_granted = true;
+                    }
+                }
+
+                if (is_granted)
+                {
+                    _granted_condition.notify_all();
+                }
+            }
+
+            size_t queue_depth() const
+            {
+                std::lock_guard lock{_mutex};
+
+                return _queue_depth;
+            }
+
+            size_t writes_in_flight() const
+            {
+                std::lock_guard lock{_mutex};
+
+                return _writes_in_flight;
+            }
+
+            size_t waiting_writes() const
+            {
+                std::lock_guard lock{_mutex};
+
+                return _waiters.size();
+            }
+
+            // Number of writes that waited for a slot since the scheduler is created.
+            uint64_t delayed_writes() const
+            {
+                std::lock_guard lock{_mutex};
+
+                return _delayed_writes;
+            }
+
+            /**
+             * @brief Take a slot for the write of the waiter. If there is no free slot then the write is queued
+             * and on_granted of the waiter is invoked once the slot is granted to it.
+             *
+             * @param bytes size of the write.
+             * @param weight share of the device of the download, writes with a larger weight wait less.
+             *
+             * @return True if the slot is taken, either right away or granted before.
+             */
+            bool acquire(waiter& write_waiter, uint64_t bytes, uint32_t weight)
+            {
+                std::lock_guard lock{_mutex};
+
+                if (write_waiter._is_granted)
+                {
+                    return true;
+                }
+
+                if (write_waiter._is_queued)
+                {
+                    return false;
+                }
+
+                if (write_waiter._scheduler != this)
+                {
+                    write_waiter._scheduler = this;
+                    write_waiter._finish_tag = 0;
+                }
+
+                // The download that was idle doesn't get credit for the time it didn't write
+                write_waiter._start_tag = std::max(_virtual_time, write_waiter._finish_tag);
+                write_waiter._finish_tag = write_waiter._start_tag + bytes / std::max<uint32_t>(1, weight);
+
+                if (_writes_in_flight < _queue_depth && _waiters.empty())
+                {
+                    ++_writes_in_flight;
+
+                    _virtual_time = write_waiter._start_tag;
+                    write_waiter._is_granted = true;
+
+                    return true;
+                }
+
+                write_waiter._is_queued = true;
+
+                _waiters.push_back(&write_waiter);
+                std::push_heap(_waiters.begin(), _waiters.end(), later_start);
+
+                ++_delayed_writes;
+
+                return false;
+            }
+
+            /**
+             * @brief Block the thread until the slot is granted to the waiter that is queued by acquire.
+             */
+            void wait(waiter& write_waiter)
+            {
+                std::unique_lock lock{_mutex};
+
+                _granted_condition.wait(
+                    lock,
+                    [&write_waiter]()
+                    {
+                        return write_waiter._is_granted || !write_waiter._is_queued;
+                    });
+            }
+
+            /**
+             * @brief Release the slot of the waiter after its write is over and grant it to the next waiting write.
+             * Does nothing if the waiter doesn't hold the slot.
+             */
+            void release(waiter& write_waiter)
+            {
+                bool is_granted = false;
+
+                {
+                    std::lock_guard lock{_mutex};
+
+                    if (!write_waiter._is_granted)
+                    {
+                        return;
+                    }
+
+                    write_waiter._is_granted = false;
+                    --_writes_in_flight;
+
+                    is_granted = grant();
+                }
+
+                if (is_granted)
+                {
+                    _granted_condition.notify_all();
+                }
+            }
+
+            /**
+             * @brief Remove the waiter from the queue or release its slot, e.g. if the downloader is destroyed
+             * while its write waits.
+             */
+            void cancel(waiter& write_waiter)
+            {
+                {
+                    std::lock_guard lock{_mutex};
+
+                    if (write_waiter._is_queued)
+                    {
+                        _waiters.erase(std::find(_waiters.begin(), _waiters.end(), &write_waiter));
+                        std::make_heap(_waiters.begin(), _waiters.end(), later_start);
+
+                        write_waiter._is_queued = false;
+                    }
+                }
+
+                release(write_waiter);
+
+                _granted_condition.notify_all();
+            }
+
+        private:
+            static bool later_start(const waiter* left, const waiter* right) noexcept
+            {
+                return left->_start_tag > right->_start_tag;
+            }
+
+            // Grant the free slot to the write with the earliest start. Return false if there is no free slot 
+            // or no waiting write. It has to be invoked under the mutex.
+            bool grant() noexcept
+            {
+                if (_writes_in_flight >= _queue_depth || _waiters.empty())
+                {
+                    return false;
+                }
+
+                std::pop_heap(_waiters.begin(), _waiters.end(), later_start);
+
+                waiter* next_waiter = _waiters.back();
+
+                _waiters.pop_back();
+
+                ++_writes_in_flight;
+
+                _virtual_time = next_waiter->_start_tag;
+                next_waiter->_is_queued = false;
+                next_waiter->_is_granted = true;
+                next_waiter->on_granted();
+
+                return true;
+            }
+
+            mutable std::mutex _mutex{};
+            std::condition_variable _granted_condition{};
+            size_t _queue_depth;
+            size_t _writes_in_flight{0};
+            // Writes that wait for a slot, ordered by the start tag
+            std::vector<waiter*> _waiters{};
+            // Start tag of the last write that got the slot
+            uint64_t _virtual_time{0};
+            uint64_t _delayed_writes{0};
+    };
+
+    // Schedulers of the writes to each device that the output files are placed on. It is shared between all downloaders,
+    // the scheduler of the device is created when the first file is placed on it.
+    class disk_schedulers
+    {
+        public:
+            /**
+             * @param queue_depth maximum number of writes that are in flight at once for each device.
+             */
+            explicit disk_schedulers(size_t queue_depth = 4)
+                : _queue_depth{queue_depth}
+            {}
+
+            /**
+             * @brief Get the scheduler of the device that the file is placed on. The device is not recognized on
+             * platforms other than Linux, so all files share one scheduler there.
+             */
+            disk_scheduler& device(const std::filesystem::path& file_path)
+            {
+                uint64_t device_id = 0;
+
+#if defined(__linux__)
+                struct stat file_status{};
+
+                if (::stat(file_path.c_str(), &file_status) == 0)
+                {
+                    device_id = static_cast<uint64_t>(file_status.st_dev);
+                }
+#else
+                boost::ignore_unused(file_path);
+#endif
+
+                std::lock_guard lock{_mutex};
+
+                std::unique_ptr<disk_scheduler>& scheduler = _schedulers[device_id];
+
+                if (!scheduler)
+                {
+                    scheduler = std::make_unique<disk_scheduler>(_queue_depth);
+                }
+
+                return *scheduler;
+            }
+
+        private:
+            std::mutex _mutex{};
+            size_t _queue_depth;
+            std::map<uint64_t, std::unique_ptr<disk_scheduler>> _schedulers{};
+    };
+};
+
+#endif
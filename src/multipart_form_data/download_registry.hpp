@@ -0,0 +1,359 @@
+#ifndef MULTIPART_FORM_DATA_DOWNLOAD_REGISTRY_HPP
+#define MULTIPART_FORM_DATA_DOWNLOAD_REGISTRY_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <multipart_form_data/detail/thread_shard.hpp>
+#include <multipart_form_data/tcp_info.hpp>
+
+namespace multipart_form_data
+{
+    // Phases that the downloading process passes through.
+    enum class download_phase : uint8_t
+    {
+        // Reading of the boundary before the first file header.
+        reading_preamble,
+        // Reading of the file header.
+        reading_header,
+        // Execution of on_read_file_header_handler.
+        running_header_handler,
+        // Reading of the file body packet.
+        reading_body,
+        // Writing of the file body packet to the file.
+        writing_body,
+        // Execution of on_read_file_body_handler.
+        running_body_handler,
+        // Pause of the reading while the rate limit is exceeded or the admission controller slows the reading down.
+        rate_limited,
+        // Waiting of the file body packet for a slot in the write queue of the device.
+        waiting_for_disk,
+        // Waiting for a free file descriptor before the file is opened.
+        waiting_for_descriptor,
+        // The downloading process is over and the final handler is about to be invoked.
+        finished
+    };
+
+    inline std::string_view to_string(download_phase phase) noexcept
+    {
+        switch (phase)
+        {
+            case download_phase::reading_preamble:
+            {
+                return "reading_preamble";
+            }
+            case download_phase::reading_header:
+            {
+                return "reading_header";
+            }
+            case download_phase::running_header_handler:
+            {
+                return "running_header_handler";
+            }
+            case download_phase::reading_body:
+            {
+                return "reading_body";
+            }
+            case download_phase::writing_body:
+            {
+                return "writing_body";
+            }
+            case download_phase::running_body_handler:
+            {
+                return "running_body_handler";
+            }
+            case download_phase::rate_limited:
+            {
+                return "rate_limited";
+            }
+            case download_phase::waiting_for_disk:
+            {
+                return "waiting_for_disk";
+            }
+            case download_phase::waiting_for_descriptor:
+            {
+                return "waiting_for_descriptor";
+            }
+            case download_phase::finished:
+            {
+                return "finished";
+            }
+            default:
+            {
+                return "unknown";
+            }
+        }
+    }
+
+    // Consistent copy of the download state at the moment of download_registry::snapshot call.
+    struct download_info
+    {
+        // Unique identifier of the downloading process within the registry.
+        uint64_t id;
+        // Remote endpoint of the connection if it is an IP socket, otherwise empty string.
+        std::string peer;
+        // Path of the file that is being downloaded or was downloaded the last.
+        std::filesystem::path file_path;
+        download_phase phase;
+        // Time passed since the downloading start.
+        std::chrono::steady_clock::duration elapsed;
+        // Time passed since the last received or written packet. Long idle time means stuck upload.
+        std::chrono::steady_clock::duration idle;
+        // Bytes of the request body received from the stream.
+        uint64_t bytes_received;
+        // Bytes written to the files.
+        uint64_t bytes_written;
+        // Number of entirely downloaded files.
+        uint64_t files_count;
+        // Receive rate in bytes per second measured over the last rate window.
+        uint64_t receive_rate;
+        // Kernel statistics of the connection sampled at the last file boundary if settings::sample_tcp_info is set.
+        // Fields are read separately, so they can belong to adjacent samples.
+        tcp_info_sample tcp_info;
+    };
+
+    // State record of one downloading process. It is owned by the downloader and is updated only by the thread
+    // that currently performs the downloading, so all updates are relaxed atomic stores without any locks.
+    class download_state
+    {
+        public:
+            // Minimal period of the receive rate recalculation.
+            static constexpr std::chrono::steady_clock::duration rate_window{std::chrono::seconds(1)};
+
+            download_state() = default;
+            download_state(const download_state&) = delete;
+            download_state& operator=(const download_state&) = delete;
+
+            void reset(std::chrono::steady_clock::time_point now) noexcept
+            {
+                _phase.store(download_phase::reading_preamble, std::memory_order_relaxed);
+                _bytes_received.store(0, std::memory_order_relaxed);
+                _bytes_written.store(0, std::memory_order_relaxed);
+                _files_count.store(0, std::memory_order_relaxed);
+                _receive_rate.store(0, std::memory_order_relaxed);
+                _start_time.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+                _last_activity_time.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+                _rate_window_start = now;
+                _rate_window_bytes = 0;
+                tcp_info(tcp_info_sample{});
+            }
+
+            void phase(download_phase phase) noexcept
+            {
+                _phase.store(phase, std::memory_order_relaxed);
+            }
+
+            void add_received(uint64_t bytes, std::chrono::steady_clock::time_point now) noexcept
+            {
+                _bytes_received.store(
+                    _bytes_received.load(std::memory_order_relaxed) + bytes,
+                    std::memory_order_relaxed);
+                _last_activity_time.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+
+                _rate_window_bytes += bytes;
+
+                std::chrono::steady_clock::duration window = now - _rate_window_start;
+
+                // Recalculate the receive rate once per window to smooth out bursts of packets
+                if (window >= rate_window)
+                {
+                    _receive_rate.store(
+                        static_cast<uint64_t>(_rate_window_bytes / std::chrono::duration<double>(window).count()),
+                        std::memory_order_relaxed);
+                    _rate_window_start = now;
+                    _rate_window_bytes = 0;
+                }
+            }
+
+            void add_written(uint64_t bytes, std::chrono::steady_clock::time_point now) noexcept
+            {
+                _bytes_written.store(
+                    _bytes_written.load(std::memory_order_relaxed) + bytes,
+                    std::memory_order_relaxed);
+                _last_activity_time.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+            }
+
+            void add_file() noexcept
+            {
+                _files_count.store(_files_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+
+            void tcp_info(const tcp_info_sample& sample) noexcept
+            {
+                _rtt.store(sample.rtt.count(), std::memory_order_relaxed);
+                _rtt_variance.store(sample.rtt_variance.count(), std::memory_order_relaxed);
+                _receive_rtt.store(sample.receive_rtt.count(), std::memory_order_relaxed);
+                _retransmits.store(sample.retransmits, std::memory_order_relaxed);
+                _receive_window.store(sample.receive_window, std::memory_order_relaxed);
+                _delivery_rate.store(sample.delivery_rate, std::memory_order_relaxed);
+                _tcp_bytes_received.store(sample.bytes_received, std::memory_order_relaxed);
+                _since_last_data_received.store(sample.since_last_data_received.count(), std::memory_order_relaxed);
+            }
+
+        private:
+            friend class download_registry;
+
+            alignas(detail::cache_line_size) std::atomic<download_phase> _phase{download_phase::finished};
+            std::atomic<uint64_t> _bytes_received{0};
+            std::atomic<uint64_t> _bytes_written{0};
+            std::atomic<uint64_t> _files_count{0};
+            std::atomic<uint64_t> _receive_rate{0};
+            // Time points are stored as the number of steady clock ticks since its epoch
+            std::atomic<std::chrono::steady_clock::rep> _start_time{0};
+            std::atomic<std::chrono::steady_clock::rep> _last_activity_time{0};
+            // The last sample of the kernel statistics of the connection
+            std::atomic<std::chrono::microseconds::rep> _rtt{0};
+            std::atomic<std::chrono::microseconds::rep> _rtt_variance{0};
+            std::atomic<std::chrono::microseconds::rep> _receive_rtt{0};
+            std::atomic<uint32_t> _retransmits{0};
+            std::atomic<uint32_t> _receive_window{0};
+            std::atomic<uint64_t> _delivery_rate{0};
+            std::atomic<uint64_t> _tcp_bytes_received{0};
+            std::atomic<std::chrono::milliseconds::rep> _since_last_data_received{0};
+            // Fields that are used only by the updating thread
+            std::chrono::steady_clock::time_point _rate_window_start{};
+            uint64_t _rate_window_bytes{0};
+            // Fields that are guarded by the registry mutex
+            uint64_t _id{0};
+            std::string _peer{};
+            std::filesystem::path _file_path{};
+            download_state* _previous{nullptr};
+            download_state* _next{nullptr};
+            bool _registered{false};
+    };
+
+    // Registry of all in-flight downloads that allows to inspect them at any time, e.g. to find stuck or slow uploads.
+    // Downloads are linked to the registry only at their start and end and when the next file starts,
+    // so the mutex is never taken while the file body is streamed.
+    class download_registry
+    {
+        public:
+            download_registry() = default;
+            download_registry(const download_registry&) = delete;
+            download_registry& operator=(const download_registry&) = delete;
+
+            void add(download_state& state, std::string peer)
+            {
+                std::lock_guard lock{_mutex};
+
+                if (state._registered)
+                {
+                    return;
+                }
+
+                state._id = _next_id++;
+                state._peer = std::move(peer);
+                state._file_path.clear();
+                state._previous = nullptr;
+                state._next = _head;
+                state._registered = true;
+
+                if (_head)
+                {
+                    _head->_previous = &state;
+                }
+
+                _head = &state;
+                ++_size;
+            }
+
+            void remove(download_state& state) noexcept
+            {
+                std::lock_guard lock{_mutex};
+
+                if (!state._registered)
+                {
+                    return;
+                }
+
+                if (state._previous)
+                {
+                    state._previous->_next = state._next;
+                }
+                else
+                {
+                    _head = state._next;
+                }
+
+                if (state._next)
+                {
+                    state._next->_previous = state._previous;
+                }
+
+                state._previous = nullptr;
+                state._next = nullptr;
+                state._registered = false;
+                --_size;
+            }
+
+            // Set the path of the file that is being downloaded.
+            void file_path(download_state& state, const std::filesystem::path& file_path)
+            {
+                std::lock_guard lock{_mutex};
+
+                state._file_path = file_path;
+            }
+
+            // Get the number of in-flight downloads.
+            size_t size() const
+            {
+                std::lock_guard lock{_mutex};
+
+                return _size;
+            }
+
+            // Get the states of all in-flight downloads, the longest running ones come last.
+            std::vector<download_info> snapshot() const
+            {
+                std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                std::vector<download_info> result;
+
+                std::lock_guard lock{_mutex};
+
+                result.reserve(_size);
+
+                for (const download_state* state = _head; state; state = state->_next)
+                {
+                    result.push_back(download_info{
+                        .id = state->_id,
+                        .peer = state->_peer,
+                        .file_path = state->_file_path,
+                        .phase = state->_phase.load(std::memory_order_relaxed),
+                        .elapsed = now - std::chrono::steady_clock::time_point{std::chrono::steady_clock::duration{
+                            state->_start_time.load(std::memory_order_relaxed)}},
+                        .idle = now - std::chrono::steady_clock::time_point{std::chrono::steady_clock::duration{
+                            state->_last_activity_time.load(std::memory_order_relaxed)}},
+                        .bytes_received = state->_bytes_received.load(std::memory_order_relaxed),
+                        .bytes_written = state->_bytes_written.load(std::memory_order_relaxed),
+                        .files_count = state->_files_count.load(std::memory_order_relaxed),
+                        .receive_rate = state->_receive_rate.load(std::memory_order_relaxed),
+                        .tcp_info = tcp_info_sample{
+                            .rtt = std::chrono::microseconds{state->_rtt.load(std::memory_order_relaxed)},
+                            .rtt_variance = std::chrono::microseconds{state->_rtt_variance.load(std::memory_order_relaxed)},
+                            .receive_rtt = std::chrono::microseconds{state->_receive_rtt.load(std::memory_order_relaxed)},
+                            .retransmits = state->_retransmits.load(std::memory_order_relaxed),
+                            .receive_window = state->_receive_window.load(std::memory_order_relaxed),
+                            .delivery_rate = state->_delivery_rate.load(std::memory_order_relaxed),
+                            .bytes_received = state->_tcp_bytes_received.load(std::memory_order_relaxed),
+                            .since_last_data_received = std::chrono::milliseconds{
+                                state->_since_last_data_received.load(std::memory_order_relaxed)}}});
+                }
+
+                return result;
+            }
+
+        private:
+            mutable std::mutex _mutex{};
+            download_state* _head{nullptr};
+            size_t _size{0};
+            uint64_t _next_id{1};
+    };
+}
+
+#endif
@@ -1,11 +1,38 @@
 #ifndef MULTIPART_FORM_DATA_DOWNLOADER_HPP
 #define MULTIPART_FORM_DATA_DOWNLOADER_HPP
 
+#include <boost/asio/execution/outstanding_work.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/prefer.hpp>
 #include <boost/asio/read_until.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <concepts>
 #include <filesystem>
 #include <fstream>
-
+#include <functional>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <thread>
+#include <tuple>
+
+#include <multipart_form_data/admission_controller.hpp>
+#include <multipart_form_data/cpu_dispatch.hpp>
+#include <multipart_form_data/detail/handler_allocator.hpp>
+#include <multipart_form_data/detail/packets_size_controller.hpp>
+#include <multipart_form_data/detail/socket.hpp>
+#include <multipart_form_data/detail/socket_tuning.hpp>
+#include <multipart_form_data/descriptor_budget.hpp>
+#include <multipart_form_data/disk_scheduler.hpp>
+#include <multipart_form_data/download_registry.hpp>
 #include <multipart_form_data/error.hpp>
+#include <multipart_form_data/histograms.hpp>
+#include <multipart_form_data/metrics.hpp>
+#include <multipart_form_data/post_processing.hpp>
+#include <multipart_form_data/probes.hpp>
+#include <multipart_form_data/progress.hpp>
+#include <multipart_form_data/rate_limiter.hpp>
+#include <multipart_form_data/tcp_info.hpp>
 
 namespace multipart_form_data
 {
@@ -22,9 +49,27 @@ namespace multipart_form_data
                 //
                 // Default packet size is 10 MB.
                 size_t packets_size{10 * 1024 * 1024};
+                // Whether to adapt the size of packets to the connection during the downloading process. The size is
+                // recalculated after each packet, so the packet is received for about packets_fill_time and is written
+                // for a small part of that time, within min_packets_size and max_packets_size bounds. 
+                // packets_size is the initial size then.
+                //
+                // Default value is false.
+                bool adaptive_packets_size{false};
+                // Bounds of the adaptive packets size.
+                //
+                // Default bounds are 256 KB and 64 MB.
+                size_t min_packets_size{256 * 1024};
+                size_t max_packets_size{64 * 1024 * 1024};
+                // Target time of receiving one packet in the adaptive mode. Larger time means fewer writes
+                // and more memory per connection.
+                //
+                // Default time is 100 milliseconds.
+                std::chrono::steady_clock::duration packets_fill_time{std::chrono::milliseconds(100)};
                 // The waiting time of asynchronous read operations' execution. After expiry of this time 
                 // the operation will be canceled and request will be aborted with corresponding error code.
-                // Does nothing if used in sync_download
+                // In sync_download it limits the reads only if the stream times out the synchronous reads,
+                // e.g. uring_stream does and beast::tcp_stream doesn't
                 //
                 // Default timeout is 30 seconds.
                 std::chrono::steady_clock::duration operations_timeout{std::chrono::seconds(30)};    
@@ -45,6 +90,150 @@ namespace multipart_form_data
                 // If this handler throw exception then the whole downloading operation is aborted 
                 // and multipart_form_data::error::operation_aborted is set in callback.
                 std::function<void(const std::filesystem::path&, additional_parameters_t&...)> on_read_file_body_handler{};
+                // The registry to record latencies of the downloading phases into. It can be shared between 
+                // all downloaders to obtain process-wide latency distributions, so it has to outlive the downloading process.
+                // If it is nullptr then latencies are not measured at all.
+                //
+                // Default value is nullptr.
+                histogram_registry* latency_histograms{nullptr};
+                // The registry to publish the state of the downloading process into while it is in progress.
+                // It can be shared between all downloaders to inspect all active downloads, so it has to outlive
+                // the downloader.
+                // If it is nullptr then the state is not published.
+                //
+                // Default value is nullptr.
+                download_registry* active_downloads{nullptr};
+                // The counters to account the downloading process in. They can be shared between all downloaders
+                // to obtain process-wide metrics, so they have to outlive the downloader.
+                // If it is nullptr then nothing is counted.
+                //
+                // Default value is nullptr.
+                download_metrics* metrics{nullptr};
+                // Whether to sample kernel statistics of the TCP connection(TCP_INFO) at the beginning and the end of each file 
+                // and at the end of the downloading process. Samples are published to active_downloads and can be
+                // obtained with tcp_info(). It is ignored if the stream is not a TCP socket or the platform is not Linux.
+                //
+                // Default value is false.
+                bool sample_tcp_info{false};
+                // Whether to tune the socket receiving for the duration of the downloading process. The socket doesn't 
+                // wake the reading up until the received data fills the low watermark(SO_RCVLOWAT), which is a part of 
+                // the current packet(after the adaptive size and the rate limit are applied) that never exceeds half 
+                // of the rest of the request body, so the body is read with fewer and larger reads. 
+                // The low watermark requires content_length, otherwise only the buffer size and 
+                // busy polling are tuned. The original options are restored when the downloading process is finished. 
+                // It is ignored if the stream is not a socket or the platform is not Linux.
+                //
+                // Default value is false.
+                bool tune_socket{false};
+                // Size of the kernel receive buffer(SO_RCVBUF) of the tuned socket. Once it is set the kernel doesn't 
+                // autotune the buffer of the connection anymore, even after the original size is restored.
+                // If it is zero then the buffer is not changed.
+                //
+                // Default value is zero.
+                size_t socket_receive_buffer_size{0};
+                // Time of busy polling of the device queue(SO_BUSY_POLL) by reads of the tuned socket, which trades 
+                // CPU time for latency. If it is zero then busy polling is not changed.
+                //
+                // Default value is zero.
+                std::chrono::microseconds socket_busy_poll{0};
+                // Length of the request body, e.g. from Content-Length header. It bounds the low watermark of the tuned
+                // socket, otherwise the last bytes of the body would never wake the reading up. 
+                // If it is zero then the length is unknown.
+                //
+                // Default value is zero.
+                uint64_t content_length{0};
+                // The memory resource to allocate the buffer and the states of intermediate asynchronous operations from
+                // during this downloading process only, e.g. a monotonic arena that is released after the final handler. 
+                // The buffer is returned to the memory resource of the downloader before the final handler is invoked,
+                // so the memory resource has to outlive only the downloading process.
+                // If it is nullptr then the memory resource of the downloader is used.
+                //
+                // Default value is nullptr.
+                std::pmr::memory_resource* memory_resource{nullptr};
+                // The buffer capacity that is kept after the downloading process is over. The buffer grows geometrically 
+                // only while large files are read, so a larger buffer is released before the final handler is invoked
+                // and a keep-alive connection doesn't hold the peak capacity while it waits for the next request.
+                //
+                // Default value is 16 KB.
+                size_t retained_buffer_size{16 * 1024};
+                // The token bucket to limit the receiving rate with, e.g. the one of the connection whose parent is 
+                // the one of the tenant. All received bytes are taken from the bucket and its ancestors, and the reading
+                // is paused while any of them is in debt, so the client is slowed down by the flow control of the connection.
+                // Packets are not larger than the smallest burst of the buckets, so the rate is kept by short pauses.
+                // The burst is taken again after each packet, so a change of the limit caps the downloads in progress too.
+                // The pause is not included in operations_timeout. The bucket has to outlive the downloading process.
+                // If it is nullptr then the rate is not limited.
+                //
+                // Default value is nullptr.
+                token_bucket* rate_limit{nullptr};
+                // The schedulers of the writes to the devices of the output files. Each packet write waits for a slot 
+                // in the write queue of its device and the next packet is not read meanwhile, so the downloads that write 
+                // more than their share of the device are slowed down. The data that is read along with the request header 
+                // is written without waiting. They can be shared between all downloaders, so they have to outlive the downloader.
+                // If it is nullptr then the writes are not scheduled.
+                //
+                // Default value is nullptr.
+                disk_schedulers* disk_scheduling{nullptr};
+                // Share of the device of this downloading process relative to the other ones, e.g. a larger weight
+                // for interactive uploads.
+                //
+                // Default value is 1.
+                uint32_t write_weight{1};
+                // The budget of file descriptors that the downloaders can hold at once. A slot is taken before each file 
+                // is opened and returned when the file is closed. If there is no free slot then the download waits for it 
+                // without reading the request body, so the server queues uploads instead of failing them 
+                // with multipart_form_data::error::invalid_file_path once the process runs out of descriptors.
+                // The download waits for operations_timeout at most, then it fails with 
+                // multipart_form_data::error::descriptor_wait_timeout, so a stalled holder of the slot doesn't hold 
+                // the queue forever.
+                // It can be shared between all downloaders, so it has to outlive the downloader.
+                // If it is nullptr then files are opened right away.
+                //
+                // Default value is nullptr.
+                descriptor_budget* file_descriptors{nullptr};
+                // The controller of the admission of the downloads under the pressure of memory and I/O. The downloading 
+                // process is rejected with multipart_form_data::error::overloaded right away if the pressure is too high. 
+                // Otherwise the reading is paused after the received bytes for the time that grows with the pressure and 
+                // packets are not larger than min_packets_size if the downloading process starts under pressure. 
+                // The latencies of the packet writes are reported to the controller. It can be shared between all 
+                // downloaders, so it has to outlive the downloader.
+                // If it is nullptr then the downloads are always admitted.
+                //
+                // Default value is nullptr.
+                admission_controller* admission_control{nullptr};
+                // The reporter to publish the progress of the downloading process into. The event is published at the start,
+                // at the end and whenever both the interval and the number of bytes of the reporter have passed since 
+                // the previous one, and the callback of the reporter is invoked in its own thread. It can be shared between
+                // all downloaders, so it has to outlive the downloader.
+                // If it is nullptr then the progress is not reported.
+                //
+                // Default value is nullptr.
+                progress_reporter* progress{nullptr};
+                // Identifier of the downloading process in the progress events, e.g. the one of the upload in the UI.
+                //
+                // Default value is zero.
+                uint64_t progress_id{0};
+                // The pool to process the files in after they are entirely written, e.g. to scan, index or make thumbnails.
+                // on_process_file_handler is invoked in a thread of the pool for each file after on_read_file_body_handler, 
+                // so the heavy processing doesn't block the reading of the connections. The pool has to outlive the 
+                // processing of the files. If it is nullptr or on_process_file_handler is not defined then the files
+                // are not processed.
+                //
+                // Default value is nullptr.
+                post_processing_pool* post_processing{nullptr};
+                // The function that will be invoked in a thread of post_processing for each downloaded file. 
+                // Path of the output file is provided as the argument. Additional parameters are not provided, because 
+                // the handler may be invoked after they are passed to the final handler, so the data that is needed
+                // has to be captured by the function itself.
+                // If this handler throws exception then the processing of the other files goes on.
+                std::function<void(const std::filesystem::path&)> on_process_file_handler{};
+                // Whether the final handler is invoked only after all files are processed. Then it is invoked 
+                // through the executor of the stream, and multipart_form_data::error::post_processing_failed is set 
+                // if on_process_file_handler threw exception for any file. sync_download blocks until the files are 
+                // processed in this case.
+                //
+                // Default value is false.
+                bool wait_for_post_processing{false};
             };
             
             /**
@@ -53,15 +242,54 @@ namespace multipart_form_data
              * @param buffer dynamic buffer that is used to read request's headers. It is necessary because 
              * boost::beast::http::(async_)read_header obtains some part of body that contains 
              * multipart/form-data details. It is stored only reference to the buffer, not the actual data.
+             * @param memory_resource memory resource to allocate the buffer and the states of intermediate asynchronous 
+             * operations from, e.g. a pool that is owned by the connection. It has to outlive the downloader.
+             * If it is nullptr then the default memory resource is used for the buffer and the default allocator 
+             * of asio is used for the operations.
              */
             downloader(
                 read_stream& stream, 
-                const dynamic_buffer& buffer)
+                const dynamic_buffer& buffer,
+                std::pmr::memory_resource* memory_resource = nullptr)
                 : 
                 _stream{stream},
-                _input_buffer{buffer}
+                _input_buffer{buffer},
+                _memory_resource{memory_resource},
+                _buffer_storage{memory_resource ? memory_resource : std::pmr::get_default_resource()}
             {}
 
+            ~downloader()
+            {
+                // Leave the queues if the downloader is destroyed while it waits
+                if (_disk_scheduler)
+                {
+                    _disk_scheduler->cancel(_write_waiter);
+                }
+
+                if (_descriptor_budget)
+                {
+                    _descriptor_budget->cancel(_descriptor_waiter);
+                }
+
+                // Unpublish the state if the downloader is destroyed in the middle of the downloading process
+                if (_download_registry)
+                {
+                    _download_registry->remove(_download_state);
+                }
+
+                // Buffer memory is released with the downloader, and the downloading process that is destroyed before 
+                // it is finished, e.g. with the io_context, is counted as aborted
+                if (_metrics)
+                {
+                    if (_is_download_counted)
+                    {
+                        _metrics->add_download_end(error::operation_aborted);
+                    }
+
+                    _metrics->add_buffer_memory(-static_cast<int64_t>(_reported_buffer_memory));
+                }
+            }
+
             /**
              * @brief Asynchronously download files using multipart/form-data protocol.
              * 
@@ -96,12 +324,78 @@ namespace multipart_form_data
                 // Check if the request is actually multipart/form-data
                 if (content_type.find("multipart/form-data") == std::string::npos)
                 {
+                    if (settings.metrics)
+                    {
+                        settings.metrics->add_error(error::not_multipart_form_data_request);
+                    }
+
                     return handler(
                         error::not_multipart_form_data_request, 
                         std::vector<std::filesystem::path>{}, 
                         std::forward<additional_parameters_t>(additional_parameters)...);
                 }
 
+                // Reject the request before anything is read if the server is under pressure
+                if (settings.admission_control && !settings.admission_control->admit())
+                {
+                    if (settings.metrics)
+                    {
+                        settings.metrics->add_error(error::overloaded);
+                    }
+
+                    return handler(
+                        error::overloaded, 
+                        std::vector<std::filesystem::path>{}, 
+                        std::forward<additional_parameters_t>(additional_parameters)...);
+                }
+
+                start_post_processing(settings);
+
+                // The result is kept until all files are processed, then the handler is invoked in the thread of the stream.
+                // The executor tracks the work, so the execution context doesn't run out of work meanwhile
+                if (_post_processing && settings.wait_for_post_processing)
+                {
+                    return async_prepare_files_processing(
+                        content_type, 
+                        std::move(settings),
+                        [handler = std::forward<handler_t>(handler), 
+                            post_processing = _post_processing, 
+                            metrics = settings.metrics,
+                            executor = boost::asio::prefer(_stream.get_executor(), boost::asio::execution::outstanding_work.tracked)](
+                            boost::beast::error_code error_code, 
+                            std::vector<std::filesystem::path>&& file_paths,
+                            auto&&... additional_parameters) mutable -> void
+                        {
+                            // std::function has to be copyable, so the handler is shared
+                            std::shared_ptr<deferred_completion<std::decay_t<handler_t>, additional_parameters_t...>> completion = 
+                                std::make_shared<deferred_completion<std::decay_t<handler_t>, additional_parameters_t...>>(
+                                    std::move(handler),
+                                    post_processing,
+                                    metrics,
+                                    error_code,
+                                    std::move(file_paths),
+                                    std::forward<additional_parameters_t>(additional_parameters)...);
+
+                            bool is_processed = post_processing->finish(
+                                [completion, executor]()
+                                {
+                                    boost::asio::post(
+                                        executor, 
+                                        [completion]()
+                                        {
+                                            (*completion)();
+                                        });
+                                });
+
+                            if (is_processed)
+                            {
+                                (*completion)();
+                            }
+                        }, 
+                        std::move(self_ptr), 
+                        std::forward<additional_parameters_t>(additional_parameters)...);
+                }
+
                 async_prepare_files_processing(
                     content_type, 
                     std::move(settings),
@@ -136,20 +430,264 @@ namespace multipart_form_data
                 if (content_type.find("multipart/form-data") == std::string::npos)
                 {
                     error_code = error::not_multipart_form_data_request;
+
+                    if (settings.metrics)
+                    {
+                        settings.metrics->add_error(error_code);
+                    }
                     
                     return std::vector<std::filesystem::path>{};
                 }
 
+                // Reject the request before anything is read if the server is under pressure
+                if (settings.admission_control && !settings.admission_control->admit())
+                {
+                    error_code = error::overloaded;
+
+                    if (settings.metrics)
+                    {
+                        settings.metrics->add_error(error_code);
+                    }
+
+                    return std::vector<std::filesystem::path>{};
+                }
+
+                start_post_processing(settings);
+
+                bool wait_for_post_processing = _post_processing && settings.wait_for_post_processing;
+
                 sync_prepare_files_processing(
                     content_type, 
                     std::move(settings),
                     error_code, 
                     std::forward<additional_parameters_t>(additional_parameters)...);
 
+                if constexpr (requires { boost::beast::get_lowest_layer(_stream).expires_never(); })
+                {
+                    boost::beast::get_lowest_layer(_stream).expires_never();
+                }
+
+                finish_download(error_code);
+
+                if (wait_for_post_processing)
+                {
+                    _post_processing->wait();
+
+                    if (!error_code && _post_processing->is_failed())
+                    {
+                        error_code = error::post_processing_failed;
+
+                        if (_metrics)
+                        {
+                            _metrics->add_error(error_code);
+                        }
+                    }
+                }
+
                 return _output_file_paths;
             }
             
+            /**
+             * @brief Get kernel statistics of the TCP connection that were sampled the last time.
+             * It is sampled only if settings::sample_tcp_info is set, so it can be used in the final handler
+             * to tell whether the upload was limited by the network.
+             */
+            const tcp_info_sample& tcp_info() const noexcept
+            {
+                return _tcp_info;
+            }
+            
         private:
+            // Type of the buffer that is used for all read operations
+            using buffer_type = boost::asio::dynamic_string_buffer<char, std::char_traits<char>, std::pmr::polymorphic_allocator<char>>;
+
+            // Low watermark of the tuned socket is this part of the packet, but not more than the maximum one.
+            // read_until obtains at most 64 KB at once, so a larger low watermark wouldn't make the reads larger.
+            static constexpr size_t socket_low_watermark_packet_part = 4;
+            static constexpr size_t max_socket_low_watermark = 64 * 1024;
+            // Packets of the rate limited downloading process are not smaller than this size even if the burst is smaller,
+            // so the packet always has room for the data besides the boundary.
+            static constexpr size_t min_rate_limited_packets_size = 64 * 1024;
+            // Whether the stream receives the data without the buffer of the reader and can wait for it, e.g. uring_stream.
+            // Then the buffer isn't held while the connection is idle in the middle of the file body.
+            static constexpr bool is_stream_waitable = requires(read_stream& stream, boost::system::error_code& error_code) 
+            {
+                { stream.is_idle() } -> std::convertible_to<bool>;
+                stream.wait_data(error_code);
+            };
+
+            // Downloader that waits for a slot of the disk scheduler or of the descriptor budget. The asynchronous 
+            // downloading process waits for the pause timer, so it is canceled in the thread of the downloader 
+            // once the slot is granted.
+            template<typename waiter_t>
+            class slot_waiter : public waiter_t
+            {
+                public:
+                    explicit slot_waiter(downloader& downloader) noexcept
+                        : _downloader{&downloader}
+                    {}
+
+                    bool is_async{false};
+
+                protected:
+                    void on_granted() noexcept override
+                    {
+                        if (!is_async)
+                        {
+                            return;
+                        }
+
+                        boost::asio::post(
+                            _downloader->_pause_timer->get_executor(), 
+                            [downloader = _downloader]()
+                            {
+                                downloader->_pause_timer->cancel();
+                            });
+                    }
+
+                private:
+                    downloader* _downloader;
+            };
+
+            // Final handler of the asynchronous downloading process along with its result that is invoked 
+            // once all files are processed.
+            template<typename handler_t, typename ...additional_parameters_t>
+            class deferred_completion
+            {
+                public:
+                    deferred_completion(
+                        handler_t&& handler,
+                        std::shared_ptr<detail::post_processing_batch> post_processing,
+                        download_metrics* metrics,
+                        boost::beast::error_code error_code,
+                        std::vector<std::filesystem::path>&& file_paths,
+                        additional_parameters_t&&... additional_parameters)
+                        :
+                        _handler{std::move(handler)},
+                        _post_processing{std::move(post_processing)},
+                        _metrics{metrics},
+                        _error_code{error_code},
+                        _file_paths{std::move(file_paths)},
+                        _additional_parameters{std::forward<additional_parameters_t>(additional_parameters)...}
+                    {}
+
+                    void operator()()
+                    {
+                        if (!_error_code && _post_processing->is_failed())
+                        {
+                            _error_code = error::post_processing_failed;
+
+                            if (_metrics)
+                            {
+                                _metrics->add_error(_error_code);
+                            }
+                        }
+
+                        std::apply(
+                            [this](auto&... additional_parameters)
+                            {
+                                _handler(
+                                    _error_code, 
+                                    std::move(_file_paths), 
+                                    std::forward<additional_parameters_t>(additional_parameters)...);
+                            },
+                            _additional_parameters);
+                    }
+
+                private:
+                    handler_t _handler;
+                    std::shared_ptr<detail::post_processing_batch> _post_processing;
+                    download_metrics* _metrics;
+                    boost::beast::error_code _error_code;
+                    std::vector<std::filesystem::path> _file_paths;
+                    std::tuple<additional_parameters_t...> _additional_parameters;
+            };
+
+            // Match condition for read_until operations that looks for the delimiter in the buffered data.
+            // It is invoked each time the data is obtained from the stream, so it accounts the received bytes as well.
+            class delimiter_condition
+            {
+                public:
+                    using iterator = boost::asio::buffers_iterator<typename buffer_type::const_buffers_type>;
+                    using result_type = std::pair<iterator, bool>;
+
+                    /**
+                     * @param is_body_end_accepted whether the end of the request body right at the beginning of the buffer
+                     * completes the read as well. It is used for the file headers, which follow the boundaries.
+                     * @param is_drain_accepted whether the read completes once the stream has no received data left and 
+                     * can wait for it without the buffer. It is used for the file bodies.
+                     */
+                    delimiter_condition(
+                        downloader& downloader, 
+                        std::string_view delimiter, 
+                        bool is_body_end_accepted = false,
+                        bool is_drain_accepted = false) noexcept
+                        :
+                        _downloader{&downloader},
+                        _delimiter{delimiter},
+                        _is_body_end_accepted{is_body_end_accepted},
+                        _is_drain_accepted{is_drain_accepted}
+                    {}
+
+                    result_type operator()(iterator begin, iterator end) const noexcept
+                    {
+                        _downloader->account_received();
+
+                        if (begin == end)
+                        {
+                            return {begin, is_drained()};
+                        }
+
+                        // The buffer is contiguous so it can be searched as a string with the kernel that is selected for the CPU
+                        std::string_view data{&*begin, static_cast<size_t>(end - begin)};
+
+                        // The search starts from the beginning of the buffer until there are enough bytes to tell
+                        // the end of the request body from the file header
+                        if (_is_body_end_accepted && data.data() == _downloader->_buffer_storage.data() && 
+                            is_body_end(data.substr(0, 4)))
+                        {
+                            return {begin + 4, true};
+                        }
+
+                        size_t delimiter_position = detail::find(data, _delimiter);
+
+                        if (delimiter_position != std::string_view::npos)
+                        {
+                            return {begin + (delimiter_position + _delimiter.size()), true};
+                        }
+
+                        if (is_drained())
+                        {
+                            return {end, true};
+                        }
+
+                        // Continue the search from the bytes that can be the beginning of the delimiter
+                        return {data.size() < _delimiter.size() ? begin : end - (_delimiter.size() - 1), false};
+                    }
+
+                private:
+                    // Check whether the next read would wait for the data and remember it, so the read is completed 
+                    // with the buffered data.
+                    bool is_drained() const noexcept
+                    {
+                        if constexpr (is_stream_waitable)
+                        {
+                            _downloader->_is_stream_drained = _is_drain_accepted && _downloader->_stream.is_idle();
+
+                            return _downloader->_is_stream_drained;
+                        }
+                        else
+                        {
+                            return false;
+                        }
+                    }
+
+                    downloader* _downloader;
+                    std::string_view _delimiter;
+                    bool _is_body_end_accepted;
+                    bool _is_drain_accepted;
+            };
+
             template<
                 boost::asio::completion_token_for<void(
                     boost::beast::error_code, 
@@ -166,81 +704,137 @@ namespace multipart_form_data
                 // Clear the previous output file paths
                 _output_file_paths.clear();
 
-                // Assign buffer storage with input buffer data because it can store some part of the request body
-                _buffer_storage.assign(
-                    boost::asio::buffers_begin(_input_buffer.data()),
-                    boost::asio::buffers_end(_input_buffer.data()));
+                _latency_histograms = settings.latency_histograms;
+                _download_start = latency_start();
 
-                // Reinitialize buffer with specified packets size limit
-                _buffer.emplace(_buffer_storage, settings.packets_size);
+                use_memory_resource(settings.memory_resource);
+
+                _retained_buffer_size = settings.retained_buffer_size;
 
                 size_t boundary_position = content_type.find("boundary=");
 
+                // Determine the boundary for multipart/form-data content type
+                _boundary = boundary_position == std::string::npos 
+                    ? std::string_view{} 
+                    : content_type.substr(boundary_position + 9);
+
+                // Small request body can be entirely read by the caller along with the request header, then it is 
+                // processed in one pass without publishing the state, sampling the connection or touching the stream
+                bool is_body_buffered = is_request_body_buffered();
+
+                // Publish the downloading state, initially received bytes are the ones obtained with the request header
+                _download_registry = is_body_buffered ? nullptr : settings.active_downloads;
+                if (_download_registry)
+                {
+                    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+                    _download_state.reset(now);
+                    _download_state.add_received(boost::asio::buffer_size(_input_buffer.data()), now);
+                    _download_registry->add(_download_state, detail::remote_endpoint(_stream));
+                }
+
+                start_metrics(settings.metrics, boost::asio::buffer_size(_input_buffer.data()));
+
+                _sample_tcp_info = settings.sample_tcp_info && !is_body_buffered;
+                _tcp_info = tcp_info_sample{};
+
+                tune_socket(settings, is_body_buffered);
+
+                start_rate_limit(settings.rate_limit);
+
+                use_descriptor_budget(settings.file_descriptors);
+
+                start_admission_control(settings);
+
+                start_progress(settings);
+
                 // Boundary was not found in the content type
                 if (boundary_position == std::string::npos)
                 {
+                    finish_download(error::invalid_structure);
+
                     return handler(
                         error::invalid_structure, 
                         std::vector<std::filesystem::path>{}, 
                         std::forward<additional_parameters_t>(additional_parameters)...);
                 }
 
-                // Determine the boundary for multipart/form-data content type
-                _boundary = content_type.substr(boundary_position + 9);
+                boost::beast::error_code error_code;
+
+                // Process the part of the request body that is already read by the caller
+                download_phase phase = process_input_data(settings, error_code, additional_parameters...);
+
+                if (error_code || phase == download_phase::finished)
+                {
+                    finish_download(error_code);
+
+                    return handler(
+                        error_code, 
+                        std::move(_output_file_paths), 
+                        std::forward<additional_parameters_t>(additional_parameters)...);
+                }
+
+                // Reinitialize buffer with specified packets size limit
+                _buffer.emplace(_buffer_storage, initial_packets_size(settings));
+
+                // Go on reading from the point where the data read by the caller is over
+                if (phase == download_phase::reading_header)
+                {
+                    return async_read_file_header(
+                        std::move(settings), 
+                        std::forward<handler_t>(handler),
+                        std::move(self_ptr),
+                        std::forward<additional_parameters_t>(additional_parameters)...);
+                }
+
+                if (phase == download_phase::reading_body)
+                {
+                    return async_read_file_body(
+                        std::move(settings), 
+                        std::forward<handler_t>(handler),
+                        std::move(self_ptr),
+                        std::forward<additional_parameters_t>(additional_parameters)...);
+                }
 
                 // Set the timeout
                 boost::beast::get_lowest_layer(_stream).expires_after(settings.operations_timeout);
 
+                begin_read(download_phase::reading_preamble);
+
                 // Read the boundary before the header of the first file 
-                boost::asio::async_read_until(_stream, *_buffer, _boundary, 
-                    boost::beast::bind_front_handler(
-                        [this, self_ptr](
-                            downloader::settings<additional_parameters_t...>&& settings,
-                            handler_t&& handler,
-                            additional_parameters_t&&... additional_parameters,
-                            boost::beast::error_code error_code, 
-                            std::size_t bytes_transferred) mutable
-                        {
-                            if (error_code)
+                boost::asio::async_read_until(_stream, *_buffer, delimiter_condition{*this, _boundary}, 
+                    detail::bind_memory_resource(&_handler_memory, 
+                        boost::beast::bind_front_handler(
+                            [this, self_ptr](
+                                downloader::settings<additional_parameters_t...>&& settings,
+                                handler_t&& handler,
+                                additional_parameters_t&&... additional_parameters,
+                                boost::beast::error_code error_code, 
+                                std::size_t bytes_transferred) mutable
                             {
-                                return handler(
-                                    error_code, 
-                                    std::vector<std::filesystem::path>{}, 
-                                    std::forward<additional_parameters_t>(additional_parameters)...);
-                            }
 
-                            // Consume read bytes as it is just the boundary
-                            _buffer->consume(bytes_transferred);
+                                if (error_code)
+                                {
+                                    finish_download(error_code);
 
-                            // Set the timeout
-                            boost::beast::get_lowest_layer(_stream).expires_after(settings.operations_timeout);
+                                    return handler(
+                                        error_code, 
+                                        std::vector<std::filesystem::path>{}, 
+                                        std::forward<additional_parameters_t>(additional_parameters)...);
+                                }
 
-                            // Read the first file header obtaining bytes until the empty string 
-                            // that represents the delimiter between file header and data itself
-                            boost::asio::async_read_until(_stream, *_buffer, "\r\n\r\n", 
-                                boost::beast::bind_front_handler(
-                                    [this, self_ptr](
-                                        downloader::settings<additional_parameters_t...>&& settings,
-                                        handler_t&& handler,
-                                        additional_parameters_t&&... additional_parameters,
-                                        boost::beast::error_code error_code, 
-                                        std::size_t bytes_transferred) mutable
-                                    {
-                                        async_process_file_header(
-                                            std::move(settings),
-                                            std::forward<handler_t>(handler), 
-                                            std::move(self_ptr), 
-                                            error_code, 
-                                            bytes_transferred,
-                                            std::forward<additional_parameters_t>(additional_parameters)...);
-                                    },
+                                // Consume read bytes as it is just the boundary
+                                _buffer->consume(bytes_transferred);
+
+                                async_read_file_header(
                                     std::move(settings),
-                                    std::forward<handler_t>(handler),
-                                    std::forward<additional_parameters_t>(additional_parameters)...));
-                        },
-                        std::move(settings),
-                        std::forward<handler_t>(handler),
-                        std::forward<additional_parameters_t>(additional_parameters)...));
+                                    std::forward<handler_t>(handler), 
+                                    std::move(self_ptr), 
+                                    std::forward<additional_parameters_t>(additional_parameters)...);
+                            },
+                            std::move(settings),
+                            std::forward<handler_t>(handler),
+                            std::forward<additional_parameters_t>(additional_parameters)...)));
             }
 
             template<
@@ -249,148 +843,232 @@ namespace multipart_form_data
                     std::vector<std::filesystem::path>&&)> handler_t, 
                 typename session_t,
                 typename ...additional_parameters_t>
-            void async_process_file_header(
-                settings<additional_parameters_t...>&& settings,
+            void async_read_file_header(
+                settings<additional_parameters_t...>&& settings, 
                 handler_t&& handler, 
                 std::shared_ptr<session_t>&& self_ptr,
-                boost::beast::error_code error_code, 
-                std::size_t bytes_transferred,
                 additional_parameters_t&&... additional_parameters)
             {
-                if (error_code)
+                // Pause the reading until the rate limit is not exceeded anymore
+                if (is_rate_limited())
                 {
-                    // Reset the timeout
-                    boost::beast::get_lowest_layer(_stream).expires_never();
-                    
-                    return handler(
-                        error_code, 
-                        std::move(_output_file_paths), 
-                        std::forward<additional_parameters_t>(additional_parameters)...);
+                    pause_reading();
+
+                    return _pause_timer->async_wait(
+                        detail::bind_memory_resource(&_handler_memory, 
+                            boost::beast::bind_front_handler(
+                                [this, self_ptr](
+                                    downloader::settings<additional_parameters_t...>&& settings,
+                                    handler_t&& handler,
+                                    additional_parameters_t&&... additional_parameters,
+                                    boost::beast::error_code error_code) mutable
+                                {
+                                    boost::ignore_unused(error_code);
+
+                                    async_read_file_header(
+                                        std::move(settings),
+                                        std::forward<handler_t>(handler), 
+                                        std::move(self_ptr), 
+                                        std::forward<additional_parameters_t>(additional_parameters)...);
+                                },
+                                std::move(settings),
+                                std::forward<handler_t>(handler),
+                                std::forward<additional_parameters_t>(additional_parameters)...)));
                 }
 
-                // Construct the string representation of obtained file header
-                std::string_view file_header_data{
-                    _buffer_storage.data(),
-                    bytes_transferred};
+                // Set the timeout
+                boost::beast::get_lowest_layer(_stream).expires_after(settings.operations_timeout);
 
-                // Position of the filename field in the file header
-                size_t file_name_position = file_header_data.find("filename=\"");
+                begin_read(download_phase::reading_header);
 
-                // filename field is absent
-                if (file_name_position == std::string::npos)
-                {
-                    // Reset the timeout
-                    boost::beast::get_lowest_layer(_stream).expires_never();
-                    
-                    return handler(
-                        error::invalid_structure, 
-                        std::move(_output_file_paths), 
-                        std::forward<additional_parameters_t>(additional_parameters)...);
+                // Read the file header obtaining bytes until the empty string
+                // that represents the delimiter between file header and data itself
+                boost::asio::async_read_until(_stream, *_buffer, delimiter_condition{*this, "\r\n\r\n", true}, 
+                    detail::bind_memory_resource(&_handler_memory, 
+                        boost::beast::bind_front_handler(
+                            [this, self_ptr](
+                                downloader::settings<additional_parameters_t...>&& settings,
+                                handler_t&& handler,
+                                additional_parameters_t&&... additional_parameters,
+                                boost::beast::error_code error_code, 
+                                std::size_t bytes_transferred) mutable
+                            {
+                                async_process_file_header(
+                                    std::move(settings),
+                                    std::forward<handler_t>(handler), 
+                                    std::move(self_ptr), 
+                                    error_code, 
+                                    bytes_transferred,
+                                    std::forward<additional_parameters_t>(additional_parameters)...);
+                            },
+                            std::move(settings),
+                            std::forward<handler_t>(handler),
+                            std::forward<additional_parameters_t>(additional_parameters)...)));
+            }
+
+            template<
+                boost::asio::completion_token_for<void(
+                    boost::beast::error_code, 
+                    std::vector<std::filesystem::path>&&)> handler_t, 
+                typename session_t,
+                typename ...additional_parameters_t>
+            void async_read_file_body(
+                settings<additional_parameters_t...>&& settings, 
+                handler_t&& handler, 
+                std::shared_ptr<session_t>&& self_ptr,
+                additional_parameters_t&&... additional_parameters)
+            {
+                // Pause the reading until the rate limit is not exceeded anymore
+                if (is_rate_limited())
+                {
+                    pause_reading();
+
+                    return _pause_timer->async_wait(
+                        detail::bind_memory_resource(&_handler_memory, 
+                            boost::beast::bind_front_handler(
+                                [this, self_ptr](
+                                    downloader::settings<additional_parameters_t...>&& settings,
+                                    handler_t&& handler,
+                                    additional_parameters_t&&... additional_parameters,
+                                    boost::beast::error_code error_code) mutable
+                                {
+                                    boost::ignore_unused(error_code);
+
+                                    async_read_file_body(
+                                        std::move(settings),
+                                        std::forward<handler_t>(handler), 
+                                        std::move(self_ptr), 
+                                        std::forward<additional_parameters_t>(additional_parameters)...);
+                                },
+                                std::move(settings),
+                                std::forward<handler_t>(handler),
+                                std::forward<additional_parameters_t>(additional_parameters)...)));
                 }
 
-                // Remove the data before the actual file name
-                file_header_data.remove_prefix(file_name_position + 10);
+                // Set the timeout
+                boost::beast::get_lowest_layer(_stream).expires_after(settings.operations_timeout);
 
-                // Look for the end of the file name
-                // Find from the end because actual file name can contain double quotes
-                file_name_position = file_header_data.rfind('"');
+                begin_read(download_phase::reading_body);
 
-                // No closing double quote in filename
-                if (file_name_position == std::string::npos)
+                // Read the file body obtaining bytes until either we find a boundary that represents the end of file
+                // or read the packet of maximum size
+                boost::asio::async_read_until(_stream, *_buffer, delimiter_condition{*this, _boundary, false, true}, 
+                    detail::bind_memory_resource(&_handler_memory, 
+                        boost::beast::bind_front_handler(
+                            [this, self_ptr](
+                                downloader::settings<additional_parameters_t...>&& settings,
+                                handler_t&& handler,
+                                additional_parameters_t&&... additional_parameters,
+                                boost::beast::error_code error_code, 
+                                std::size_t bytes_transferred) mutable
+                            {
+                                async_process_file_body(
+                                    std::move(settings),
+                                    std::forward<handler_t>(handler), 
+                                    std::move(self_ptr), 
+                                    error_code, 
+                                    bytes_transferred,
+                                    std::forward<additional_parameters_t>(additional_parameters)...);
+                            },
+                            std::move(settings),
+                            std::forward<handler_t>(handler),
+                            std::forward<additional_parameters_t>(additional_parameters)...)));
+            }
+
+            template<
+                boost::asio::completion_token_for<void(
+                    boost::beast::error_code, 
+                    std::vector<std::filesystem::path>&&)> handler_t, 
+                typename session_t,
+                typename ...additional_parameters_t>
+            void async_process_file_header(
+                settings<additional_parameters_t...>&& settings, 
+                handler_t&& handler, 
+                std::shared_ptr<session_t>&& self_ptr,
+                boost::beast::error_code error_code, 
+                std::size_t bytes_transferred,
+                additional_parameters_t&&... additional_parameters)
+            {
+                // The request body is over instead of the next file header, e.g. the line break after the last boundary 
+                // came in the next packet
+                if (!error_code && is_body_end({_buffer_storage.data(), bytes_transferred}))
                 {
+                    _buffer->consume(bytes_transferred);
+
                     // Reset the timeout
                     boost::beast::get_lowest_layer(_stream).expires_never();
-                    
+
+                    finish_download(error_code);
+
                     return handler(
-                        error::invalid_structure, 
+                        error_code, 
                         std::move(_output_file_paths), 
                         std::forward<additional_parameters_t>(additional_parameters)...);
                 }
 
-                // Get the actual file name
-                file_header_data.remove_suffix(file_header_data.size() - file_name_position);
-
-                if (settings.on_read_file_header_handler)
-                {
-                    try
-                    {
-                        _file_path = settings.on_read_file_header_handler(file_header_data, additional_parameters...);
-                    }
-                    catch (...)
-                    {
-                        return handler(
-                            error::operation_aborted, 
-                            std::move(_output_file_paths), 
-                            std::forward<additional_parameters_t>(additional_parameters)...);
-                    }
-                    
-                    if (_file_path.empty())
-                    {
-                        if (!generate_file_path(settings.output_directory, file_header_data, error_code))
-                        {
-                            return handler(
-                                error_code, 
-                                std::move(_output_file_paths), 
-                                std::forward<additional_parameters_t>(additional_parameters)...);
-                        }
-                    }
-                }
-                else
+                // Wait for a free file descriptor before the file is opened
+                if (!error_code && !async_acquire_descriptor(settings.operations_timeout))
                 {
-                    if (!generate_file_path(settings.output_directory, file_header_data, error_code))
-                    {
-                        return handler(
-                            error_code, 
-                            std::move(_output_file_paths), 
-                            std::forward<additional_parameters_t>(additional_parameters)...);
-                    }
+                    return _pause_timer->async_wait(
+                        detail::bind_memory_resource(&_handler_memory, 
+                            boost::beast::bind_front_handler(
+                                [this, self_ptr, bytes_transferred](
+                                    downloader::settings<additional_parameters_t...>&& settings,
+                                    handler_t&& handler,
+                                    additional_parameters_t&&... additional_parameters,
+                                    boost::beast::error_code timer_error_code) mutable
+                                {
+                                    boost::ignore_unused(timer_error_code);
+
+                                    // The timer is canceled once the slot is granted, otherwise it is expired
+                                    boost::beast::error_code error_code;
+
+                                    if (!_descriptor_budget->try_acquire(_descriptor_waiter))
+                                    {
+                                        _descriptor_budget->cancel(_descriptor_waiter);
+
+                                        error_code = error::descriptor_wait_timeout;
+                                    }
+
+                                    async_process_file_header(
+                                        std::move(settings),
+                                        std::forward<handler_t>(handler), 
+                                        std::move(self_ptr), 
+                                        error_code, 
+                                        bytes_transferred,
+                                        std::forward<additional_parameters_t>(additional_parameters)...);
+                                },
+                                std::move(settings),
+                                std::forward<handler_t>(handler),
+                                std::forward<additional_parameters_t>(additional_parameters)...)));
                 }
 
-                // Open the file to write the obtaining data
-                _file.open(_file_path, std::ios::binary);
-
-                // Invalid file path was provided
-                if (!_file.is_open())
+                if (error_code ||
+                    !open_file(
+                        std::string_view{_buffer_storage.data(), bytes_transferred},
+                        settings,
+                        error_code, 
+                        additional_parameters...))
                 {
                     // Reset the timeout
                     boost::beast::get_lowest_layer(_stream).expires_never();
-                     
+
+                    finish_download(error_code);
+
                     return handler(
-                        error::invalid_file_path, 
+                        error_code, 
                         std::move(_output_file_paths), 
                         std::forward<additional_parameters_t>(additional_parameters)...);
                 }
-                
-                // Store provided file path
-                _output_file_paths.emplace_back(_file_path);
 
                 // Consume the file header bytes 
-                _buffer->consume(bytes_transferred);
-
-                // Set the timeout
-                boost::beast::get_lowest_layer(_stream).expires_after(settings.operations_timeout);
+                _buffer->consume(bytes_transferred); 
 
-                // Read the file body obtaining bytes until the boundary that represents the end of file
-                boost::asio::async_read_until(_stream, *_buffer, _boundary,
-                    boost::beast::bind_front_handler(
-                        [this, self_ptr](
-                            downloader::settings<additional_parameters_t...>&& settings,
-                            handler_t&& handler,
-                            additional_parameters_t&&... additional_parameters,
-                            boost::beast::error_code error_code, 
-                            std::size_t bytes_transferred) mutable
-                        {
-                            async_process_file_body(
-                                std::move(settings),
-                                std::forward<handler_t>(handler), 
-                                std::move(self_ptr), 
-                                error_code, 
-                                bytes_transferred,
-                                std::forward<additional_parameters_t>(additional_parameters)...);
-                        },
-                        std::move(settings),
-                        std::forward<handler_t>(handler),
-                        std::forward<additional_parameters_t>(additional_parameters)...));
+                async_read_file_body(
+                    std::move(settings), 
+                    std::forward<handler_t>(handler),
+                    std::move(self_ptr),
+                    std::forward<additional_parameters_t>(additional_parameters)...);
             }
 
             template<
@@ -400,51 +1078,110 @@ namespace multipart_form_data
                 typename session_t,
                 typename ...additional_parameters_t>
             void async_process_file_body(
-                settings<additional_parameters_t...>&& settings,
+                settings<additional_parameters_t...>&& settings, 
                 handler_t&& handler, 
                 std::shared_ptr<session_t>&& self_ptr,
                 boost::beast::error_code error_code, 
                 std::size_t bytes_transferred,
                 additional_parameters_t&&... additional_parameters)
             {
+                // Wait for a slot in the write queue of the device before the obtained data is written
+                if ((!error_code || error_code == boost::asio::error::not_found) && 
+                    !async_acquire_write_slot(_buffer_storage.size(), settings.write_weight))
+                {
+                    return _pause_timer->async_wait(
+                        detail::bind_memory_resource(&_handler_memory, 
+                            boost::beast::bind_front_handler(
+                                [this, self_ptr, error_code, bytes_transferred](
+                                    downloader::settings<additional_parameters_t...>&& settings,
+                                    handler_t&& handler,
+                                    additional_parameters_t&&... additional_parameters,
+                                    boost::beast::error_code timer_error_code) mutable
+                                {
+                                    boost::ignore_unused(timer_error_code);
+
+                                    async_process_file_body(
+                                        std::move(settings),
+                                        std::forward<handler_t>(handler), 
+                                        std::move(self_ptr), 
+                                        error_code, 
+                                        bytes_transferred,
+                                        std::forward<additional_parameters_t>(additional_parameters)...);
+                                },
+                                std::move(settings),
+                                std::forward<handler_t>(handler),
+                                std::forward<additional_parameters_t>(additional_parameters)...)));
+                }
+
+                // The received data of the stream ran out, so the connection waits for the next data without the buffer
+                if constexpr (is_stream_waitable)
+                {
+                    if (!error_code && _is_stream_drained)
+                    {
+                        release_drained_packet();
+
+                        // Set the timeout
+                        boost::beast::get_lowest_layer(_stream).expires_after(settings.operations_timeout);
+
+                        return _stream.async_wait_data(
+                            detail::bind_memory_resource(&_handler_memory, 
+                                boost::beast::bind_front_handler(
+                                    [this, self_ptr](
+                                        downloader::settings<additional_parameters_t...>&& settings,
+                                        handler_t&& handler,
+                                        additional_parameters_t&&... additional_parameters,
+                                        boost::beast::error_code error_code) mutable
+                                    {
+                                        if (error_code)
+                                        {
+                                            return async_process_file_body(
+                                                std::move(settings),
+                                                std::forward<handler_t>(handler), 
+                                                std::move(self_ptr), 
+                                                error_code, 
+                                                0,
+                                                std::forward<additional_parameters_t>(additional_parameters)...);
+                                        }
+
+                                        async_read_file_body(
+                                            std::move(settings),
+                                            std::forward<handler_t>(handler), 
+                                            std::move(self_ptr), 
+                                            std::forward<additional_parameters_t>(additional_parameters)...);
+                                    },
+                                    std::move(settings),
+                                    std::forward<handler_t>(handler),
+                                    std::forward<additional_parameters_t>(additional_parameters)...)));
+                    }
+                }
+
                 // File can't be read at once as it is too big(more than settings.packets_size bytes)
                 // Process obtained packet and go on reading
                 if (error_code == boost::asio::error::not_found)
                 {
+                    MULTIPART_FORM_DATA_PROBE(packet_read, this, _buffer_storage.size());
+
+                    record_latency(latency_phase::packet_reading, _read_start);
+
+                    std::chrono::steady_clock::time_point read_end = packet_time();
+                    size_t packet_size = _buffer_storage.size();
+
                     // Write obtained packet to the file
                     // Don't touch last symbols with boundary length as we could stop in the middle of boundary
                     // so we would write the part of boundary to the file
-                    _file.write(
-                        _buffer_storage.data(),
-                        _buffer_storage.size() - _boundary.size());
+                    write_packet(_buffer_storage.data(), packet_size - _boundary.size());
 
                     // Consume written bytes
-                    _buffer->consume(_buffer_storage.size() - _boundary.size());
+                    _buffer->consume(packet_size - _boundary.size());
 
-                    // Set the timeout
-                    boost::beast::get_lowest_layer(_stream).expires_after(settings.operations_timeout);
+                    adapt_packets_size(packet_size, read_end);
 
                     // Read the next data until either we find a boundary or read the packet of maximum size again 
-                    return boost::asio::async_read_until(_stream, *_buffer, _boundary, 
-                        boost::beast::bind_front_handler(
-                            [this, self_ptr](
-                                downloader::settings<additional_parameters_t...>&& settings,
-                                handler_t&& handler,
-                                additional_parameters_t&&... additional_parameters,
-                                boost::beast::error_code error_code, 
-                                std::size_t bytes_transferred) mutable
-                            {
-                                async_process_file_body(
-                                    std::move(settings),
-                                    std::forward<handler_t>(handler), 
-                                    std::move(self_ptr), 
-                                    error_code, 
-                                    bytes_transferred,
-                                    std::forward<additional_parameters_t>(additional_parameters)...);
-                            },
-                            std::move(settings),
-                            std::forward<handler_t>(handler),
-                            std::forward<additional_parameters_t>(additional_parameters)...));
+                    return async_read_file_body(
+                        std::move(settings), 
+                        std::forward<handler_t>(handler),
+                        std::move(self_ptr),
+                        std::forward<additional_parameters_t>(additional_parameters)...);
                 }
 
                 // Unexpected error occured so clean up everything about not uploaded file
@@ -452,19 +1189,10 @@ namespace multipart_form_data
                 {
                     // Reset the timeout
                     boost::beast::get_lowest_layer(_stream).expires_never();
-                    
-                    _file.close();
 
-                    // Remove the file from the file system
-                    try
-                    {
-                        std::filesystem::remove(_output_file_paths.back());
-                    }
-                    catch (const std::exception& ex)
-                    {}
+                    remove_file();
 
-                    // Remove the file from the list of uploaded files 
-                    _output_file_paths.pop_back();
+                    finish_download(error_code);
 
                     return handler(
                         error_code, 
@@ -472,91 +1200,107 @@ namespace multipart_form_data
                         std::forward<additional_parameters_t>(additional_parameters)...);
                 }
 
+                MULTIPART_FORM_DATA_PROBE(packet_read, this, bytes_transferred);
+
+                record_latency(latency_phase::packet_reading, _read_start);
+
                 // Write obtained bytes to the file excluding CRLF after the file data and -- followed by boundary
                 // -- is the part of the boundary, used only in body, so we have to consider this -- length because
                 // _boudary variable doesn't contain it
-                _file.write(_buffer_storage.data(), bytes_transferred - _boundary.size() - 4);
-
-                // Close the file as its uploading is over
-                _file.close();
-
-                // Invoke handler after reading the whole file body if it is defined
-                if (settings.on_read_file_body_handler)
+                if (!complete_file(
+                        _buffer_storage.data(),
+                        bytes_transferred - _boundary.size() - 4,
+                        settings,
+                        error_code, 
+                        additional_parameters...))
                 {
-                    try
-                    {
-                        settings.on_read_file_body_handler(_output_file_paths.back(), additional_parameters...);
-                    }
-                    catch (...)
-                    {
-                        return handler(
-                            error::operation_aborted, 
-                            std::move(_output_file_paths), 
-                            std::forward<additional_parameters_t>(additional_parameters)...);
-                    }
+                    finish_download(error_code);
+
+                    return handler(
+                        error_code, 
+                        std::move(_output_file_paths), 
+                        std::forward<additional_parameters_t>(additional_parameters)...);
                 }
 
                 // Consume obtained bytes
                 _buffer->consume(bytes_transferred); 
 
                 // If there is "--" after the boundary then there are no more files and request body is over
-                if (std::string_view{_buffer_storage.data(), _buffer_storage.size()} == "--\r\n")
+                if (is_body_end({_buffer_storage.data(), _buffer_storage.size()}))
                 {
                     // Reset the timeout
                     boost::beast::get_lowest_layer(_stream).expires_never();
-                   
+
+                    finish_download(error_code);
+
                     return handler(
                         error_code, 
                         std::move(_output_file_paths), 
                         std::forward<additional_parameters_t>(additional_parameters)...);
                 }
-                
-                // Set the timeout
-                boost::beast::get_lowest_layer(_stream).expires_after(settings.operations_timeout);
-                
+
                 // Read the next file header
-                boost::asio::async_read_until(_stream, *_buffer, "\r\n\r\n", 
-                    boost::beast::bind_front_handler(
-                        [this, self_ptr](
-                            downloader::settings<additional_parameters_t...>&& settings,
-                            handler_t&& handler,
-                            additional_parameters_t&&... additional_parameters,
-                            boost::beast::error_code error_code, 
-                            std::size_t bytes_transferred) mutable
-                        {
-                            async_process_file_header(
-                                std::move(settings),
-                                std::forward<handler_t>(handler), 
-                                std::move(self_ptr), 
-                                error_code, 
-                                bytes_transferred,
-                                std::forward<additional_parameters_t>(additional_parameters)...);
-                        },
-                        std::move(settings),
-                        std::forward<handler_t>(handler),
-                        std::forward<additional_parameters_t>(additional_parameters)...));
+                async_read_file_header(
+                    std::move(settings), 
+                    std::forward<handler_t>(handler),
+                    std::move(self_ptr),
+                    std::forward<additional_parameters_t>(additional_parameters)...);
             }
 
             template<typename ...additional_parameters_t>
             void sync_prepare_files_processing(
                 std::string_view content_type, 
                 settings<additional_parameters_t...>&& settings, 
-                boost::beast::error_code& error_code,
+                boost::beast::error_code& error_code, 
                 additional_parameters_t&&... additional_parameters)
             {
                 // Clear the previous output file paths
                 _output_file_paths.clear();
 
-                // Assign buffer storage with input buffer data because it can store some part of the request body
-                _buffer_storage.assign(
-                    boost::asio::buffers_begin(_input_buffer.data()),
-                    boost::asio::buffers_end(_input_buffer.data()));
+                _latency_histograms = settings.latency_histograms;
+                _download_start = latency_start();
 
-                // Reinitialize buffer with specified packets size limit
-                _buffer.emplace(_buffer_storage, settings.packets_size);
+                use_memory_resource(settings.memory_resource);
+
+                _retained_buffer_size = settings.retained_buffer_size;
 
                 size_t boundary_position = content_type.find("boundary=");
 
+                // Determine the boundary for multipart/form-data content type
+                _boundary = boundary_position == std::string::npos 
+                    ? std::string_view{} 
+                    : content_type.substr(boundary_position + 9);
+
+                // Small request body can be entirely read by the caller along with the request header, then it is 
+                // processed in one pass without publishing the state, sampling the connection or touching the stream
+                bool is_body_buffered = is_request_body_buffered();
+
+                // Publish the downloading state, initially received bytes are the ones obtained with the request header
+                _download_registry = is_body_buffered ? nullptr : settings.active_downloads;
+                if (_download_registry)
+                {
+                    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+                    _download_state.reset(now);
+                    _download_state.add_received(boost::asio::buffer_size(_input_buffer.data()), now);
+                    _download_registry->add(_download_state, detail::remote_endpoint(_stream));
+                }
+
+                start_metrics(settings.metrics, boost::asio::buffer_size(_input_buffer.data()));
+
+                _sample_tcp_info = settings.sample_tcp_info && !is_body_buffered;
+                _tcp_info = tcp_info_sample{};
+
+                tune_socket(settings, is_body_buffered);
+
+                start_rate_limit(settings.rate_limit);
+
+                use_descriptor_budget(settings.file_descriptors);
+
+                start_admission_control(settings);
+
+                start_progress(settings);
+
                 // Boundary was not found in the content type
                 if (boundary_position == std::string::npos)
                 {
@@ -566,25 +1310,60 @@ namespace multipart_form_data
                     return;
                 }
 
-                // Determine the boundary for multipart/form-data content type
-                _boundary = content_type.substr(boundary_position + 9);
-
-                // Read the boundary before the header of the first file 
-                std::size_t bytes_transferred =  boost::asio::read_until(_stream, *_buffer, _boundary, error_code);
+                // Process the part of the request body that is already read by the caller
+                download_phase phase = process_input_data(settings, error_code, additional_parameters...);
 
-                if (error_code)
+                if (error_code || phase == download_phase::finished)
                 {
-                    _output_file_paths = std::vector<std::filesystem::path>{};
-
                     return;
                 }
 
-                // Consume read bytes as it is just the boundary
-                _buffer->consume(bytes_transferred);
+                // Reinitialize buffer with specified packets size limit
+                _buffer.emplace(_buffer_storage, initial_packets_size(settings));
+
+                std::size_t bytes_transferred = 0;
+
+                // Go on reading from the point where the data read by the caller is over
+                if (phase == download_phase::reading_body)
+                {
+                    wait_rate_limit();
+
+                    begin_read(download_phase::reading_body);
+
+                    bytes_transferred = sync_read_until(delimiter_condition{*this, _boundary, false, true}, settings.operations_timeout, error_code);
+
+                    return sync_process_file_body(
+                        std::move(settings), 
+                        error_code, 
+                        bytes_transferred, 
+                        std::forward<additional_parameters_t>(additional_parameters)...);
+                }
+
+                if (phase == download_phase::reading_preamble)
+                {
+                    begin_read(download_phase::reading_preamble);
+
+                    // Read the boundary before the header of the first file
+                    bytes_transferred = sync_read_until(delimiter_condition{*this, _boundary}, settings.operations_timeout, error_code);
+
+                    if (error_code)
+                    {
+                        _output_file_paths = std::vector<std::filesystem::path>{};
+
+                        return;
+                    }
+
+                    // Consume read bytes as it is just the boundary
+                    _buffer->consume(bytes_transferred);
+                }
+
+                wait_rate_limit();
+
+                begin_read(download_phase::reading_header);
 
                 // Read the first file header obtaining bytes until the empty string 
                 // that represents the delimiter between file header and data itself
-                bytes_transferred = boost::asio::read_until(_stream, *_buffer, "\r\n\r\n", error_code);
+                bytes_transferred = sync_read_until(delimiter_condition{*this, "\r\n\r\n", true}, settings.operations_timeout, error_code);
 
                 sync_process_file_header(
                     std::move(settings), 
@@ -595,98 +1374,49 @@ namespace multipart_form_data
 
             template<typename ...additional_parameters_t>
             void sync_process_file_header(
-                settings<additional_parameters_t...>&& settings,
+                settings<additional_parameters_t...>&& settings, 
                 boost::beast::error_code& error_code, 
                 std::size_t bytes_transferred,
                 additional_parameters_t&&... additional_parameters)
             {
-                if (error_code)
-                {
-                    return;
-                }
-
-                // Construct the string representation of obtained file header
-                std::string_view file_header_data{
-                    _buffer_storage.data(),
-                    bytes_transferred};
-
-                // Position of the filename field in the file header
-                size_t file_name_position = file_header_data.find("filename=\"");
-
-                // filename field is absent
-                if (file_name_position == std::string::npos)
-                {
-                    error_code = boost::asio::error::not_found;
-
-                    return;
-                }
-
-                // Remove the data before the actual file name
-                file_header_data.remove_prefix(file_name_position + 10);
-
-                // Look for the end of the file name
-                // Find from the end because actual file name can contain double quotes
-                file_name_position = file_header_data.rfind('"');
-
-                // No closing double quote in filename
-                if (file_name_position == std::string::npos)
+                // The request body is over instead of the next file header, e.g. the line break after the last boundary 
+                // came in the next packet
+                if (!error_code && is_body_end({_buffer_storage.data(), bytes_transferred}))
                 {
-                    error_code = error::invalid_structure;
+                    _buffer->consume(bytes_transferred);
 
                     return;
                 }
 
-                // Get the actual file name
-                file_header_data.remove_suffix(file_header_data.size() - file_name_position);
-
-                if (settings.on_read_file_header_handler)
+                // Wait for a free file descriptor before the file is opened
+                if (!error_code && 
+                    !acquire_descriptor(false) && 
+                    !_descriptor_budget->wait(_descriptor_waiter, std::chrono::steady_clock::now() + settings.operations_timeout))
                 {
-                    try
-                    {
-                        _file_path = settings.on_read_file_header_handler(file_header_data, additional_parameters...);
-                    }
-                    catch (...)
-                    {
-                        error_code = error::operation_aborted;
-
-                        return;
-                    }
+                    _descriptor_budget->cancel(_descriptor_waiter);
 
-                    if (_file_path.empty())
-                    {
-                        if (!generate_file_path(settings.output_directory, file_header_data, error_code))
-                        {
-                            return;
-                        }
-                    }
+                    error_code = error::descriptor_wait_timeout;
                 }
-                else
-                {
-                    if (!generate_file_path(settings.output_directory, file_header_data, error_code))
-                    {
-                        return;
-                    }
-                }
-
-                // Open the file to write the obtaining data
-                _file.open(_file_path, std::ios::binary);
 
-                // Invalid file path was provided
-                if (!_file.is_open())
+                if (error_code ||
+                    !open_file(
+                        std::string_view{_buffer_storage.data(), bytes_transferred},
+                        settings,
+                        error_code, 
+                        additional_parameters...))
                 {
-                    error_code = error::invalid_file_path;
-
                     return;
                 }
-                
-                // Store provided file path
-                _output_file_paths.emplace_back(_file_path);
 
                 // Consume the file header bytes 
-                _buffer->consume(bytes_transferred);
+                _buffer->consume(bytes_transferred); 
+
+                wait_rate_limit();
+
+                begin_read(download_phase::reading_body);
 
                 // Read the file body obtaining bytes until the boundary that represents the end of file
-                bytes_transferred = boost::asio::read_until(_stream, *_buffer, _boundary, error_code);
+                bytes_transferred = sync_read_until(delimiter_condition{*this, _boundary, false, true}, settings.operations_timeout, error_code);
 
                 sync_process_file_body(
                     std::move(settings), 
@@ -697,27 +1427,78 @@ namespace multipart_form_data
 
             template<typename ...additional_parameters_t>
             void sync_process_file_body(
-                settings<additional_parameters_t...>&& settings,
-                boost::beast::error_code& error_code,
+                settings<additional_parameters_t...>&& settings, 
+                boost::beast::error_code& error_code, 
                 std::size_t bytes_transferred,
                 additional_parameters_t&&... additional_parameters)
             {
+                // Wait for a slot in the write queue of the device before the obtained data is written
+                if ((!error_code || error_code == boost::asio::error::not_found) && 
+                    !acquire_write_slot(_buffer_storage.size(), settings.write_weight, false))
+                {
+                    _disk_scheduler->wait(_write_waiter);
+                }
+
+                // The received data of the stream ran out, so the connection waits for the next data without the buffer
+                if constexpr (is_stream_waitable)
+                {
+                    if (!error_code && _is_stream_drained)
+                    {
+                        release_drained_packet();
+
+                        boost::beast::get_lowest_layer(_stream).expires_after(settings.operations_timeout);
+
+                        _stream.wait_data(error_code);
+
+                        bytes_transferred = 0;
+
+                        if (!error_code)
+                        {
+                            wait_rate_limit();
+
+                            begin_read(download_phase::reading_body);
+
+                            bytes_transferred = sync_read_until(
+                                delimiter_condition{*this, _boundary, false, true}, 
+                                settings.operations_timeout, 
+                                error_code);
+                        }
+
+                        return sync_process_file_body(
+                            std::move(settings), 
+                            error_code, 
+                            bytes_transferred, 
+                            std::forward<additional_parameters_t>(additional_parameters)...);
+                    }
+                }
+
                 // File can't be read at once as it is too big(more than settings.packets_size bytes)
                 // Process obtained packet and go on reading
                 if (error_code == boost::asio::error::not_found)
                 {
+                    MULTIPART_FORM_DATA_PROBE(packet_read, this, _buffer_storage.size());
+
+                    record_latency(latency_phase::packet_reading, _read_start);
+
+                    std::chrono::steady_clock::time_point read_end = packet_time();
+                    size_t packet_size = _buffer_storage.size();
+
                     // Write obtained packet to the file
                     // Don't touch last symbols with boundary length as we could stop in the middle of boundary
                     // so we would write the part of boundary to the file
-                    _file.write(
-                        _buffer_storage.data(),
-                        _buffer_storage.size() - _boundary.size());
+                    write_packet(_buffer_storage.data(), packet_size - _boundary.size());
 
                     // Consume written bytes
-                    _buffer->consume(_buffer_storage.size() - _boundary.size());
+                    _buffer->consume(packet_size - _boundary.size());
+
+                    adapt_packets_size(packet_size, read_end);
+
+                    wait_rate_limit();
+
+                    begin_read(download_phase::reading_body);
 
                     // Read the next data until either we find a boundary or read the packet of maximum size again 
-                    bytes_transferred = boost::asio::read_until(_stream, *_buffer, _boundary, error_code);
+                    bytes_transferred = sync_read_until(delimiter_condition{*this, _boundary, false, true}, settings.operations_timeout, error_code);
 
                     return sync_process_file_body(
                         std::move(settings), 
@@ -729,105 +1510,1153 @@ namespace multipart_form_data
                 // Unexpected error occured so clean up everything about not uploaded file
                 if (error_code)
                 {
-                    _file.close();
-
-                    // Remove the file from the file system
-                    try
-                    {
-                        std::filesystem::remove(_output_file_paths.back());
-                    }
-                    catch (const std::exception& ex)
-                    {}
-
-                    // Remove the file from the list of uploaded files 
-                    _output_file_paths.pop_back();
+                    remove_file();
 
                     return;
                 }
 
+                MULTIPART_FORM_DATA_PROBE(packet_read, this, bytes_transferred);
+
+                record_latency(latency_phase::packet_reading, _read_start);
+
                 // Write obtained bytes to the file excluding CRLF after the file data and -- followed by boundary
                 // -- is the part of the boundary, used only in body, so we have to consider this -- length because
                 // _boudary variable doesn't contain it
-                _file.write(_buffer_storage.data(), bytes_transferred - _boundary.size() - 4);
-
-                // Close the file as its uploading is over
-                _file.close();
-
-                // Invoke handler after reading the whole file body if it is defined
-                if (settings.on_read_file_body_handler)
+                if (!complete_file(
+                        _buffer_storage.data(),
+                        bytes_transferred - _boundary.size() - 4,
+                        settings,
+                        error_code, 
+                        additional_parameters...))
                 {
-                    try
-                    {
-                        settings.on_read_file_body_handler(_output_file_paths.back(), additional_parameters...);
-                    }
-                    catch (...)
-                    {
-                        error_code = error::operation_aborted;
-                        
-                        return;
-                    }
+                    return;
                 }
 
                 // Consume obtained bytes
                 _buffer->consume(bytes_transferred); 
 
                 // If there is "--" after the boundary then there are no more files and request body is over
-                if (std::string_view{_buffer_storage.data(), _buffer_storage.size()} == "--\r\n")
+                if (is_body_end({_buffer_storage.data(), _buffer_storage.size()}))
                 {
                     return;
                 }
-                
+
+                wait_rate_limit();
+
+                begin_read(download_phase::reading_header);
+
                 // Read the next file header
-                bytes_transferred = boost::asio::read_until(_stream, *_buffer, "\r\n\r\n", error_code);
+                bytes_transferred = sync_read_until(delimiter_condition{*this, "\r\n\r\n", true}, settings.operations_timeout, error_code);
 
                 sync_process_file_header(
                     std::move(settings), 
                     error_code, 
-                    bytes_transferred,
+                    bytes_transferred, 
                     std::forward<additional_parameters_t>(additional_parameters)...);
             }
 
-            inline bool generate_file_path(
-                const std::filesystem::path& output_directory,
-                std::string_view file_name, 
-                std::error_code& error_code)
+            // Process the part of the request body that is read by the caller to its buffer. The data is scanned in place
+            // if the buffer is contiguous, otherwise it is copied to the buffer storage first. Only the unprocessed tail
+            // is kept in the buffer storage to go on reading after it.
+            // Return the phase of the downloading process that has to be continued with reading from the stream.
+            template<typename ...additional_parameters_t>
+            download_phase process_input_data(
+                settings<additional_parameters_t...>& settings,
+                boost::beast::error_code& error_code, 
+                additional_parameters_t&... additional_parameters)
             {
-                _file_path = output_directory / file_name;
+                std::string_view data{};
+                bool is_copied = false;
 
-                if (std::filesystem::exists(_file_path, error_code))
+                if (!contiguous_input_data(data))
                 {
-                    std::string new_file_name = _file_path.stem().string() + "(1)";
+                    _buffer_storage.assign(
+                        boost::asio::buffers_begin(_input_buffer.data()),
+                        boost::asio::buffers_end(_input_buffer.data()));
 
-                    size_t copy_number = 1, copy_number_start_position = new_file_name.size() - 2;
+                    data = _buffer_storage;
+                    is_copied = true;
+                }
 
-                    _file_path.replace_filename(new_file_name + _file_path.extension().c_str());
-                    
-                    while (std::filesystem::exists(_file_path, error_code))
+                download_phase phase = process_buffered_data(data, settings, error_code, additional_parameters...);
+
+                if (is_copied)
+                {
+                    _buffer_storage.erase(0, _buffer_storage.size() - data.size());
+                }
+                else
+                {
+                    _buffer_storage.assign(data);
+                }
+
+                return phase;
+            }
+
+            // Get the data of the caller's buffer if it is contiguous.
+            inline bool contiguous_input_data(std::string_view& data) const
+            {
+                auto input_data = _input_buffer.data();
+
+                size_t input_size = boost::asio::buffer_size(input_data);
+
+                if (input_size == 0)
+                {
+                    data = std::string_view{};
+
+                    return true;
+                }
+
+                boost::asio::const_buffer first_buffer = *boost::asio::buffer_sequence_begin(input_data);
+
+                if (first_buffer.size() != input_size)
+                {
+                    return false;
+                }
+
+                data = std::string_view{static_cast<const char*>(first_buffer.data()), first_buffer.size()};
+
+                return true;
+            }
+
+            // Check whether the data after the boundary is the end of the request body, i.e. -- and the line break.
+            static inline bool is_body_end(std::string_view data) noexcept
+            {
+                return data == "--\r\n";
+            }
+
+            // Check whether the whole request body is in the caller's buffer, i.e. the data after the last boundary
+            // in it is the end of the request body.
+            inline bool is_request_body_buffered() const
+            {
+                std::string_view data{};
+
+                if (_boundary.empty() || !contiguous_input_data(data))
+                {
+                    return false;
+                }
+
+                size_t position = data.rfind(_boundary);
+
+                return position != std::string_view::npos && is_body_end(data.substr(position + _boundary.size()));
+            }
+
+            // Process all files' parts that are entirely contained in the data and write the beginning
+            // of the file body that is not over yet. Processed bytes are removed from the data.
+            // Return the phase of the downloading process that the data is over in.
+            template<typename ...additional_parameters_t>
+            download_phase process_buffered_data(
+                std::string_view& data,
+                settings<additional_parameters_t...>& settings,
+                boost::beast::error_code& error_code, 
+                additional_parameters_t&... additional_parameters)
+            {
+                // Skip the boundary before the header of the first file
+                size_t position = detail::find(data, _boundary);
+
+                if (position == std::string_view::npos)
+                {
+                    return download_phase::reading_preamble;
+                }
+
+                data.remove_prefix(position + _boundary.size());
+
+                while (true)
+                {
+                    // Look for the empty string that represents the delimiter between file header and data itself
+                    position = detail::find(data, "\r\n\r\n");
+
+                    if (position == std::string_view::npos)
                     {
-                        new_file_name.replace(
-                            copy_number_start_position, 
-                            new_file_name.size() - copy_number_start_position - 1,
-                            std::to_string(++copy_number));
+                        return download_phase::reading_header;
+                    }
 
-                        _file_path.replace_filename(new_file_name + _file_path.extension().c_str());
+                    // There is no free file descriptor, so the header is processed once it is granted as the one 
+                    // that is read from the stream
+                    if (_descriptor_budget && !_descriptor_budget->try_acquire(_descriptor_waiter))
+                    {
+                        return download_phase::reading_header;
+                    }
+
+                    if (!open_file(data.substr(0, position + 4), settings, error_code, additional_parameters...))
+                    {
+                        return download_phase::reading_header;
+                    }
+
+                    data.remove_prefix(position + 4);
+
+                    position = detail::find(data, _boundary);
+
+                    // The file body is not over, so write it excluding the bytes that can be the beginning
+                    // of CRLF and -- followed by boundary
+                    if (position == std::string_view::npos)
+                    {
+                        size_t packet_size = data.size() > _boundary.size() + 4 ? data.size() - _boundary.size() - 4 : 0;
+
+                        write_packet(data.data(), packet_size);
+
+                        data.remove_prefix(packet_size);
+
+                        return download_phase::reading_body;
+                    }
+
+                    // There is no CRLF and -- before the boundary
+                    if (position < 4)
+                    {
+                        error_code = error::invalid_structure;
+
+                        remove_file();
+
+                        return download_phase::reading_body;
+                    }
+
+                    if (!complete_file(data.data(), position - 4, settings, error_code, additional_parameters...))
+                    {
+                        return download_phase::reading_body;
+                    }
+
+                    data.remove_prefix(position + _boundary.size());
+
+                    // If there is "--" after the boundary then there are no more files and request body is over
+                    if (is_body_end(data))
+                    {
+                        data.remove_prefix(data.size());
+
+                        return download_phase::finished;
                     }
                 }
+            }
 
-                return !error_code;
+            // Parse the file header, determine the file path and open the file.
+            // Return false if it fails and set the error code.
+            template<typename ...additional_parameters_t>
+            bool open_file(
+                std::string_view file_header_data,
+                settings<additional_parameters_t...>& settings,
+                boost::beast::error_code& error_code, 
+                additional_parameters_t&... additional_parameters)
+            {
+                MULTIPART_FORM_DATA_PROBE(part_begin, this, _output_file_paths.size());
+
+                sample_connection();
+
+                _header_start = latency_start();
+
+                // Position of the filename field in the file header
+                size_t file_name_position = detail::find(file_header_data, "filename=\"");
+
+                // filename field is absent
+                if (file_name_position == std::string::npos)
+                {
+                    error_code = error::invalid_structure;
+
+                    return false;
+                }
+
+                // Remove the data before the actual file name
+                file_header_data.remove_prefix(file_name_position + 10);
+
+                // Look for the end of the file name
+                // Find from the end because actual file name can contain double quotes
+                file_name_position = file_header_data.rfind('"');
+
+                // No closing double quote in filename
+                if (file_name_position == std::string::npos)
+                {
+                    error_code = error::invalid_structure;
+
+                    return false;
+                }
+
+                // Get the actual file name
+                file_header_data.remove_suffix(file_header_data.size() - file_name_position);
+
+                if (settings.on_read_file_header_handler)
+                {
+                    std::chrono::steady_clock::time_point hook_start = begin_hook(download_phase::running_header_handler);
+
+                    try
+                    {
+                        _file_path = settings.on_read_file_header_handler(file_header_data, additional_parameters...);
+                    }
+                    catch (...)
+                    {
+                        error_code = error::operation_aborted;
+
+                        return false;
+                    }
+
+                    // Exclude the handler execution from the header parsing time
+                    _header_start += record_latency(latency_phase::hook_execution, hook_start);
+
+                    if (_file_path.empty())
+                    {
+                        if (!generate_file_path(settings.output_directory, file_header_data, error_code))
+                        {
+                            return false;
+                        }
+                    }
+                }
+                else
+                {
+                    if (!generate_file_path(settings.output_directory, file_header_data, error_code))
+                    {
+                        return false;
+                    }
+                }
+
+                // Open the file to write the obtaining data
+                _file.open(_file_path, std::ios::binary);
+
+                // Invalid file path was provided
+                if (!_file.is_open())
+                {
+                    error_code = error::invalid_file_path;
+
+                    return false;
+                }
+
+                // Store provided file path
+                _output_file_paths.emplace_back(_file_path);
+
+                _disk_scheduler = settings.disk_scheduling ? &settings.disk_scheduling->device(_file_path) : nullptr;
+
+                MULTIPART_FORM_DATA_PROBE(header_parsed, this, _file_path.c_str());
+
+                record_latency(latency_phase::header_parsing, _header_start);
+
+                if (_download_registry)
+                {
+                    _download_registry->file_path(_download_state, _file_path);
+                }
+
+                return true;
+            }
+
+            // Write the packet of the file body to the file.
+            inline void write_packet(const char* data, size_t size)
+            {
+                std::chrono::steady_clock::time_point write_start = begin_write();
+
+                _file.write(data, size);
+
+                if (_disk_scheduler)
+                {
+                    _disk_scheduler->release(_write_waiter);
+                }
+
+                end_write(size, write_start);
+
+                MULTIPART_FORM_DATA_PROBE(packet_written, this, size);
+            }
+
+            // Write the part of the packet that can't be the beginning of the boundary once the received data of the stream
+            // runs out, and release the buffer, so the idle connection doesn't hold it while it waits for the data.
+            inline void release_drained_packet()
+            {
+                _is_stream_drained = false;
+
+                size_t written_size = _buffer_storage.size() > _boundary.size() ? _buffer_storage.size() - _boundary.size() : 0;
+
+                write_packet(_buffer_storage.data(), written_size);
+
+                _buffer->consume(written_size);
+                _buffer_storage.shrink_to_fit();
+
+                if (_metrics)
+                {
+                    account_buffer_memory();
+                }
+            }
+
+            // Write the last packet of the file body to the file, close the file and invoke the handler of the file body.
+            // Return false if the handler throws exception and set the error code.
+            template<typename ...additional_parameters_t>
+            bool complete_file(
+                const char* data,
+                size_t size,
+                settings<additional_parameters_t...>& settings,
+                boost::beast::error_code& error_code, 
+                additional_parameters_t&... additional_parameters)
+            {
+                write_packet(data, size);
+
+                // Close the file as its uploading is over
+                _file.close();
+
+                release_descriptor();
+
+                MULTIPART_FORM_DATA_PROBE(part_end, this, _output_file_paths.back().c_str());
+
+                sample_connection();
+
+                if (_download_registry)
+                {
+                    _download_state.add_file();
+                }
+
+                if (_metrics)
+                {
+                    _metrics->add_file();
+                }
+
+                // Invoke handler after reading the whole file body if it is defined
+                if (settings.on_read_file_body_handler)
+                {
+                    std::chrono::steady_clock::time_point hook_start = begin_hook(download_phase::running_body_handler);
+
+                    try
+                    {
+                        settings.on_read_file_body_handler(_output_file_paths.back(), additional_parameters...);
+                    }
+                    catch (...)
+                    {
+                        error_code = error::operation_aborted;
+
+                        return false;
+                    }
+
+                    record_latency(latency_phase::hook_execution, hook_start);
+                }
+
+                if (_post_processing)
+                {
+                    _post_processing->process(_output_file_paths.back());
+                }
+
+                return true;
+            }
+
+            // Clean up everything about the file that is not entirely uploaded.
+            inline void remove_file()
+            {
+                _file.close();
+
+                release_descriptor();
+
+                // Remove the file from the file system
+                try
+                {
+                    std::filesystem::remove(_output_file_paths.back());
+                }
+                catch (const std::exception& ex)
+                {}
+
+                // Remove the file from the list of uploaded files
+                _output_file_paths.pop_back();
+            }
+
+            inline bool generate_file_path(
+                const std::filesystem::path& output_directory,
+                std::string_view file_name, 
+                std::error_code& error_code)
+            {
+                _file_path = output_directory / file_name;
+
+                if (std::filesystem::exists(_file_path, error_code))
+                {
+                    std::string new_file_name = _file_path.stem().string() + "(1)";
+
+                    size_t copy_number = 1, copy_number_start_position = new_file_name.size() - 2;
+
+                    _file_path.replace_filename(new_file_name + _file_path.extension().c_str());
+                    
+                    while (std::filesystem::exists(_file_path, error_code))
+                    {
+                        new_file_name.replace(
+                            copy_number_start_position, 
+                            new_file_name.size() - copy_number_start_position - 1,
+                            std::to_string(++copy_number));
+
+                        _file_path.replace_filename(new_file_name + _file_path.extension().c_str());
+                    }
+                }
+
+                return !error_code;
+            }
+
+            // Get the current time if latencies are measured, otherwise there is no need to query the clock.
+            inline std::chrono::steady_clock::time_point latency_start() const noexcept
+            {
+                return _latency_histograms ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+            }
+
+            // Record the latency of the phase that started at the specified time and return it.
+            inline std::chrono::steady_clock::duration record_latency(
+                latency_phase phase, 
+                std::chrono::steady_clock::time_point start) noexcept
+            {
+                if (!_latency_histograms)
+                {
+                    return std::chrono::steady_clock::duration::zero();
+                }
+
+                std::chrono::steady_clock::duration latency = std::chrono::steady_clock::now() - start;
+
+                _latency_histograms->record(phase, latency);
+
+                return latency;
+            }
+
+            // Get the size of the first packet and start adapting the packets size if it is requested.
+            template<typename ...additional_parameters_t>
+            size_t initial_packets_size(const settings<additional_parameters_t...>& settings) noexcept
+            {
+                _requested_packets_size = settings.packets_size;
+
+                if (!settings.adaptive_packets_size)
+                {
+                    _packets_size_controller.reset();
+
+                    return std::min(settings.packets_size, _max_packets_size);
+                }
+
+                _packets_size_controller.emplace(
+                    settings.packets_size,
+                    settings.min_packets_size,
+                    settings.max_packets_size,
+                    settings.packets_fill_time);
+
+                return std::min(_packets_size_controller->packets_size(), _max_packets_size);
+            }
+
+            // Get the current time if the packets size is adapted, otherwise there is no need to query the clock.
+            inline std::chrono::steady_clock::time_point packet_time() const noexcept
+            {
+                return _packets_size_controller ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+            }
+
+            // Recalculate the packets size after the packet that was received until the specified time is written.
+            // The limit of the rate can be changed at any time, so the packets are capped by the current burst.
+            // The buffer capacity is reduced as well if it is more than twice as large as the new size.
+            inline void adapt_packets_size(size_t packet_size, std::chrono::steady_clock::time_point read_end)
+            {
+                if (!_packets_size_controller && !_rate_limit)
+                {
+                    return;
+                }
+
+                if (_rate_limit)
+                {
+                    _max_packets_size = std::min(rate_limited_packets_size(), _throttled_packets_size);
+                }
+
+                size_t packets_size = std::min(
+                    _packets_size_controller 
+                        ? _packets_size_controller->update(
+                            packet_size,
+                            read_end - _packet_start,
+                            std::chrono::steady_clock::now() - read_end) 
+                        : _requested_packets_size,
+                    _max_packets_size);
+
+                if (packets_size == _buffer->max_size())
+                {
+                    return;
+                }
+
+                _buffer.emplace(_buffer_storage, packets_size);
+
+                if (_buffer_storage.capacity() > 2 * packets_size)
+                {
+                    _buffer_storage.shrink_to_fit();
+                }
+            }
+
+            // Prepare the accounting of the read operation that is about to be started.
+            // Read until the condition is satisfied, the read is limited by the timeout if the lowest layer of the stream
+            // has the expiry and applies it to the synchronous reads(e.g. uring_stream), beast::tcp_stream ignores it there.
+            template<typename condition_t>
+            inline size_t sync_read_until(
+                condition_t condition, 
+                std::chrono::steady_clock::duration timeout, 
+                boost::beast::error_code& error_code)
+            {
+                auto& lowest_layer = boost::beast::get_lowest_layer(_stream);
+
+                if constexpr (requires { lowest_layer.expires_after(timeout); })
+                {
+                    lowest_layer.expires_after(timeout);
+                }
+
+                return boost::asio::read_until(_stream, *_buffer, condition, error_code);
+            }
+
+            inline void begin_read(download_phase phase) noexcept
+            {
+                _read_start = latency_start();
+                _packet_start = packet_time();
+                _buffered_size = _buffer_storage.size();
+
+                if (_download_registry)
+                {
+                    _download_state.phase(phase);
+                }
+            }
+
+            // Account the bytes that were obtained from the stream since the last call.
+            inline void account_received() noexcept
+            {
+                if (_download_registry)
+                {
+                    _download_state.add_received(_buffer_storage.size() - _buffered_size, std::chrono::steady_clock::now());
+                }
+
+                if (_metrics)
+                {
+                    _metrics->add_bytes_received(_buffer_storage.size() - _buffered_size);
+                    account_buffer_memory();
+                }
+
+                if (_rate_limit)
+                {
+                    _resume_time = std::max(
+                        _resume_time, 
+                        _rate_limit->take(_buffer_storage.size() - _buffered_size, std::chrono::steady_clock::now()));
+                }
+
+                if (_admission_control)
+                {
+                    std::chrono::nanoseconds read_delay = _admission_control->read_delay(_buffer_storage.size() - _buffered_size);
+
+                    if (read_delay.count() > 0)
+                    {
+                        _resume_time = std::max(_resume_time, std::chrono::steady_clock::now()) + read_delay;
+                    }
+                }
+
+                _received_bytes += _buffer_storage.size() - _buffered_size;
+                _buffered_size = _buffer_storage.size();
+
+                // The clock is queried only once enough bytes are received
+                if (_progress && _received_bytes - _progress_bytes >= _progress->bytes() &&
+                    std::chrono::steady_clock::now() - _progress_time >= _progress->interval())
+                {
+                    publish_progress(false, {});
+                }
+
+                // The condition is invoked before each read from the stream, so the low watermark is checked for each 
+                // of them. A blocked read is woken up only when the data that it hasn't taken yet fills the low watermark, 
+                // so the low watermark is dropped once less than twice of it remains, otherwise the last read would never end.
+                // The target is a part of the current packet, which is limited by the adaptive size and the rate limit.
+                if (_is_low_watermark_tuned)
+                {
+                    uint64_t remaining_bytes = _content_length > _received_bytes ? _content_length - _received_bytes : 0;
+                    size_t low_watermark_target = std::min(
+                        _buffer->max_size() / socket_low_watermark_packet_part, 
+                        max_socket_low_watermark);
+
+                    _socket_tuning.low_watermark(remaining_bytes >= 2 * low_watermark_target ? low_watermark_target : 1);
+                }
+            }
+
+            // Tune the socket receiving for the downloading process if it is requested and the body is not read yet.
+            template<typename ...additional_parameters_t>
+            inline void tune_socket(const settings<additional_parameters_t...>& settings, bool is_body_buffered) noexcept
+            {
+                _received_bytes = boost::asio::buffer_size(_input_buffer.data());
+                _content_length = settings.content_length;
+                _is_low_watermark_tuned = false;
+
+                if (!settings.tune_socket || 
+                    is_body_buffered || 
+                    !_socket_tuning.apply(_stream, settings.socket_receive_buffer_size, settings.socket_busy_poll) ||
+                    _content_length == 0)
+                {
+                    return;
+                }
+
+                // Wait for a part of the packet, so the reads are large but the boundary is searched 
+                // while the rest of the packet is received
+                _is_low_watermark_tuned = true;
+            }
+
+            // Start limiting the receiving rate with the bucket if it is provided, initially received bytes are 
+            // the ones obtained with the request header. Packets are limited by the smallest burst of the hierarchy.
+            inline void start_rate_limit(token_bucket* rate_limit) noexcept
+            {
+                _rate_limit = rate_limit;
+                _resume_time = std::chrono::steady_clock::time_point{};
+                _max_packets_size = std::numeric_limits<size_t>::max();
+
+                if (!_rate_limit)
+                {
+                    return;
+                }
+
+                _resume_time = _rate_limit->take(boost::asio::buffer_size(_input_buffer.data()), std::chrono::steady_clock::now());
+                _max_packets_size = rate_limited_packets_size();
+            }
+
+            // Get the packets size limit by the smallest burst of the hierarchy of the rate limit.
+            inline size_t rate_limited_packets_size() const noexcept
+            {
+                return static_cast<size_t>(
+                    std::clamp<uint64_t>(_rate_limit->min_burst(), min_rate_limited_packets_size, std::numeric_limits<size_t>::max()));
+            }
+
+            // Start reporting to the admission controller if it is provided. Packets are not larger than the minimum 
+            // adaptive size if the downloading process starts under pressure.
+            template<typename ...additional_parameters_t>
+            inline void start_admission_control(const settings<additional_parameters_t...>& settings) noexcept
+            {
+                _admission_control = settings.admission_control;
+                _throttled_packets_size = std::numeric_limits<size_t>::max();
+
+                if (_admission_control && _admission_control->is_throttled())
+                {
+                    _throttled_packets_size = std::max(settings.min_packets_size, min_rate_limited_packets_size);
+                    _max_packets_size = std::min(_max_packets_size, _throttled_packets_size);
+                }
+            }
+
+            // Start the post-processing of the files of the downloading process if it is requested.
+            template<typename ...additional_parameters_t>
+            inline void start_post_processing(const settings<additional_parameters_t...>& settings)
+            {
+                _post_processing = settings.post_processing && settings.on_process_file_handler
+                    ? std::make_shared<detail::post_processing_batch>(*settings.post_processing, settings.on_process_file_handler)
+                    : nullptr;
+            }
+
+            // Start reporting the progress if the reporter is provided, the first event tells that the downloading process is started.
+            template<typename ...additional_parameters_t>
+            inline void start_progress(const settings<additional_parameters_t...>& settings) noexcept
+            {
+                _progress = settings.progress;
+                _progress_id = settings.progress_id;
+
+                if (_progress)
+                {
+                    publish_progress(false, {});
+                }
+            }
+
+            // Publish the current progress to the reporter.
+            inline void publish_progress(bool is_finished, const boost::beast::error_code& error_code) noexcept
+            {
+                _progress_bytes = _received_bytes;
+                _progress_time = std::chrono::steady_clock::now();
+
+                _progress->publish(
+                    progress_event{
+                        .download_id = _progress_id,
+                        .received_bytes = _received_bytes,
+                        .content_length = _content_length,
+                        .files_count = _output_file_paths.size(),
+                        .is_finished = is_finished,
+                        .result = error_code
+                    });
+            }
+
+            // Check whether the reading has to be paused as the rate limit is exceeded or the admission controller
+            // slows the reading down.
+            inline bool is_rate_limited() const noexcept
+            {
+                return (_rate_limit || _admission_control) && _resume_time > std::chrono::steady_clock::now();
+            }
+
+            // Start the timer of the paused reading, the resume time is not changed until the reading is resumed.
+            inline void pause_reading()
+            {
+                if (!_pause_timer)
+                {
+                    _pause_timer.emplace(_stream.get_executor());
+                }
+
+                _pause_timer->expires_at(_resume_time);
+
+                if (_download_registry)
+                {
+                    _download_state.phase(download_phase::rate_limited);
+                }
+            }
+
+            // Block the reading until the rate limit is not exceeded anymore.
+            inline void wait_rate_limit()
+            {
+                if (!is_rate_limited())
+                {
+                    return;
+                }
+
+                if (_download_registry)
+                {
+                    _download_state.phase(download_phase::rate_limited);
+                }
+
+                std::this_thread::sleep_until(_resume_time);
+            }
+
+            // Take a slot in the write queue of the device for the write of the specified size if the writes are scheduled.
+            // Return false if the write has to wait for the slot.
+            inline bool acquire_write_slot(uint64_t bytes, uint32_t weight, bool is_async)
+            {
+                if (!_disk_scheduler)
+                {
+                    return true;
+                }
+
+                _write_waiter.is_async = is_async;
+
+                if (_disk_scheduler->acquire(_write_waiter, bytes, weight))
+                {
+                    return true;
+                }
+
+                if (_download_registry)
+                {
+                    _download_state.phase(download_phase::waiting_for_disk);
+                }
+
+                return false;
+            }
+
+            // Take a slot in the write queue of the device for the asynchronous write. The pause timer is armed before 
+            // the write is queued, so the slot that is granted at once cancels the wait that is started right after.
+            inline bool async_acquire_write_slot(uint64_t bytes, uint32_t weight)
+            {
+                if (!_disk_scheduler)
+                {
+                    return true;
+                }
+
+                if (!_pause_timer)
+                {
+                    _pause_timer.emplace(_stream.get_executor());
+                }
+
+                _pause_timer->expires_at(std::chrono::steady_clock::time_point::max());
+
+                return acquire_write_slot(bytes, weight, true);
+            }
+
+            // Take a slot of the descriptor budget before the file is opened if the descriptors are limited.
+            // Return false if the downloading process has to wait for the slot.
+            inline bool acquire_descriptor(bool is_async)
+            {
+                if (!_descriptor_budget)
+                {
+                    return true;
+                }
+
+                _descriptor_waiter.is_async = is_async;
+
+                if (_descriptor_budget->acquire(_descriptor_waiter))
+                {
+                    return true;
+                }
+
+                if (_download_registry)
+                {
+                    _download_state.phase(download_phase::waiting_for_descriptor);
+                }
+
+                return false;
+            }
+
+            // Take a slot of the descriptor budget for the asynchronous downloading process, the pause timer
+            // is armed with the timeout of the waiting before the downloader is queued.
+            inline bool async_acquire_descriptor(std::chrono::steady_clock::duration timeout)
+            {
+                if (!_descriptor_budget)
+                {
+                    return true;
+                }
+
+                if (!_pause_timer)
+                {
+                    _pause_timer.emplace(_stream.get_executor());
+                }
+
+                _pause_timer->expires_after(timeout);
+
+                return acquire_descriptor(true);
+            }
+
+            // Take the slots for the files of the downloading process from the budget. The downloader leaves 
+            // the previous budget if it is another one.
+            inline void use_descriptor_budget(descriptor_budget* budget)
+            {
+                if (_descriptor_budget != budget && _descriptor_budget)
+                {
+                    _descriptor_budget->cancel(_descriptor_waiter);
+                }
+
+                _descriptor_budget = budget;
+            }
+
+            // Return the slot of the descriptor budget after the file is closed.
+            inline void release_descriptor()
+            {
+                if (_descriptor_budget)
+                {
+                    _descriptor_budget->release(_descriptor_waiter);
+                }
+            }
+
+            // Start counting the downloading process in the metrics, initially received bytes are the ones obtained with
+            // the request header. Memory of the buffer is moved to the new metrics if they differ from the previous ones.
+            inline void start_metrics(download_metrics* metrics, size_t received_bytes) noexcept
+            {
+                if (_metrics != metrics)
+                {
+                    if (_metrics)
+                    {
+                        _metrics->add_buffer_memory(-static_cast<int64_t>(_reported_buffer_memory));
+                    }
+
+                    _metrics = metrics;
+                    _reported_buffer_memory = 0;
+                }
+
+                if (_metrics)
+                {
+                    _metrics->add_download_start();
+                    _metrics->add_bytes_received(received_bytes);
+                    account_buffer_memory();
+                }
+
+                _is_download_counted = _metrics != nullptr;
+            }
+
+            // Report the change of the buffer capacity to the metrics.
+            inline void account_buffer_memory() noexcept
+            {
+                if (_buffer_storage.capacity() != _reported_buffer_memory)
+                {
+                    _metrics->add_buffer_memory(
+                        static_cast<int64_t>(_buffer_storage.capacity()) - static_cast<int64_t>(_reported_buffer_memory));
+                    _reported_buffer_memory = _buffer_storage.capacity();
+                }
+            }
+
+            // Prepare the accounting of the write operation that is about to be started and return its start time.
+            inline std::chrono::steady_clock::time_point begin_write() noexcept
+            {
+                if (_download_registry)
+                {
+                    _download_state.phase(download_phase::writing_body);
+                }
+
+                return _admission_control ? std::chrono::steady_clock::now() : latency_start();
+            }
+
+            // Account the bytes written by the write operation that started at the specified time.
+            inline void end_write(size_t bytes, std::chrono::steady_clock::time_point start) noexcept
+            {
+                record_latency(latency_phase::packet_writing, start);
+
+                if (_admission_control)
+                {
+                    _admission_control->record_write_latency(std::chrono::steady_clock::now() - start);
+                }
+
+                if (_download_registry)
+                {
+                    _download_state.add_written(bytes, std::chrono::steady_clock::now());
+                }
+
+                if (_metrics)
+                {
+                    _metrics->add_bytes_written(bytes);
+                }
+            }
+
+            // Prepare the accounting of the settings handler that is about to be invoked and return its start time.
+            inline std::chrono::steady_clock::time_point begin_hook(download_phase phase) noexcept
+            {
+                if (_download_registry)
+                {
+                    _download_state.phase(phase);
+                }
+
+                return latency_start();
+            }
+
+            // Sample kernel statistics of the connection if it is requested.
+            inline void sample_connection() noexcept
+            {
+                if (!_sample_tcp_info || !sample_tcp_info(_stream, _tcp_info))
+                {
+                    return;
+                }
+
+                MULTIPART_FORM_DATA_PROBE(
+                    tcp_info, 
+                    this, 
+                    _tcp_info.receive_rtt.count(), 
+                    _tcp_info.retransmits, 
+                    _tcp_info.receive_window);
+
+                if (_download_registry)
+                {
+                    _download_state.tcp_info(_tcp_info);
+                }
+            }
+
+            // Allocate the buffer and the operations' states of the downloading process from the memory resource
+            // that is provided in the settings, or from the one of the downloader if it is not provided.
+            inline void use_memory_resource(std::pmr::memory_resource* memory_resource) noexcept
+            {
+                _handler_memory_resource = memory_resource ? memory_resource : _memory_resource;
+
+                rebind_buffer_storage(_handler_memory_resource);
+                _handler_memory.upstream(
+                    _handler_memory_resource ? _handler_memory_resource : std::pmr::get_default_resource());
+            }
+
+            // Release the buffer if its capacity exceeds the retained size, so its memory returns to the memory resource.
+            // The buffer is returned to the memory resource of the downloader as well, so the memory resource 
+            // of the downloading process can be released as soon as the final handler is invoked.
+            inline void release_buffer() noexcept
+            {
+                if (_handler_memory_resource != _memory_resource)
+                {
+                    _handler_memory.upstream(_memory_resource ? _memory_resource : std::pmr::get_default_resource());
+
+                    return rebind_buffer_storage(_memory_resource);
+                }
+
+                if (_buffer_storage.capacity() > _retained_buffer_size)
+                {
+                    _buffer.reset();
+                    std::pmr::string{_buffer_storage.get_allocator()}.swap(_buffer_storage);
+                }
+            }
+
+            // Recreate the buffer storage with the memory resource if it uses another one. Allocators of std::pmr 
+            // don't propagate on assignment, so the storage has to be recreated in place to change the memory resource.
+            inline void rebind_buffer_storage(std::pmr::memory_resource* memory_resource) noexcept
+            {
+                if (!memory_resource)
+                {
+                    memory_resource = std::pmr::get_default_resource();
+                }
+
+                if (*_buffer_storage.get_allocator().resource() == *memory_resource)
+                {
+                    return;
+                }
+
+                _buffer.reset();
+                std::destroy_at(&_buffer_storage);
+                std::construct_at(&_buffer_storage, memory_resource);
+            }
+
+            // Perform the bookkeeping of the downloading process end, it has to be invoked right before the final handler.
+            inline void finish_download(const boost::beast::error_code& error_code)
+            {
+                if (error_code)
+                {
+                    MULTIPART_FORM_DATA_PROBE(error, this, error_code.value(), error_code.category().name());
+                }
+
+                record_latency(latency_phase::request, _download_start);
+
+                sample_connection();
+
+                _socket_tuning.restore();
+                _is_low_watermark_tuned = false;
+
+                // The slot is still held if the downloading process failed after it was taken but before the file was opened
+                release_descriptor();
+
+                release_buffer();
+
+                if (_download_registry)
+                {
+                    _download_state.phase(download_phase::finished);
+                    _download_registry->remove(_download_state);
+                }
+
+                if (_progress)
+                {
+                    publish_progress(true, error_code);
+                }
+
+                if (_metrics)
+                {
+                    _metrics->add_download_end(error_code);
+                    account_buffer_memory();
+                }
+
+                _is_download_counted = false;
             }
 
             read_stream& _stream;
             // Buffer that is used to read requests outside this class
             // It is necessary because it can already store some part of the request body
             const dynamic_buffer& _input_buffer;
+            // Memory resource of the downloader and the one that is used by the current downloading process
+            std::pmr::memory_resource* _memory_resource;
+            std::pmr::memory_resource* _handler_memory_resource{nullptr};
+            // Memory of the operations' states that is reused for all packets
+            detail::handler_memory _handler_memory{};
             // String buffer storage that actually contains read data
-            std::string _buffer_storage{};
+            std::pmr::string _buffer_storage;
+            // Capacity of the buffer storage that is kept between downloading processes
+            size_t _retained_buffer_size{0};
             // Main buffer that is wrapper around the string to use it in asio operations
-            std::optional<boost::asio::dynamic_string_buffer<char, std::char_traits<char>, std::allocator<char>>> _buffer{};
+            std::optional<buffer_type> _buffer{};
+            // Whether the last read of the file body is completed as the received data of the stream ran out
+            bool _is_stream_drained{false};
             std::string_view _boundary{};
             std::filesystem::path _file_path{};
             std::ofstream _file{};
             std::vector<std::filesystem::path> _output_file_paths{};
+            // Registry of latencies of the current downloading process and start times of the measured phases
+            histogram_registry* _latency_histograms{nullptr};
+            std::chrono::steady_clock::time_point _download_start{};
+            std::chrono::steady_clock::time_point _header_start{};
+            std::chrono::steady_clock::time_point _read_start{};
+            // Registry of active downloads and the state that is published into it
+            download_registry* _download_registry{nullptr};
+            download_state _download_state{};
+            // Size of the buffered data that is already accounted as received
+            size_t _buffered_size{0};
+            // Metrics of the downloading process and buffer memory that is reported to them
+            download_metrics* _metrics{nullptr};
+            // Whether the downloading process is started in the metrics and is not finished yet
+            bool _is_download_counted{false};
+            size_t _reported_buffer_memory{0};
+            // Controller of the packets size if it is adapted and the start time of the current packet receiving
+            std::optional<detail::packets_size_controller> _packets_size_controller{};
+            std::chrono::steady_clock::time_point _packet_start{};
+            // Whether kernel statistics of the connection are sampled and the last sample
+            bool _sample_tcp_info{false};
+            tcp_info_sample _tcp_info{};
+            // Tuning of the socket receiving, bytes of the request body that are received and the expected ones
+            // and whether the low watermark is set while the rest of the body exceeds it
+            detail::socket_receive_tuning _socket_tuning{};
+            uint64_t _received_bytes{0};
+            uint64_t _content_length{0};
+            bool _is_low_watermark_tuned{false};
+            // Token bucket that limits the receiving rate, the time when the reading can be resumed
+            // and the packets size limit by the burst and by the pressure at the start. The requested packets size
+            // is restored once the limit is raised.
+            token_bucket* _rate_limit{nullptr};
+            std::chrono::steady_clock::time_point _resume_time{};
+            size_t _max_packets_size{std::numeric_limits<size_t>::max()};
+            size_t _throttled_packets_size{std::numeric_limits<size_t>::max()};
+            size_t _requested_packets_size{0};
+            // Timer of the paused asynchronous reading, it waits for the rate limit or for the write slot
+            std::optional<boost::asio::steady_timer> _pause_timer{};
+            // Scheduler of the writes to the device of the current file and the write that waits for its slot
+            disk_scheduler* _disk_scheduler{nullptr};
+            slot_waiter<disk_scheduler::waiter> _write_waiter{*this};
+            // Budget of the file descriptors and the downloader that waits for its slot
+            descriptor_budget* _descriptor_budget{nullptr};
+            slot_waiter<descriptor_budget::waiter> _descriptor_waiter{*this};
+            // Controller of the admission that slows the reading down and gets the write latencies
+            admission_controller* _admission_control{nullptr};
+            // Reporter of the progress, the identifier of the downloading process, and the received bytes 
+            // and the time of the last event
+            progress_reporter* _progress{nullptr};
+            uint64_t _progress_id{0};
+            uint64_t _progress_bytes{0};
+            std::chrono::steady_clock::time_point _progress_time{};
+            // Post-processing of the files of the current downloading process
+            std::shared_ptr<detail::post_processing_batch> _post_processing{};
     };
 };
 
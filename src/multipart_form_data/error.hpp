@@ -20,7 +20,13 @@ namespace multipart_form_data
         invalid_file_path,
         // Either on_read_file_header_handler or on_read_file_body_handler threw an exception
         // so the whole operation is aborted.
-        operation_aborted
+        operation_aborted,
+        // The downloading process is rejected by the admission controller as the server is under pressure.
+        overloaded,
+        // No file descriptor of the budget is granted to the downloading process in operations_timeout.
+        descriptor_wait_timeout,
+        // on_process_file_handler threw exception for any file of the request that was waited for.
+        post_processing_failed
     };
 
     // Error conditions corresponding to present error codes. 
@@ -34,7 +40,13 @@ namespace multipart_form_data
         invalid_file_path,
         // Either on_read_file_header_handler or on_read_file_body_handler threw an exception
         // so the whole operation is aborted.
-        operation_aborted
+        operation_aborted,
+        // The downloading process is rejected by the admission controller as the server is under pressure.
+        overloaded,
+        // No file descriptor of the budget is granted to the downloading process in operations_timeout.
+        descriptor_wait_timeout,
+        // on_process_file_handler threw exception for any file of the request that was waited for.
+        post_processing_failed
     };
 }
 
@@ -93,6 +105,18 @@ namespace multipart_form_data
                         {
                             return "Multipart/form-data operation is aborted due to caugth exception";
                         }
+                        case error::overloaded:
+                        {
+                            return "Multipart/form-data operation is rejected due to server overload";
+                        }
+                        case error::descriptor_wait_timeout:
+                        {
+                            return "Multipart/form-data operation timed out waiting for a file descriptor";
+                        }
+                        case error::post_processing_failed:
+                        {
+                            return "Post-processing of the downloaded files failed due to caught exception";
+                        }
                         default:
                         {
                             return "Unknown error";
@@ -120,6 +144,18 @@ namespace multipart_form_data
                         {
                             return condition::operation_aborted;
                         }
+                        case error::overloaded:
+                        {
+                            return condition::overloaded;
+                        }
+                        case error::descriptor_wait_timeout:
+                        {
+                            return condition::descriptor_wait_timeout;
+                        }
+                        case error::post_processing_failed:
+                        {
+                            return condition::post_processing_failed;
+                        }
                         default:
                         {
                             return {ev, *this};
@@ -161,6 +197,18 @@ namespace multipart_form_data
                         {
                             return "Multipart/form-data operation is aborted due to caugth exception";
                         }
+                        case condition::overloaded:
+                        {
+                            return "Multipart/form-data operation is rejected due to server overload";
+                        }
+                        case condition::descriptor_wait_timeout:
+                        {
+                            return "Multipart/form-data operation timed out waiting for a file descriptor";
+                        }
+                        case condition::post_processing_failed:
+                        {
+                            return "Post-processing of the downloaded files failed due to caught exception";
+                        }
                         default:
                         {
                             return "Unknown error";
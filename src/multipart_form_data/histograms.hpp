@@ -0,0 +1,226 @@
+#ifndef MULTIPART_FORM_DATA_HISTOGRAMS_HPP
+#define MULTIPART_FORM_DATA_HISTOGRAMS_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include <multipart_form_data/detail/thread_shard.hpp>
+
+namespace multipart_form_data
+{
+    // Phases of the downloading process which latencies are recorded to the histograms.
+    enum class latency_phase
+    {
+        // Parsing of the file header including determination of the file path and opening of the file.
+        // Execution time of on_read_file_header_handler is excluded.
+        header_parsing,
+        // Waiting for the packet of the file body to be read from the stream.
+        packet_reading,
+        // Writing of the packet of the file body to the file.
+        packet_writing,
+        // Execution of either on_read_file_header_handler or on_read_file_body_handler.
+        hook_execution,
+        // The whole downloading process from its start to the invocation of the final handler.
+        request
+    };
+
+    inline constexpr size_t latency_phases_count = 5;
+
+    // Histogram of latencies in nanoseconds with HDR layout: each power of two range is divided into
+    // sub_buckets_count linear buckets, so the relative error of any value doesn't exceed 1/sub_buckets_count.
+    // It is a plain value type that is not thread-safe, use histogram_registry to record values concurrently.
+    class histogram
+    {
+        public:
+            // Number of linear buckets in each power of two range.
+            static constexpr size_t sub_buckets_count = 16;
+            static constexpr size_t sub_bucket_bits = std::bit_width(sub_buckets_count) - 1;
+            // Values up to 2^48 nanoseconds(about 78 hours) are distinguished, bigger values fall into the last bucket.
+            static constexpr size_t max_value_bits = 48;
+            static constexpr size_t buckets_count = (max_value_bits - sub_bucket_bits + 1) * sub_buckets_count;
+
+            // Get the index of the bucket that the value belongs to.
+            static constexpr size_t bucket_index(uint64_t value) noexcept
+            {
+                if (value < sub_buckets_count)
+                {
+                    return value;
+                }
+
+                size_t exponent = std::bit_width(value) - 1;
+
+                return std::min(
+                    (exponent - sub_bucket_bits + 1) * sub_buckets_count +
+                        ((value >> (exponent - sub_bucket_bits)) & (sub_buckets_count - 1)),
+                    buckets_count - 1);
+            }
+
+            // Get the highest value that belongs to the bucket with specified index.
+            static constexpr uint64_t bucket_upper_bound(size_t index) noexcept
+            {
+                if (index < sub_buckets_count)
+                {
+                    return index;
+                }
+
+                size_t shift = index / sub_buckets_count - 1;
+
+                return ((sub_buckets_count + index % sub_buckets_count + 1) << shift) - 1;
+            }
+
+            void record(uint64_t value, uint64_t count = 1) noexcept
+            {
+                _counts[bucket_index(value)] += count;
+                _count += count;
+                _sum += value * count;
+            }
+
+            // Add all values recorded in other histogram to this one.
+            void merge(const histogram& other) noexcept
+            {
+                for (size_t i = 0; i < buckets_count; ++i)
+                {
+                    _counts[i] += other._counts[i];
+                }
+
+                _count += other._count;
+                _sum += other._sum;
+            }
+
+            // Get the latency below which the specified percentage(in range [0, 100]) of recorded latencies falls.
+            std::chrono::nanoseconds percentile(double percentage) const noexcept
+            {
+                if (_count == 0)
+                {
+                    return std::chrono::nanoseconds::zero();
+                }
+
+                uint64_t rank = std::max<uint64_t>(
+                    1,
+                    static_cast<uint64_t>(std::clamp(percentage, 0.0, 100.0) / 100 * _count + 0.5));
+                uint64_t accumulated_count = 0;
+
+                for (size_t i = 0; i < buckets_count; ++i)
+                {
+                    accumulated_count += _counts[i];
+
+                    if (accumulated_count >= rank)
+                    {
+                        return std::chrono::nanoseconds{bucket_upper_bound(i)};
+                    }
+                }
+
+                return std::chrono::nanoseconds{bucket_upper_bound(buckets_count - 1)};
+            }
+
+            std::chrono::nanoseconds mean() const noexcept
+            {
+                return std::chrono::nanoseconds{_count == 0 ? 0 : _sum / _count};
+            }
+
+            std::chrono::nanoseconds max() const noexcept
+            {
+                return percentile(100);
+            }
+
+            uint64_t count() const noexcept
+            {
+                return _count;
+            }
+
+            // Get the sum of all recorded values in nanoseconds.
+            uint64_t sum() const noexcept
+            {
+                return _sum;
+            }
+
+            const std::array<uint64_t, buckets_count>& counts() const noexcept
+            {
+                return _counts;
+            }
+
+        private:
+            friend class histogram_registry;
+
+            std::array<uint64_t, buckets_count> _counts{};
+            uint64_t _count{0};
+            uint64_t _sum{0};
+    };
+
+    // Registry of latency histograms of all downloading phases that can be shared between any number of downloaders
+    // working in different threads. Recording is lock-free: each thread records to its own shard with relaxed atomic
+    // increments, and shards are merged only when the snapshot is taken.
+    class histogram_registry
+    {
+        public:
+            /**
+             * @param shards_count number of independent shards to record values into. Threads are distributed
+             * between shards in round-robin order, so it should be not less than the number of threads using the registry.
+             */
+            explicit histogram_registry(size_t shards_count = std::max(1u, std::thread::hardware_concurrency()))
+                :
+                _shards_count{std::max<size_t>(1, shards_count)},
+                _shards{std::make_unique<shard[]>(_shards_count)}
+            {}
+
+            void record(latency_phase phase, std::chrono::steady_clock::duration latency) noexcept
+            {
+                uint64_t value = static_cast<uint64_t>(std::max<int64_t>(
+                    0,
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count()));
+
+                phase_counters& counters =
+                    _shards[detail::thread_shard_index(_shards_count)].phases[static_cast<size_t>(phase)];
+
+                counters.counts[histogram::bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+                counters.sum.fetch_add(value, std::memory_order_relaxed);
+            }
+
+            // Get the histogram of the phase merged from all shards.
+            // Values that are recorded concurrently with the snapshot may be either included or not.
+            histogram snapshot(latency_phase phase) const noexcept
+            {
+                histogram result;
+
+                for (size_t i = 0; i < _shards_count; ++i)
+                {
+                    const phase_counters& counters = _shards[i].phases[static_cast<size_t>(phase)];
+
+                    for (size_t j = 0; j < histogram::buckets_count; ++j)
+                    {
+                        uint64_t count = counters.counts[j].load(std::memory_order_relaxed);
+
+                        result._counts[j] += count;
+                        result._count += count;
+                    }
+
+                    result._sum += counters.sum.load(std::memory_order_relaxed);
+                }
+
+                return result;
+            }
+
+        private:
+            struct phase_counters
+            {
+                std::array<std::atomic<uint64_t>, histogram::buckets_count> counts{};
+                std::atomic<uint64_t> sum{0};
+            };
+
+            struct alignas(detail::cache_line_size) shard
+            {
+                std::array<phase_counters, latency_phases_count> phases{};
+            };
+
+            size_t _shards_count;
+            std::unique_ptr<shard[]> _shards;
+    };
+}
+
+#endif
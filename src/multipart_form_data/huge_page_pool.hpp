@@ -0,0 +1,269 @@
+#ifndef MULTIPART_FORM_DATA_HUGE_PAGE_POOL_HPP
+#define MULTIPART_FORM_DATA_HUGE_PAGE_POOL_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <unordered_set>
+#include <vector>
+
+#if defined(__linux__)
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+namespace multipart_form_data
+{
+    // Memory resource that backs large allocations, i.e. receive buffers of the downloaders, with 2 MB huge pages
+    // to reduce TLB misses while the boundary is searched in and the packets are copied from the buffers.
+    // Huge pages are taken from the reserved pool of the kernel(MAP_HUGETLB) and if there are none of them
+    // the memory is mapped with regular pages and advised to be backed by transparent huge pages(MADV_HUGEPAGE).
+    // Deallocated mappings are kept for reuse up to the specified amount, so the buffers of the next downloads
+    // don't pay for mapping and page faults. Allocations that are smaller than a huge page are passed to the upstream
+    // memory resource as well as all allocations on other platforms than Linux.
+    // The mapped memory can be placed on the specified NUMA node, so the buffers are local to the threads that scan them.
+    // It is thread safe, so it can be shared between all downloaders, directly or as the upstream of their pools.
+    class huge_page_pool : public std::pmr::memory_resource
+    {
+        public:
+            static constexpr size_t huge_page_size = 2 * 1024 * 1024;
+
+            /**
+             * @param max_cached_bytes maximum amount of deallocated memory that is kept for reuse,
+             * the rest is returned to the system.
+             * @param upstream memory resource for the allocations that are smaller than a huge page.
+             * @param numa_node NUMA node that the mapped memory is placed on, it is preferred rather than required,
+             * so the memory is taken from other nodes if the node runs out of it. Negative value means any node.
+             */
+            explicit huge_page_pool(
+                size_t max_cached_bytes = 256 * 1024 * 1024,
+                std::pmr::memory_resource* upstream = std::pmr::get_default_resource(),
+                int numa_node = -1)
+                :
+                _max_cached_bytes{max_cached_bytes},
+                _upstream{upstream},
+                _numa_node{numa_node}
+            {}
+
+            huge_page_pool(const huge_page_pool&) = delete;
+            huge_page_pool& operator=(const huge_page_pool&) = delete;
+
+            ~huge_page_pool()
+            {
+                for (auto& [size, blocks] : _cached_blocks)
+                {
+                    for (void* block : blocks)
+                    {
+                        unmap(block, size);
+                    }
+                }
+            }
+
+            // Get the amount of memory that is mapped by the pool including the cached one.
+            size_t mapped_bytes() const noexcept
+            {
+                return _mapped_bytes.load(std::memory_order_relaxed);
+            }
+
+            // Get the part of the mapped memory that is taken from the reserved huge pages of the kernel.
+            size_t reserved_huge_page_bytes() const noexcept
+            {
+                return _reserved_huge_page_bytes.load(std::memory_order_relaxed);
+            }
+
+            // Get the NUMA node that the mapped memory is placed on or negative value if it is any node.
+            int numa_node() const noexcept
+            {
+                return _numa_node;
+            }
+
+            // Get the amount of deallocated memory that is kept for reuse.
+            size_t cached_bytes() const
+            {
+                std::lock_guard lock{_mutex};
+
+                return _cached_bytes;
+            }
+
+        private:
+            void* do_allocate(size_t bytes, size_t alignment) override
+            {
+#if defined(__linux__)
+                if (bytes < huge_page_size || alignment > huge_page_size)
+                {
+                    return _upstream->allocate(bytes, alignment);
+                }
+
+                size_t size = mapping_size(bytes);
+
+                {
+                    std::lock_guard lock{_mutex};
+
+                    auto blocks = _cached_blocks.find(size);
+
+                    if (blocks != _cached_blocks.end() && !blocks->second.empty())
+                    {
+                        void* block = blocks->second.back();
+
+                        blocks->second.pop_back();
+                        _cached_bytes -= size;
+
+                        return block;
+                    }
+                }
+
+                return map(size);
+#else
+                return _upstream->allocate(bytes, alignment);
+#endif
+            }
+
+            void do_deallocate(void* pointer, size_t bytes, size_t alignment) override
+            {
+#if defined(__linux__)
+                if (bytes < huge_page_size || alignment > huge_page_size)
+                {
+                    return _upstream->deallocate(pointer, bytes, alignment);
+                }
+
+                size_t size = mapping_size(bytes);
+
+                {
+                    std::lock_guard lock{_mutex};
+
+                    if (_cached_bytes + size <= _max_cached_bytes)
+                    {
+                        _cached_blocks[size].push_back(pointer);
+                        _cached_bytes += size;
+
+                        return;
+                    }
+                }
+
+                unmap(pointer, size);
+#else
+                _upstream->deallocate(pointer, bytes, alignment);
+#endif
+            }
+
+            bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+            {
+                return this == &other;
+            }
+
+#if defined(__linux__)
+            static size_t mapping_size(size_t bytes) noexcept
+            {
+                return (bytes + huge_page_size - 1) / huge_page_size * huge_page_size;
+            }
+
+            void* map(size_t size)
+            {
+                void* block = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+                if (block != MAP_FAILED)
+                {
+                    bind_to_numa_node(block, size);
+
+                    _mapped_bytes.fetch_add(size, std::memory_order_relaxed);
+                    _reserved_huge_page_bytes.fetch_add(size, std::memory_order_relaxed);
+
+                    std::lock_guard lock{_mutex};
+
+                    _reserved_huge_page_blocks.insert(block);
+
+                    return block;
+                }
+
+                // There are no reserved huge pages so map regular pages with an extra huge page
+                // to align the block by the huge page size, otherwise transparent huge pages can't back it
+                size_t padded_size = size + huge_page_size;
+
+                void* padded_block = mmap(nullptr, padded_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+                if (padded_block == MAP_FAILED)
+                {
+                    throw std::bad_alloc{};
+                }
+
+                uintptr_t padded_begin = reinterpret_cast<uintptr_t>(padded_block);
+                uintptr_t begin = (padded_begin + huge_page_size - 1) / huge_page_size * huge_page_size;
+
+                // Return the unaligned head and the rest of the tail
+                if (begin != padded_begin)
+                {
+                    munmap(padded_block, begin - padded_begin);
+                }
+
+                munmap(reinterpret_cast<void*>(begin + size), padded_begin + padded_size - begin - size);
+
+                block = reinterpret_cast<void*>(begin);
+
+                madvise(block, size, MADV_HUGEPAGE);
+
+                bind_to_numa_node(block, size);
+
+                _mapped_bytes.fetch_add(size, std::memory_order_relaxed);
+
+                return block;
+            }
+
+            // Set the memory policy of the block before it is touched, so its pages are allocated on the NUMA node.
+            // The system call is used directly to not depend on libnuma.
+            void bind_to_numa_node(void* block, size_t size) const noexcept
+            {
+                // Memory policy that prefers the node and falls back to others(MPOL_PREFERRED of linux/mempolicy.h)
+                constexpr int preferred_memory_policy = 1;
+                constexpr size_t bits_per_mask_word = sizeof(unsigned long) * 8;
+
+                if (_numa_node < 0 || static_cast<size_t>(_numa_node) >= max_numa_nodes_count)
+                {
+                    return;
+                }
+
+                unsigned long nodes_mask[max_numa_nodes_count / bits_per_mask_word]{};
+
+                nodes_mask[_numa_node / bits_per_mask_word] = 1UL << (_numa_node % bits_per_mask_word);
+
+                // The kernel expects the number of bits in the mask plus one
+                syscall(SYS_mbind, block, size, preferred_memory_policy, nodes_mask, max_numa_nodes_count + 1, 0);
+            }
+
+            void unmap(void* block, size_t size) noexcept
+            {
+                munmap(block, size);
+
+                _mapped_bytes.fetch_sub(size, std::memory_order_relaxed);
+
+                std::lock_guard lock{_mutex};
+
+                if (_reserved_huge_page_blocks.erase(block))
+                {
+                    _reserved_huge_page_bytes.fetch_sub(size, std::memory_order_relaxed);
+                }
+            }
+#endif
+
+            // Maximum number of NUMA nodes that the memory can be bound to
+            static constexpr size_t max_numa_nodes_count = 1024;
+
+            size_t _max_cached_bytes;
+            std::pmr::memory_resource* _upstream;
+            int _numa_node;
+            mutable std::mutex _mutex{};
+            // Deallocated blocks grouped by their mapping sizes
+            std::map<size_t, std::vector<void*>> _cached_blocks{};
+            size_t _cached_bytes{0};
+            // Blocks that are mapped from the reserved huge pages
+            std::unordered_set<void*> _reserved_huge_page_blocks{};
+            std::atomic<size_t> _mapped_bytes{0};
+            std::atomic<size_t> _reserved_huge_page_bytes{0};
+    };
+}
+
+#endif
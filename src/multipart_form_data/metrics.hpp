@@ -0,0 +1,235 @@
+#ifndef MULTIPART_FORM_DATA_METRICS_HPP
+#define MULTIPART_FORM_DATA_METRICS_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <multipart_form_data/detail/thread_shard.hpp>
+#include <multipart_form_data/error.hpp>
+
+namespace multipart_form_data
+{
+    // Counters of the downloading processes that can be shared between any number of downloaders working in different threads
+    // and rendered in Prometheus text exposition format. Updates are lock-free: each thread updates its own shard
+    // with relaxed atomic operations, and shards are summed up only when the values are read.
+    class download_metrics
+    {
+        public:
+            // Labels of the errors that downloads are finished with. Errors that don't belong to multipart_form_data::error
+            // (e.g. asio or beast ones) are counted as "other".
+            static constexpr std::array<std::pair<error, std::string_view>, 7> error_labels{{
+                {error::not_multipart_form_data_request, "not_multipart_form_data_request"},
+                {error::invalid_structure, "invalid_structure"},
+                {error::invalid_file_path, "invalid_file_path"},
+                {error::operation_aborted, "operation_aborted"},
+                {error::overloaded, "overloaded"},
+                {error::descriptor_wait_timeout, "descriptor_wait_timeout"},
+                {error::post_processing_failed, "post_processing_failed"}}};
+            static constexpr size_t other_error_index = error_labels.size();
+
+            /**
+             * @param shards_count number of independent shards to count values into. Threads are distributed
+             * between shards in round-robin order, so it should be not less than the number of threads using the metrics.
+             */
+            explicit download_metrics(size_t shards_count = std::max(1u, std::thread::hardware_concurrency()))
+                :
+                _shards_count{std::max<size_t>(1, shards_count)},
+                _shards{std::make_unique<shard[]>(_shards_count)}
+            {}
+
+            void add_download_start() noexcept
+            {
+                shard& current_shard = current();
+
+                current_shard.downloads.fetch_add(1, std::memory_order_relaxed);
+                current_shard.active_downloads.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            void add_download_end(const error_code& error_code) noexcept
+            {
+                shard& current_shard = current();
+
+                current_shard.active_downloads.fetch_sub(1, std::memory_order_relaxed);
+
+                if (error_code)
+                {
+                    add_error(error_code);
+                }
+            }
+
+            void add_error(const error_code& error_code) noexcept
+            {
+                size_t index = other_error_index;
+
+                for (size_t i = 0; i < error_labels.size(); ++i)
+                {
+                    if (error_code == error_labels[i].first)
+                    {
+                        index = i;
+                        break;
+                    }
+                }
+
+                current().errors[index].fetch_add(1, std::memory_order_relaxed);
+            }
+
+            void add_bytes_received(uint64_t bytes) noexcept
+            {
+                current().bytes_received.fetch_add(bytes, std::memory_order_relaxed);
+            }
+
+            void add_bytes_written(uint64_t bytes) noexcept
+            {
+                current().bytes_written.fetch_add(bytes, std::memory_order_relaxed);
+            }
+
+            void add_file() noexcept
+            {
+                current().files.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            // Change the amount of memory that is held by the downloaders' buffers.
+            void add_buffer_memory(int64_t bytes) noexcept
+            {
+                current().buffer_memory.fetch_add(bytes, std::memory_order_relaxed);
+            }
+
+            uint64_t downloads() const noexcept
+            {
+                return sum(&shard::downloads);
+            }
+
+            int64_t active_downloads() const noexcept
+            {
+                return sum(&shard::active_downloads);
+            }
+
+            uint64_t bytes_received() const noexcept
+            {
+                return sum(&shard::bytes_received);
+            }
+
+            uint64_t bytes_written() const noexcept
+            {
+                return sum(&shard::bytes_written);
+            }
+
+            uint64_t files() const noexcept
+            {
+                return sum(&shard::files);
+            }
+
+            int64_t buffer_memory() const noexcept
+            {
+                return sum(&shard::buffer_memory);
+            }
+
+            // Get the number of errors with the index of the label in error_labels or other_error_index.
+            uint64_t errors(size_t index) const noexcept
+            {
+                uint64_t result = 0;
+
+                for (size_t i = 0; i < _shards_count; ++i)
+                {
+                    result += _shards[i].errors[index].load(std::memory_order_relaxed);
+                }
+
+                return result;
+            }
+
+            // Render all metrics in Prometheus text exposition format.
+            std::string render() const
+            {
+                std::string result;
+
+                render_metric(result, "downloads_total", "counter", "Number of started downloads.", downloads());
+                render_metric(result, "active_downloads", "gauge", "Number of downloads in progress.", active_downloads());
+                render_metric(result, "received_bytes_total", "counter",
+                    "Bytes of request bodies received from streams.", bytes_received());
+                render_metric(result, "written_bytes_total", "counter", "Bytes written to files.", bytes_written());
+                render_metric(result, "files_total", "counter", "Number of entirely downloaded files.", files());
+                render_metric(result, "buffer_memory_bytes", "gauge",
+                    "Memory held by downloaders' receive buffers.", buffer_memory());
+
+                result += "# HELP multipart_form_data_errors_total Number of downloads finished with the error.\n";
+                result += "# TYPE multipart_form_data_errors_total counter\n";
+
+                for (size_t i = 0; i <= error_labels.size(); ++i)
+                {
+                    result += "multipart_form_data_errors_total{code=\"";
+                    result += i < error_labels.size() ? error_labels[i].second : "other";
+                    result += "\"} ";
+                    result += std::to_string(errors(i));
+                    result += "\n";
+                }
+
+                return result;
+            }
+
+        private:
+            struct alignas(detail::cache_line_size) shard
+            {
+                std::atomic<uint64_t> downloads{0};
+                std::atomic<int64_t> active_downloads{0};
+                std::atomic<uint64_t> bytes_received{0};
+                std::atomic<uint64_t> bytes_written{0};
+                std::atomic<uint64_t> files{0};
+                std::atomic<int64_t> buffer_memory{0};
+                std::array<std::atomic<uint64_t>, error_labels.size() + 1> errors{};
+            };
+
+            shard& current() noexcept
+            {
+                return _shards[detail::thread_shard_index(_shards_count)];
+            }
+
+            // Sum up the counter over all shards. Gauges of separate shards can be negative
+            // because they are increased and decreased by different threads, but their sum is always correct.
+            template<typename value_t>
+            value_t sum(std::atomic<value_t> shard::* counter) const noexcept
+            {
+                value_t result = 0;
+
+                for (size_t i = 0; i < _shards_count; ++i)
+                {
+                    result += (_shards[i].*counter).load(std::memory_order_relaxed);
+                }
+
+                return result;
+            }
+
+            template<typename value_t>
+            static void render_metric(
+                std::string& result,
+                std::string_view name,
+                std::string_view type,
+                std::string_view help,
+                value_t value)
+            {
+                result += "# HELP multipart_form_data_";
+                result += name;
+                result += " ";
+                result += help;
+                result += "\n# TYPE multipart_form_data_";
+                result += name;
+                result += " ";
+                result += type;
+                result += "\nmultipart_form_data_";
+                result += name;
+                result += " ";
+                result += std::to_string(value);
+                result += "\n";
+            }
+
+            size_t _shards_count;
+            std::unique_ptr<shard[]> _shards;
+    };
+}
+
+#endif
@@ -1,6 +1,10 @@
 #ifndef MULTIPART_FORM_DATA_HPP
 #define MULTIPART_FORM_DATA_HPP
 
+#include <multipart_form_data/calibration.hpp>
 #include <multipart_form_data/downloader.hpp>
+#include <multipart_form_data/huge_page_pool.hpp>
+#include <multipart_form_data/numa.hpp>
+#include <multipart_form_data/uring.hpp>
 
 #endif
\ No newline at end of file
@@ -0,0 +1,260 @@
+#ifndef MULTIPART_FORM_DATA_NUMA_HPP
+#define MULTIPART_FORM_DATA_NUMA_HPP
+
+#include <multipart_form_data/huge_page_pool.hpp>
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#if defined(__linux__)
+    #include <pthread.h>
+    #include <sched.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+namespace multipart_form_data
+{
+    namespace detail
+    {
+        // Parse the list of CPUs or NUMA nodes in the format of sysfs, e.g. "0-3,8,10-11".
+        inline std::vector<int> parse_sysfs_list(std::string_view list)
+        {
+            std::vector<int> result;
+
+            while (!list.empty())
+            {
+                size_t range_end = list.find(',');
+                std::string range{list.substr(0, range_end)};
+
+                list.remove_prefix(range_end == std::string_view::npos ? list.size() : range_end + 1);
+
+                size_t dash = range.find('-');
+
+                try
+                {
+                    int first = std::stoi(range.substr(0, dash));
+                    int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+
+                    for (int i = first; i <= last; ++i)
+                    {
+                        result.push_back(i);
+                    }
+                }
+                catch (const std::exception&)
+                {
+                    // Skip the malformed range, e.g. the trailing new line
+                }
+            }
+
+            return result;
+        }
+
+        inline std::string read_sysfs_line(const std::filesystem::path& path)
+        {
+            std::ifstream file{path};
+            std::string line;
+
+            std::getline(file, line);
+
+            return line;
+        }
+    }
+
+    // Get NUMA nodes of the system, there is always at least the node 0.
+    inline std::vector<int> numa_nodes()
+    {
+        std::vector<int> nodes = detail::parse_sysfs_list(
+            detail::read_sysfs_line("/sys/devices/system/node/online"));
+
+        if (nodes.empty())
+        {
+            nodes.push_back(0);
+        }
+
+        return nodes;
+    }
+
+    // Get CPUs of the NUMA node or empty list if the topology is unknown.
+    inline std::vector<int> numa_node_cpus(int numa_node)
+    {
+        return detail::parse_sysfs_list(detail::read_sysfs_line(
+            "/sys/devices/system/node/node" + std::to_string(numa_node) + "/cpulist"));
+    }
+
+    // Get the NUMA node of the network interface's device, i.e. the node which memory the NIC writes received packets to,
+    // or negative value if it is unknown, e.g. for virtual interfaces or single node systems.
+    inline int network_interface_numa_node(std::string_view interface_name)
+    {
+        std::string numa_node = detail::read_sysfs_line(
+            std::filesystem::path{"/sys/class/net"} / interface_name / "device/numa_node");
+
+        try
+        {
+            return numa_node.empty() ? -1 : std::stoi(numa_node);
+        }
+        catch (const std::exception&)
+        {
+            return -1;
+        }
+    }
+
+    // Get the NUMA node of the CPU that the calling thread runs on or 0 if it is unknown.
+    inline int current_numa_node() noexcept
+    {
+#if defined(__linux__)
+        unsigned int cpu = 0;
+        unsigned int numa_node = 0;
+
+        if (syscall(SYS_getcpu, &cpu, &numa_node, nullptr) == 0)
+        {
+            return static_cast<int>(numa_node);
+        }
+#endif
+
+        return 0;
+    }
+
+    namespace detail
+    {
+        inline void pin_thread(const std::vector<int>& cpus, std::error_code& error_code)
+        {
+#if defined(__linux__)
+            if (cpus.empty())
+            {
+                error_code = std::make_error_code(std::errc::invalid_argument);
+
+                return;
+            }
+
+            cpu_set_t cpu_set;
+            CPU_ZERO(&cpu_set);
+
+            for (int cpu : cpus)
+            {
+                if (cpu >= 0 && cpu < CPU_SETSIZE)
+                {
+                    CPU_SET(cpu, &cpu_set);
+                }
+            }
+
+            if (int result = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set); result != 0)
+            {
+                error_code = std::error_code{result, std::generic_category()};
+            }
+#else
+            static_cast<void>(cpus);
+
+            error_code = std::make_error_code(std::errc::operation_not_supported);
+#endif
+        }
+    }
+
+    /**
+     * @brief Pin the calling thread to the CPUs of the NUMA node, so it runs close to the memory of the node.
+     * It is supposed to be called at the start of the I/O threads before they allocate their buffers.
+     *
+     * @param numa_node NUMA node that the thread is pinned to.
+     * @param error_code operation status.
+     */
+    inline void pin_thread_to_numa_node(int numa_node, std::error_code& error_code)
+    {
+        detail::pin_thread(numa_node_cpus(numa_node), error_code);
+    }
+
+    /**
+     * @brief Pin the calling thread to the CPU, e.g. to run one I/O thread per core. The thread is placed
+     * on the NUMA node of the CPU as well, so current_numa_node() can be used to choose its buffer pool afterwards.
+     *
+     * @param cpu CPU that the thread is pinned to.
+     * @param error_code operation status.
+     */
+    inline void pin_thread_to_cpu(int cpu, std::error_code& error_code)
+    {
+        detail::pin_thread({cpu}, error_code);
+    }
+
+    // Pools of receive buffers per NUMA node. Each pool places its memory on its node, so the threads that are pinned
+    // to the node take the buffers from the local pool and the boundary is searched in the local memory instead of
+    // the memory of the other node. It is thread safe as the pools are.
+    class numa_pools
+    {
+        public:
+            /**
+             * @param max_cached_bytes maximum amount of deallocated memory that is kept for reuse by each pool.
+             * @param upstream memory resource for the allocations that are smaller than a huge page.
+             */
+            explicit numa_pools(
+                size_t max_cached_bytes = 256 * 1024 * 1024,
+                std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+            {
+                for (int numa_node : numa_nodes())
+                {
+                    if (static_cast<size_t>(numa_node) >= _pools.size())
+                    {
+                        _pools.resize(numa_node + 1);
+                    }
+
+                    _pools[numa_node] = std::make_unique<huge_page_pool>(max_cached_bytes, upstream, numa_node);
+                }
+            }
+
+            numa_pools(const numa_pools&) = delete;
+            numa_pools& operator=(const numa_pools&) = delete;
+
+            // Get the pool of the NUMA node, the pool of the first node is returned if there is no such node.
+            huge_page_pool& pool(int numa_node) noexcept
+            {
+                if (numa_node >= 0 && static_cast<size_t>(numa_node) < _pools.size() && _pools[numa_node])
+                {
+                    return *_pools[numa_node];
+                }
+
+                for (std::unique_ptr<huge_page_pool>& pool : _pools)
+                {
+                    if (pool)
+                    {
+                        return *pool;
+                    }
+                }
+
+                return *_pools.front();
+            }
+
+            // Get the pool of the NUMA node that the calling thread runs on.
+            huge_page_pool& local_pool() noexcept
+            {
+                return pool(current_numa_node());
+            }
+
+            // Get the amount of memory that is mapped by all pools.
+            size_t mapped_bytes() const noexcept
+            {
+                size_t result = 0;
+
+                for (const std::unique_ptr<huge_page_pool>& pool : _pools)
+                {
+                    if (pool)
+                    {
+                        result += pool->mapped_bytes();
+                    }
+                }
+
+                return result;
+            }
+
+        private:
+            // Pools indexed by NUMA nodes, offline nodes don't have them
+            std::vector<std::unique_ptr<huge_page_pool>> _pools{};
+    };
+}
+
+#endif
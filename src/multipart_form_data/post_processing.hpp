@@ -0,0 +1,339 @@
+#ifndef MULTIPART_FORM_DATA_POST_PROCESSING_HPP
+#define MULTIPART_FORM_DATA_POST_PROCESSING_HPP
+
+#include <multipart_form_data/detail/thread_shard.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace multipart_form_data
+{
+    // Pool of threads that process the downloaded files after they are written, e.g. scan, index or make thumbnails,
+    // so the CPU-heavy work doesn't block the reading of the connections in the I/O threads.
+    // Each thread has its own queue: the tasks that are posted from the thread of the pool are pushed into its queue
+    // and taken back in the reverse order, while the idle threads steal the oldest tasks from the queues of the others.
+    // The tasks that are posted from other threads are distributed between the queues in round-robin order.
+    class post_processing_pool
+    {
+        public:
+            /**
+             * @param threads_count number of the processing threads.
+             */
+            explicit post_processing_pool(size_t threads_count = std::max(1u, std::thread::hardware_concurrency()))
+                :
+                _threads_count{std::max<size_t>(1, threads_count)},
+                _queues{std::make_unique<worker_queue[]>(_threads_count)}
+            {
+                _threads.reserve(_threads_count);
+
+                for (size_t i = 0; i < _threads_count; ++i)
+                {
+                    _threads.emplace_back(
+                        [this, i]()
+                        {
+                            run(i);
+                        });
+                }
+            }
+
+            post_processing_pool(const post_processing_pool&) = delete;
+            post_processing_pool& operator=(const post_processing_pool&) = delete;
+
+            // The tasks that are already posted are executed before the threads are over.
+            ~post_processing_pool()
+            {
+                {
+                    std::lock_guard lock{_idle_mutex};
+
+                    _is_stopped = true;
+                }
+
+                _idle_condition.notify_all();
+
+                for (std::thread& thread : _threads)
+                {
+                    thread.join();
+                }
+            }
+
+            size_t threads_count() const noexcept
+            {
+                return _threads_count;
+            }
+
+            // Number of the tasks that are executed since the pool is created.
+            uint64_t processed_tasks() const noexcept
+            {
+                return _processed_tasks.load(std::memory_order_relaxed);
+            }
+
+            // Number of the tasks that are executed by another thread than the one whose queue they were posted to.
+            uint64_t stolen_tasks() const noexcept
+            {
+                return _stolen_tasks.load(std::memory_order_relaxed);
+            }
+
+            /**
+             * @brief Post the task to be executed in a thread of the pool. Exceptions of the task are ignored.
+             */
+            void post(std::function<void()> task)
+            {
+                size_t index = _current_pool == this
+                    ? _current_index
+                    : _next_queue.fetch_add(1, std::memory_order_relaxed) % _threads_count;
+
+                // The counter is increased first, so an idle thread never misses the task
+                _queued_tasks.fetch_add(1);
+
+                {
+                    std::lock_guard lock{_queues[index].mutex};
+
+                    _queues[index].tasks.push_back(std::move(task));
+                }
+
+                // The thread that is about to sleep either sees the task or is already counted as idle
+                if (_idle_threads.load() != 0)
+                {
+                    {
+                        std::lock_guard lock{_idle_mutex};
+                    }
+
+                    _idle_condition.notify_one();
+                }
+            }
+
+        private:
+            struct alignas(detail::cache_line_size) worker_queue
+            {
+                std::mutex mutex{};
+                std::deque<std::function<void()>> tasks{};
+            };
+
+            // Execute the tasks of the thread with the specified index until the pool is destroyed.
+            void run(size_t index)
+            {
+                _current_pool = this;
+                _current_index = index;
+
+                std::function<void()> task;
+
+                while (true)
+                {
+                    if (take(index, task))
+                    {
+                        _queued_tasks.fetch_sub(1);
+
+                        try
+                        {
+                            task();
+                        }
+                        catch (...)
+                        {
+                            // The failed task doesn't stop the thread
+                        }
+
+                        task = nullptr;
+
+                        _processed_tasks.fetch_add(1, std::memory_order_relaxed);
+
+                        continue;
+                    }
+
+                    std::unique_lock lock{_idle_mutex};
+
+                    _idle_threads.fetch_add(1);
+
+                    _idle_condition.wait(
+                        lock,
+                        [this]()
+                        {
+                            return _queued_tasks.load() != 0 || _is_stopped;
+                        });
+
+                    _idle_threads.fetch_sub(1);
+
+                    if (_is_stopped && _queued_tasks.load() == 0)
+                    {
+                        return;
+                    }
+                }
+            }
+
+            // Take the newest task of the own queue or steal the oldest one from the other queues.
+            // Return false if all queues are empty.
+            bool take(size_t index, std::function<void()>& task)
+            {
+                {
+                    std::lock_guard lock{_queues[index].mutex};
+
+                    if (!_queues[index].tasks.empty())
+                    {
+                        task = std::move(_queues[index].tasks.back());
+                        _queues[index].tasks.pop_back();
+
+                        return true;
+                    }
+                }
+
+                for (size_t i = 1; i < _threads_count; ++i)
+                {
+                    worker_queue& victim = _queues[(index + i) % _threads_count];
+
+                    std::lock_guard lock{victim.mutex};
+
+                    if (!victim.tasks.empty())
+                    {
+                        task = std::move(victim.tasks.front());
+                        victim.tasks.pop_front();
+
+                        _stolen_tasks.fetch_add(1, std::memory_order_relaxed);
+
+                        return true;
+                    }
+                }
+
+                return false;
+            }
+
+            // Pool and the index of the queue of the current thread if it belongs to a pool
+            static inline thread_local post_processing_pool* _current_pool{nullptr};
+            static inline thread_local size_t _current_index{0};
+
+            const size_t _threads_count;
+            std::unique_ptr<worker_queue[]> _queues;
+            std::vector<std::thread> _threads{};
+            std::atomic<size_t> _next_queue{0};
+            // Number of the tasks that are posted but not taken yet, it is increased before the task is pushed
+            std::atomic<size_t> _queued_tasks{0};
+            std::atomic<size_t> _idle_threads{0};
+            std::mutex _idle_mutex{};
+            std::condition_variable _idle_condition{};
+            bool _is_stopped{false};
+            std::atomic<uint64_t> _processed_tasks{0};
+            std::atomic<uint64_t> _stolen_tasks{0};
+    };
+
+    namespace detail
+    {
+        // Post-processing of the files of one downloading process. It is shared between the downloader and the tasks
+        // of its files, so it outlives the downloader if the files are still processed.
+        class post_processing_batch : public std::enable_shared_from_this<post_processing_batch>
+        {
+            public:
+                post_processing_batch(post_processing_pool& pool, std::function<void(const std::filesystem::path&)> handler)
+                    :
+                    _pool{pool},
+                    _handler{std::move(handler)}
+                {}
+
+                // Post the processing of the file to the pool.
+                void process(const std::filesystem::path& file_path)
+                {
+                    {
+                        std::lock_guard lock{_mutex};
+
+                        ++_pending_files;
+                    }
+
+                    _pool.post(
+                        [batch = shared_from_this(), file_path]()
+                        {
+                            batch->run(file_path);
+                        });
+                }
+
+                // Mark the downloading process as finished. Return true if all files are already processed,
+                // otherwise on_processed is invoked by the thread of the pool that processes the last file.
+                bool finish(std::function<void()> on_processed)
+                {
+                    std::lock_guard lock{_mutex};
+
+                    if (_pending_files == 0)
+                    {
+                        return true;
+                    }
+
+                    _on_processed = std::move(on_processed);
+
+                    return false;
+                }
+
+                // Block the thread until all files are processed.
+                void wait()
+                {
+                    std::unique_lock lock{_mutex};
+
+                    _processed_condition.wait(
+                        lock,
+                        [this]()
+                        {
+                            return _pending_files == 0;
+                        });
+                }
+
+                // Whether the handler threw an exception for any file.
+                bool is_failed() const
+                {
+                    std::lock_guard lock{_mutex};
+
+                    return _is_failed;
+                }
+
+            private:
+                void run(const std::filesystem::path& file_path)
+                {
+                    bool is_failed = false;
+
+                    try
+                    {
+                        _handler(file_path);
+                    }
+                    catch (...)
+                    {
+                        is_failed = true;
+                    }
+
+                    std::function<void()> on_processed;
+
+                    {
+                        std::lock_guard lock{_mutex};
+
+                        _is_failed = _is_failed || is_failed;
+
+                        if (--_pending_files == 0)
+                        {
+                            on_processed = std::move(_on_processed);
+                            _on_processed = nullptr;
+                        }
+                    }
+
+                    _processed_condition.notify_all();
+
+                    if (on_processed)
+                    {
+                        on_processed();
+                    }
+                }
+
+                post_processing_pool& _pool;
+                std::function<void(const std::filesystem::path&)> _handler;
+                mutable std::mutex _mutex{};
+                std::condition_variable _processed_condition{};
+                size_t _pending_files{0};
+                bool _is_failed{false};
+                std::function<void()> _on_processed{};
+        };
+    }
+};
+
+#endif
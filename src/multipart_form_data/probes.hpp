@@ -0,0 +1,32 @@
+#ifndef MULTIPART_FORM_DATA_PROBES_HPP
+#define MULTIPART_FORM_DATA_PROBES_HPP
+
+// USDT(user-level statically defined tracing) probes of the downloading process.
+// They are compiled out by default and can be enabled by defining MULTIPART_FORM_DATA_ENABLE_USDT,
+// which requires <sys/sdt.h> from systemtap-sdt-dev package. When enabled, every probe is a single nop
+// instruction until a tracer(e.g. bpftrace or perf) attaches to it, so they can be left in production builds.
+//
+// All probes belong to the "multipart_form_data" provider and the first argument of each probe
+// is the address of the downloader instance, so it can be used as a key to correlate events of one download:
+//     part_begin(downloader, part_number) - the file header is read and is about to be parsed.
+//     header_parsed(downloader, file_path) - the file path is determined and the file is opened.
+//     packet_read(downloader, bytes) - the packet of the file body is read to the buffer.
+//     packet_written(downloader, bytes) - the packet of the file body is written to the file.
+//     part_end(downloader, file_path) - the file is entirely written and closed.
+//     tcp_info(downloader, receive_rtt_us, retransmits, receive_window) - kernel statistics of the connection are sampled
+//         at the file boundary or at the end of the downloading process(only if settings::sample_tcp_info is set).
+//     error(downloader, error_value, error_category_name) - the downloading is aborted with the error.
+//
+// Example of measuring the disk write latency with bpftrace:
+//     bpftrace -e 'usdt:./app:multipart_form_data:packet_read { @start[arg0] = nsecs; }
+//                  usdt:./app:multipart_form_data:packet_written /@start[arg0]/
+//                  { @write_ns = hist(nsecs - @start[arg0]); delete(@start[arg0]); }'
+#if defined(MULTIPART_FORM_DATA_ENABLE_USDT)
+    #include <sys/sdt.h>
+
+    #define MULTIPART_FORM_DATA_PROBE(name, ...) STAP_PROBEV(multipart_form_data, name, __VA_ARGS__)
+#else
+    #define MULTIPART_FORM_DATA_PROBE(name, ...) static_cast<void>(0)
+#endif
+
+#endif
@@ -0,0 +1,255 @@
+#ifndef MULTIPART_FORM_DATA_PROGRESS_HPP
+#define MULTIPART_FORM_DATA_PROGRESS_HPP
+
+#include <multipart_form_data/error.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+
+namespace multipart_form_data
+{
+    // Progress of the downloading process that is delivered to the callback of the progress reporter.
+    struct progress_event
+    {
+        // Identifier of the downloading process from the settings, e.g. the one of the upload in the UI.
+        uint64_t download_id{0};
+        // Bytes of the request body that are received so far, including the ones that are read along with the request header.
+        uint64_t received_bytes{0};
+        // Length of the request body from the settings, it is zero if the length is unknown.
+        uint64_t content_length{0};
+        // Number of the files that are entirely written so far.
+        size_t files_count{0};
+        // Whether the downloading process is over, then result is its error code.
+        bool is_finished{false};
+        error_code result{};
+    };
+
+    // Reporter of the progress of downloads to the callback that is invoked in its own consumer thread, so the callback
+    // doesn't delay the reading of the connections. Each downloader publishes the event when both the minimum interval
+    // and the minimum number of bytes have passed since the previous one, in addition to the events of the start and
+    // of the end of the downloading process, so the hot path usually costs a comparison of two numbers.
+    // Events are published into a bounded lock-free queue with multiple producers and a single consumer. A quarter of
+    // the queue is reserved for the final events. If the rest of the queue is full then the intermediate event is dropped
+    // and counted, the next one of the download carries its cumulative progress anyway. The final event is never dropped,
+    // as nothing comes after it: it takes a reserved cell or waits for the consumer to free one.
+    // It can be shared between any number of downloaders working in different threads and has to outlive them.
+    class progress_reporter
+    {
+        public:
+            /**
+             * @param callback function that is invoked in the consumer thread for each event. Exceptions of the
+             * callback are ignored.
+             * @param interval minimum time between the events of one download.
+             * @param bytes minimum number of the received bytes between the events of one download.
+             * @param capacity number of the events that can be waiting for the callback at once,
+             * it is rounded up to a power of two. A quarter of it is reserved for the final events.
+             */
+            explicit progress_reporter(
+                std::function<void(const progress_event&)> callback,
+                std::chrono::steady_clock::duration interval = std::chrono::milliseconds(100),
+                uint64_t bytes = 1024 * 1024,
+                size_t capacity = 4096)
+                :
+                _callback{std::move(callback)},
+                _interval{interval},
+                _bytes{bytes},
+                _mask{std::bit_ceil(std::max<size_t>(4, capacity)) - 1},
+                _intermediate_capacity{(_mask + 1) - (_mask + 1) / 4},
+                _cells{std::make_unique<cell[]>(_mask + 1)}
+            {
+                for (size_t i = 0; i <= _mask; ++i)
+                {
+                    _cells[i].sequence.store(i, std::memory_order_relaxed);
+                }
+
+                _consumer = std::thread{
+                    [this]()
+                    {
+                        consume();
+                    }};
+            }
+
+            progress_reporter(const progress_reporter&) = delete;
+            progress_reporter& operator=(const progress_reporter&) = delete;
+
+            // The events that are already published are delivered before the consumer thread is over.
+            ~progress_reporter()
+            {
+                _is_stopped.store(true, std::memory_order_relaxed);
+                _published_events.fetch_add(1, std::memory_order_release);
+                _published_events.notify_one();
+
+                _consumer.join();
+            }
+
+            std::chrono::steady_clock::duration interval() const noexcept
+            {
+                return _interval;
+            }
+
+            uint64_t bytes() const noexcept
+            {
+                return _bytes;
+            }
+
+            // Number of the intermediate events that were dropped as the queue was full.
+            uint64_t dropped_events() const noexcept
+            {
+                return _dropped_events.load(std::memory_order_relaxed);
+            }
+
+            /**
+             * @brief Publish the event for the consumer thread. It doesn't allocate and doesn't block unless
+             * the event is final and the whole queue is full, then it waits for the consumer to free a cell.
+             *
+             * @return False if the event is intermediate and it is dropped as the queue is full.
+             */
+            bool publish(const progress_event& event) noexcept
+            {
+                // The intermediate events leave the reserved cells to the final ones
+                if (!event.is_finished && _queued_events.load(std::memory_order_relaxed) >= _intermediate_capacity)
+                {
+                    _dropped_events.fetch_add(1, std::memory_order_relaxed);
+
+                    return false;
+                }
+
+                size_t position = _enqueue_position.load(std::memory_order_relaxed);
+                cell* target = nullptr;
+
+                // Claim the cell whose sequence says that it is free for this position
+                while (true)
+                {
+                    target = &_cells[position & _mask];
+
+                    size_t sequence = target->sequence.load(std::memory_order_acquire);
+                    intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+                    if (difference == 0)
+                    {
+                        if (_enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                        {
+                            break;
+                        }
+                    }
+                    else if (difference < 0)
+                    {
+                        if (!event.is_finished)
+                        {
+                            _dropped_events.fetch_add(1, std::memory_order_relaxed);
+
+                            return false;
+                        }
+
+                        // The final events took the reserved cells as well, the consumer frees them soon
+                        std::this_thread::yield();
+
+                        position = _enqueue_position.load(std::memory_order_relaxed);
+                    }
+                    else
+                    {
+                        position = _enqueue_position.load(std::memory_order_relaxed);
+                    }
+                }
+
+                _queued_events.fetch_add(1, std::memory_order_relaxed);
+
+                target->event = event;
+                target->sequence.store(position + 1, std::memory_order_release);
+
+                // The consumer thread is woken up only if it waits
+                _published_events.fetch_add(1, std::memory_order_release);
+                _published_events.notify_one();
+
+                return true;
+            }
+
+        private:
+            struct cell
+            {
+                // Position of the event that the cell holds plus one or the position that can be written into
+                std::atomic<size_t> sequence{0};
+                progress_event event{};
+            };
+
+            // Deliver the events to the callback until the reporter is destroyed.
+            void consume()
+            {
+                while (true)
+                {
+                    // The counter is loaded before the queue is drained, so an event that is published meanwhile
+                    // changes it and the wait is over right away
+                    uint64_t published_events = _published_events.load(std::memory_order_acquire);
+
+                    while (deliver_next())
+                    {}
+
+                    if (_is_stopped.load(std::memory_order_relaxed))
+                    {
+                        while (deliver_next())
+                        {}
+
+                        return;
+                    }
+
+                    _published_events.wait(published_events, std::memory_order_acquire);
+                }
+            }
+
+            // Deliver the next event if there is. Return false if the queue is empty.
+            bool deliver_next()
+            {
+                cell& source = _cells[_dequeue_position & _mask];
+
+                if (source.sequence.load(std::memory_order_acquire) != _dequeue_position + 1)
+                {
+                    return false;
+                }
+
+                progress_event event = source.event;
+
+                source.sequence.store(_dequeue_position + _mask + 1, std::memory_order_release);
+                ++_dequeue_position;
+
+                _queued_events.fetch_sub(1, std::memory_order_relaxed);
+
+                try
+                {
+                    _callback(event);
+                }
+                catch (...)
+                {
+                    // The progress is informational, so the failed callback doesn't stop the delivery
+                }
+
+                return true;
+            }
+
+            std::function<void(const progress_event&)> _callback;
+            const std::chrono::steady_clock::duration _interval;
+            const uint64_t _bytes;
+            const size_t _mask;
+            // Number of the cells that the intermediate events can take, the rest are reserved for the final events
+            const size_t _intermediate_capacity;
+            std::unique_ptr<cell[]> _cells;
+            // Producers and the consumer use different cache lines
+            alignas(64) std::atomic<size_t> _enqueue_position{0};
+            std::atomic<uint64_t> _dropped_events{0};
+            // Number of the events that are claimed by the producers but not delivered yet
+            std::atomic<size_t> _queued_events{0};
+            alignas(64) std::atomic<uint64_t> _published_events{0};
+            std::atomic<bool> _is_stopped{false};
+            // Position of the next event that is delivered, it is used by the consumer thread only
+            size_t _dequeue_position{0};
+            std::thread _consumer{};
+    };
+};
+
+#endif
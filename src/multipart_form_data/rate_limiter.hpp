@@ -0,0 +1,147 @@
+#ifndef MULTIPART_FORM_DATA_RATE_LIMITER_HPP
+#define MULTIPART_FORM_DATA_RATE_LIMITER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+
+namespace multipart_form_data
+{
+    // Token bucket that limits the receiving rate of downloaders, e.g. the one of a connection, of a tenant or of the whole
+    // server. Buckets form a hierarchy: bytes that are taken from the bucket are taken from all of its ancestors as well,
+    // so a connection is limited by the most restrictive level above it. The bucket can be shared between any number
+    // of downloaders working in different threads and its limit can be changed at any time.
+    // The state of the bucket is the time when it becomes full again(GCRA), so taking bytes from it is a single
+    // compare-and-swap loop. Bytes are taken after they are received, so the bucket can go into debt and the downloader
+    // pauses its reading until the debt is paid off.
+    class token_bucket
+    {
+        public:
+            /**
+             * @param rate limit of the rate in bytes per second. If it is zero then the bucket itself doesn't limit the rate,
+             * but its ancestors still do.
+             * @param burst number of bytes that can be received at once after the bucket is idle for a while.
+             * @param parent bucket of the upper level of the hierarchy, e.g. the one of the tenant for the bucket of the
+             * connection. It has to outlive the bucket. If it is nullptr then the bucket is the root of the hierarchy.
+             */
+            explicit token_bucket(uint64_t rate = 0, uint64_t burst = 256 * 1024, token_bucket* parent = nullptr) noexcept
+                :
+                _rate{rate},
+                _burst{burst},
+                _parent{parent}
+            {}
+
+            token_bucket(const token_bucket&) = delete;
+            token_bucket& operator=(const token_bucket&) = delete;
+
+            /**
+             * @brief Change the limit of the bucket. It is applied to the bytes that are taken after the change,
+             * the debt that is already made is paid off at the previous rate.
+             *
+             * @param rate limit of the rate in bytes per second, zero means no limit.
+             * @param burst number of bytes that can be received at once after the bucket is idle for a while.
+             */
+            void limit(uint64_t rate, uint64_t burst) noexcept
+            {
+                _burst.store(burst, std::memory_order_relaxed);
+                _rate.store(rate, std::memory_order_relaxed);
+            }
+
+            uint64_t rate() const noexcept
+            {
+                return _rate.load(std::memory_order_relaxed);
+            }
+
+            uint64_t burst() const noexcept
+            {
+                return _burst.load(std::memory_order_relaxed);
+            }
+
+            token_bucket* parent() const noexcept
+            {
+                return _parent;
+            }
+
+            /**
+             * @brief Take the received bytes from the bucket and all of its ancestors.
+             *
+             * @param bytes number of the received bytes.
+             * @param now current time.
+             *
+             * @return Time when the receiving can be resumed, it is not later than now if none of the buckets is in debt.
+             */
+            std::chrono::steady_clock::time_point take(uint64_t bytes, std::chrono::steady_clock::time_point now) noexcept
+            {
+                std::chrono::steady_clock::time_point resume_time = now;
+
+                for (token_bucket* bucket = this; bucket; bucket = bucket->_parent)
+                {
+                    resume_time = std::max(resume_time, bucket->take_own(bytes, now));
+                }
+
+                return resume_time;
+            }
+
+            /**
+             * @brief Get the smallest burst of the bucket and its ancestors that limit the rate.
+             *
+             * @return The smallest burst or the maximum value if none of the buckets limits the rate.
+             */
+            uint64_t min_burst() const noexcept
+            {
+                uint64_t burst = std::numeric_limits<uint64_t>::max();
+
+                for (const token_bucket* bucket = this; bucket; bucket = bucket->_parent)
+                {
+                    if (bucket->rate() != 0)
+                    {
+                        burst = std::min(burst, bucket->burst());
+                    }
+                }
+
+                return burst;
+            }
+
+        private:
+            // Take the bytes from this bucket only and return the time when it is out of debt.
+            std::chrono::steady_clock::time_point take_own(uint64_t bytes, std::chrono::steady_clock::time_point now) noexcept
+            {
+                uint64_t rate = _rate.load(std::memory_order_relaxed);
+
+                if (rate == 0)
+                {
+                    return now;
+                }
+
+                // Time of receiving of the bytes and of the burst at the limited rate
+                int64_t bytes_time = static_cast<int64_t>(static_cast<double>(bytes) * 1e9 / static_cast<double>(rate));
+                int64_t burst_time = static_cast<int64_t>(
+                    static_cast<double>(_burst.load(std::memory_order_relaxed)) * 1e9 / static_cast<double>(rate));
+                int64_t now_time = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+
+                // The bucket that is full since the past is full since now, so idle time doesn't accumulate above the burst
+                int64_t full_time = _full_time.load(std::memory_order_relaxed);
+                int64_t new_full_time = 0;
+
+                do
+                {
+                    new_full_time = std::max(full_time, now_time) + bytes_time;
+                }
+                while (!_full_time.compare_exchange_weak(full_time, new_full_time, std::memory_order_relaxed));
+
+                return std::chrono::steady_clock::time_point{
+                    std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                        std::chrono::nanoseconds{new_full_time - burst_time})};
+            }
+
+            std::atomic<uint64_t> _rate;
+            std::atomic<uint64_t> _burst;
+            token_bucket* const _parent;
+            // Time since the epoch of the steady clock in nanoseconds when all taken bytes are paid off
+            std::atomic<int64_t> _full_time{0};
+    };
+};
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef MULTIPART_FORM_DATA_TCP_INFO_HPP
+#define MULTIPART_FORM_DATA_TCP_INFO_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__linux__)
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <sys/socket.h>
+#else
+    #include <boost/core/ignore_unused.hpp>
+#endif
+
+#include <multipart_form_data/detail/socket.hpp>
+
+namespace multipart_form_data
+{
+    // Kernel statistics of the TCP connection that allow to tell whether the upload is limited by the network or not.
+    struct tcp_info_sample
+    {
+        // Smoothed round trip time measured by the acknowledgments of the sent data and its variance.
+        std::chrono::microseconds rtt{};
+        std::chrono::microseconds rtt_variance{};
+        // Round trip time estimated by the receiving side. It is the relevant one for uploads
+        // as the server hardly sends any data while the request body is received.
+        std::chrono::microseconds receive_rtt{};
+        // Total number of retransmitted segments.
+        uint32_t retransmits{0};
+        // Receive window that the kernel tuned for the connection(rcv_space).
+        uint32_t receive_window{0};
+        // Delivery rate of the sent data in bytes per second. It is zero if the kernel doesn't provide it.
+        uint64_t delivery_rate{0};
+        // Bytes received by the connection. It is zero if the kernel doesn't provide it.
+        uint64_t bytes_received{0};
+        // Time passed since the last data was received by the kernel. Long time while the downloader waits for the data
+        // means the client or the network is the bottleneck, short one means the data is stuck in our side.
+        std::chrono::milliseconds since_last_data_received{};
+    };
+
+    namespace detail
+    {
+        // Prefix of struct tcp_info from <linux/tcp.h>. It is duplicated because <netinet/tcp.h> that is included
+        // by asio defines its own outdated version of the struct with the same name. Layout of the struct is a part of the
+        // kernel ABI and fields are only appended to it, so the returned length tells which fields are filled.
+        struct kernel_tcp_info
+        {
+            uint8_t state;
+            uint8_t ca_state;
+            uint8_t retransmits;
+            uint8_t probes;
+            uint8_t backoff;
+            uint8_t options;
+            uint8_t window_scales;
+            uint8_t delivery_rate_app_limited;
+            uint32_t rto;
+            uint32_t ato;
+            uint32_t snd_mss;
+            uint32_t rcv_mss;
+            uint32_t unacked;
+            uint32_t sacked;
+            uint32_t lost;
+            uint32_t retrans;
+            uint32_t fackets;
+            uint32_t last_data_sent;
+            uint32_t last_ack_sent;
+            uint32_t last_data_recv;
+            uint32_t last_ack_recv;
+            uint32_t pmtu;
+            uint32_t rcv_ssthresh;
+            uint32_t rtt;
+            uint32_t rttvar;
+            uint32_t snd_ssthresh;
+            uint32_t snd_cwnd;
+            uint32_t advmss;
+            uint32_t reordering;
+            uint32_t rcv_rtt;
+            uint32_t rcv_space;
+            uint32_t total_retrans;
+            uint64_t pacing_rate;
+            uint64_t max_pacing_rate;
+            uint64_t bytes_acked;
+            uint64_t bytes_received;
+            uint32_t segs_out;
+            uint32_t segs_in;
+            uint32_t notsent_bytes;
+            uint32_t min_rtt;
+            uint32_t data_segs_in;
+            uint32_t data_segs_out;
+            uint64_t delivery_rate;
+        };
+    }
+
+    /**
+     * @brief Sample kernel statistics of the TCP connection that lies under the stream.
+     *
+     * @param stream stream which lowest layer is a TCP socket.
+     * @param sample sample to fill in.
+     *
+     * @return Whether the sample is obtained. It is not if the platform doesn't support TCP_INFO
+     * or the stream is not a TCP socket.
+     */
+    template<typename stream_t>
+    bool sample_tcp_info(stream_t& stream, tcp_info_sample& sample) noexcept
+    {
+#if defined(__linux__)
+        auto& socket = detail::lowest_socket(stream);
+
+        if constexpr (requires { socket.native_handle(); })
+        {
+            detail::kernel_tcp_info info{};
+            socklen_t info_length = sizeof(info);
+
+            if (getsockopt(socket.native_handle(), IPPROTO_TCP, TCP_INFO, &info, &info_length) != 0 ||
+                info_length < offsetof(detail::kernel_tcp_info, pacing_rate))
+            {
+                return false;
+            }
+
+            sample.rtt = std::chrono::microseconds{info.rtt};
+            sample.rtt_variance = std::chrono::microseconds{info.rttvar};
+            sample.receive_rtt = std::chrono::microseconds{info.rcv_rtt};
+            sample.retransmits = info.total_retrans;
+            sample.receive_window = info.rcv_space;
+            sample.since_last_data_received = std::chrono::milliseconds{info.last_data_recv};
+            sample.bytes_received = info_length >= offsetof(detail::kernel_tcp_info, segs_out) ? info.bytes_received : 0;
+            sample.delivery_rate = info_length >= sizeof(info) ? info.delivery_rate : 0;
+
+            return true;
+        }
+        else
+        {
+            return false;
+        }
+#else
+        boost::ignore_unused(stream, sample);
+
+        return false;
+#endif
+    }
+}
+
+#endif
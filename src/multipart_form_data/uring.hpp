@@ -0,0 +1,1207 @@
+#ifndef MULTIPART_FORM_DATA_URING_HPP
+#define MULTIPART_FORM_DATA_URING_HPP
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/core/tcp_stream.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+
+// io_uring is used if the kernel headers provide multishot receive with provided buffer rings(Linux 6.0),
+// it can be disabled with MULTIPART_FORM_DATA_DISABLE_IO_URING definition
+#if defined(__linux__) && !defined(MULTIPART_FORM_DATA_DISABLE_IO_URING) && __has_include(<linux/io_uring.h>)
+    #include <linux/io_uring.h>
+
+    #if defined(IORING_RECV_MULTISHOT)
+        #define MULTIPART_FORM_DATA_HAS_IO_URING
+
+        #include <boost/asio/posix/stream_descriptor.hpp>
+
+        #include <linux/time_types.h>
+        #include <sys/eventfd.h>
+        #include <sys/mman.h>
+        #include <sys/syscall.h>
+        #include <unistd.h>
+    #endif
+#endif
+
+// The synchronous reads through the reactor wait for the data with poll to time out
+#if defined(__unix__)
+    #include <poll.h>
+#endif
+
+namespace multipart_form_data
+{
+    class uring_stream;
+
+    namespace detail
+    {
+        // Part of the received data that lies in the provided buffer.
+        struct uring_chunk
+        {
+            uint16_t buffer_id{0};
+            uint32_t offset{0};
+            uint32_t size{0};
+        };
+
+        // State of the receiving of one socket. It is owned by the context, because the kernel may complete
+        // the receive operation after the stream is destroyed.
+        struct uring_receiver
+        {
+            uint64_t id{0};
+            int socket{-1};
+            // Received data in the order of arrival
+            std::deque<uring_chunk> chunks{};
+            // Error or the end of the stream that is reported after all received data is taken
+            boost::system::error_code error{};
+            // Timer of the read operation that waits for the data, it is canceled to wake the operation up
+            boost::asio::steady_timer* waiter{nullptr};
+            // Whether the multishot receive operation is in flight
+            bool is_armed{false};
+            bool is_canceling{false};
+            // Whether the stream is destroyed and the receiver is kept only until the operation is completed
+            bool is_detached{false};
+        };
+
+        // Result of the preparation of the read from the receiver.
+        enum class uring_read_state
+        {
+            // There is received data or the error to take.
+            ready,
+            // The receive operation is in flight, so the read has to wait for its completion.
+            pending,
+            // The receive operation can't be armed, e.g. provided buffers ran out, so the socket has to be read directly.
+            unarmed
+        };
+    }
+
+    // Engine of the receiving of sockets through io_uring multishot receive operations with the ring of provided buffers
+    // that is shared by all sockets. The kernel takes a buffer from the ring only when the data arrives, so the memory
+    // of the ring(buffers_count * buffer_size, 64 MB by default) is shared by the connections that are receiving rather
+    // than held by each idle one, and the data of all connections is received without a system call per read. Completions are signaled through the eventfd that is waited by the io_context, so the engine runs
+    // in its threads along with the other asynchronous operations. The eventfd is waited only while there are receive
+    // operations in flight, so it doesn't keep io_context::run from returning once all streams are idle or closed.
+    // If io_uring is not supported by the kernel or is not allowed in the process, the context is not available
+    // and uring_stream reads through the asio reactor as beast::tcp_stream does. The same is done for the reads of
+    // the connection that holds max_connection_buffers or while all buffers are taken.
+    // It is not thread safe, so it is supposed to be one per single threaded io_context, e.g. per shard,
+    // and it has to outlive the streams that use it.
+    class uring_context
+    {
+        public:
+            /**
+             * @param io_context context that runs the completions of the receive operations.
+             * @param buffers_count number of provided buffers, it is rounded up to the power of two
+             * and can't exceed 32768.
+             * @param buffer_size size of each provided buffer, which is the maximum size of one received chunk.
+             * @param max_connection_buffers maximum number of buffers that the connection can hold
+             * with the received data that is not read yet. Its receiving is paused when it is reached, so one slow
+             * reader doesn't take the buffers of all connections.
+             * @param upstream memory resource to allocate the provided buffers from, e.g. huge_page_pool.
+             */
+            explicit uring_context(
+                boost::asio::io_context& io_context,
+                size_t buffers_count = 4096,
+                size_t buffer_size = 16 * 1024,
+                size_t max_connection_buffers = 16,
+                std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+                :
+                _buffers_count{std::bit_ceil(std::clamp<size_t>(buffers_count, 1, 32768))},
+                _buffer_size{std::max<size_t>(buffer_size, 1)},
+                _max_connection_buffers{std::max<size_t>(max_connection_buffers, 1)},
+                _upstream{upstream}
+            {
+#if defined(MULTIPART_FORM_DATA_HAS_IO_URING)
+                if (!setup(io_context))
+                {
+                    release();
+                }
+#else
+                static_cast<void>(io_context);
+
+                _setup_error = std::make_error_code(std::errc::function_not_supported);
+#endif
+            }
+
+            uring_context(const uring_context&) = delete;
+            uring_context& operator=(const uring_context&) = delete;
+
+            ~uring_context()
+            {
+#if defined(MULTIPART_FORM_DATA_HAS_IO_URING)
+                release();
+#endif
+            }
+
+            // Whether io_uring is set up, otherwise streams read through the asio reactor.
+            bool is_available() const noexcept
+            {
+                return _ring_fd >= 0 && _is_multishot_supported;
+            }
+
+            // Get the reason why io_uring is not available.
+            const std::error_code& setup_error() const noexcept
+            {
+                return _setup_error;
+            }
+
+            // Get the number of provided buffers that are not taken by the received data.
+            size_t free_buffers() const noexcept
+            {
+                return _free_buffers;
+            }
+
+            size_t buffers_count() const noexcept
+            {
+                return _buffers_count;
+            }
+
+            size_t buffer_size() const noexcept
+            {
+                return _buffer_size;
+            }
+
+        private:
+            friend class uring_stream;
+
+            // Identifier of the completions of cancel operations, receivers' identifiers start with 1
+            static constexpr uint64_t cancel_user_data = 0;
+            static constexpr uint16_t buffer_group = 0;
+
+#if defined(MULTIPART_FORM_DATA_HAS_IO_URING)
+            bool setup(boost::asio::io_context& io_context)
+            {
+                io_uring_params params{};
+
+                // Each data completion takes a buffer, so completions of all buffers fit into the completion queue
+                params.flags = IORING_SETUP_CQSIZE;
+                params.cq_entries = static_cast<unsigned>(2 * std::max<size_t>(_buffers_count, submission_entries));
+
+                _ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, submission_entries, &params));
+
+                if (_ring_fd < 0)
+                {
+                    _setup_error = std::error_code{errno, std::generic_category()};
+
+                    return false;
+                }
+
+                // The timeouts of the synchronous waits are passed as the extended argument(Linux 5.11)
+                if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP) ||
+                    !(params.features & IORING_FEAT_EXT_ARG))
+                {
+                    _setup_error = std::make_error_code(std::errc::function_not_supported);
+
+                    return false;
+                }
+
+                // Submission and completion queues share one mapping
+                _ring_size = std::max(
+                    params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                    params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+                _ring = mmap(nullptr, _ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQ_RING);
+
+                _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+                void* sqes = mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQES);
+
+                if (_ring == MAP_FAILED || sqes == MAP_FAILED)
+                {
+                    _setup_error = std::error_code{errno, std::generic_category()};
+                    _ring = _ring == MAP_FAILED ? nullptr : _ring;
+                    _sqes = sqes == MAP_FAILED ? nullptr : static_cast<io_uring_sqe*>(sqes);
+
+                    return false;
+                }
+
+                char* ring = static_cast<char*>(_ring);
+
+                _sqes = static_cast<io_uring_sqe*>(sqes);
+                _sq_head = reinterpret_cast<unsigned*>(ring + params.sq_off.head);
+                _sq_tail = reinterpret_cast<unsigned*>(ring + params.sq_off.tail);
+                _sq_flags = reinterpret_cast<unsigned*>(ring + params.sq_off.flags);
+                _sq_array = reinterpret_cast<unsigned*>(ring + params.sq_off.array);
+                _sq_mask = *reinterpret_cast<unsigned*>(ring + params.sq_off.ring_mask);
+                _sq_entries = params.sq_entries;
+                _cq_head = reinterpret_cast<unsigned*>(ring + params.cq_off.head);
+                _cq_tail = reinterpret_cast<unsigned*>(ring + params.cq_off.tail);
+                _cqes = reinterpret_cast<io_uring_cqe*>(ring + params.cq_off.cqes);
+                _cq_mask = *reinterpret_cast<unsigned*>(ring + params.cq_off.ring_mask);
+                _local_sq_tail = *_sq_tail;
+
+                if (!setup_buffer_ring() || !setup_eventfd(io_context))
+                {
+                    return false;
+                }
+
+                return true;
+            }
+
+            bool setup_buffer_ring()
+            {
+                // The ring of the buffers' descriptions has to be page aligned, so it is mapped separately from them
+                _buffer_ring_size = _buffers_count * sizeof(io_uring_buf);
+                void* buffer_ring = mmap(nullptr, _buffer_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+                if (buffer_ring == MAP_FAILED)
+                {
+                    _setup_error = std::error_code{errno, std::generic_category()};
+
+                    return false;
+                }
+
+                _buffer_ring = static_cast<io_uring_buf*>(buffer_ring);
+
+                io_uring_buf_reg buffer_ring_registration{};
+                buffer_ring_registration.ring_addr = reinterpret_cast<uint64_t>(_buffer_ring);
+                buffer_ring_registration.ring_entries = static_cast<uint32_t>(_buffers_count);
+                buffer_ring_registration.bgid = buffer_group;
+
+                // Provided buffer rings are supported since Linux 5.19
+                if (syscall(__NR_io_uring_register, _ring_fd, IORING_REGISTER_PBUF_RING, &buffer_ring_registration, 1) < 0)
+                {
+                    _setup_error = std::error_code{errno, std::generic_category()};
+
+                    return false;
+                }
+
+                try
+                {
+                    _buffers = static_cast<char*>(_upstream->allocate(_buffers_count * _buffer_size, 4096));
+                }
+                catch (const std::bad_alloc&)
+                {
+                    _setup_error = std::make_error_code(std::errc::not_enough_memory);
+
+                    return false;
+                }
+
+                for (size_t i = 0; i < _buffers_count; ++i)
+                {
+                    recycle_buffer(static_cast<uint16_t>(i));
+                }
+
+                return true;
+            }
+
+            bool setup_eventfd(boost::asio::io_context& io_context)
+            {
+                int eventfd_descriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+                if (eventfd_descriptor < 0)
+                {
+                    _setup_error = std::error_code{errno, std::generic_category()};
+
+                    return false;
+                }
+
+                // The descriptor owns the eventfd from now on
+                _eventfd.emplace(io_context, eventfd_descriptor);
+
+                if (syscall(__NR_io_uring_register, _ring_fd, IORING_REGISTER_EVENTFD, &eventfd_descriptor, 1) < 0)
+                {
+                    _setup_error = std::error_code{errno, std::generic_category()};
+
+                    return false;
+                }
+
+                return true;
+            }
+
+            void release() noexcept
+            {
+                // Closing the ring cancels all operations, so the kernel doesn't touch the buffers anymore
+                _eventfd.reset();
+
+                if (_ring_fd >= 0)
+                {
+                    close(_ring_fd);
+                    _ring_fd = -1;
+                }
+
+                if (_ring)
+                {
+                    munmap(_ring, _ring_size);
+                    _ring = nullptr;
+                }
+
+                if (_sqes)
+                {
+                    munmap(_sqes, _sqes_size);
+                    _sqes = nullptr;
+                }
+
+                if (_buffer_ring)
+                {
+                    munmap(_buffer_ring, _buffer_ring_size);
+                    _buffer_ring = nullptr;
+                }
+
+                if (_buffers)
+                {
+                    _upstream->deallocate(_buffers, _buffers_count * _buffer_size, 4096);
+                    _buffers = nullptr;
+                }
+
+                _receivers.clear();
+                _free_buffers = 0;
+            }
+
+            // Wait for the completions in the io_context until there are no receive operations in flight.
+            void wait_for_completions_async()
+            {
+                _is_waiting_for_completions = true;
+
+                _eventfd->async_wait(
+                    boost::asio::posix::descriptor_base::wait_read,
+                    [this](const boost::system::error_code& error_code)
+                    {
+                        // The context may be destroyed already if the operation is aborted
+                        if (error_code == boost::asio::error::operation_aborted)
+                        {
+                            return;
+                        }
+
+                        uint64_t value = 0;
+
+                        // Reset the counter of the eventfd
+                        static_cast<void>(::read(_eventfd->native_handle(), &value, sizeof(value)));
+
+                        process_completions();
+
+                        // The wait is started again by the next armed operation
+                        if (_armed_receivers == 0)
+                        {
+                            _is_waiting_for_completions = false;
+
+                            return;
+                        }
+
+                        wait_for_completions_async();
+                    });
+            }
+
+            // Get the next submission queue entry or nullptr if the queue is full.
+            io_uring_sqe* next_submission() noexcept
+            {
+                if (_local_sq_tail - std::atomic_ref<unsigned>{*_sq_head}.load(std::memory_order_acquire) >= _sq_entries)
+                {
+                    submit();
+
+                    if (_local_sq_tail - std::atomic_ref<unsigned>{*_sq_head}.load(std::memory_order_acquire) >= _sq_entries)
+                    {
+                        return nullptr;
+                    }
+                }
+
+                unsigned index = _local_sq_tail & _sq_mask;
+                io_uring_sqe* submission = &_sqes[index];
+
+                std::memset(submission, 0, sizeof(io_uring_sqe));
+
+                _sq_array[index] = index;
+                ++_local_sq_tail;
+
+                return submission;
+            }
+
+            // Pass all prepared submissions to the kernel.
+            void submit() noexcept
+            {
+                std::atomic_ref<unsigned>{*_sq_tail}.store(_local_sq_tail, std::memory_order_release);
+
+                unsigned pending = _local_sq_tail - std::atomic_ref<unsigned>{*_sq_head}.load(std::memory_order_acquire);
+
+                if (pending != 0)
+                {
+                    syscall(__NR_io_uring_enter, _ring_fd, pending, 0, 0, nullptr, 0);
+                }
+            }
+
+            bool arm(detail::uring_receiver& receiver) noexcept
+            {
+                io_uring_sqe* submission = next_submission();
+
+                if (!submission)
+                {
+                    return false;
+                }
+
+                // The kernel selects a buffer from the group for each chunk of the arrived data
+                // and keeps the operation until it fails or is canceled
+                submission->opcode = IORING_OP_RECV;
+                submission->fd = receiver.socket;
+                submission->ioprio = IORING_RECV_MULTISHOT;
+                submission->flags = IOSQE_BUFFER_SELECT;
+                submission->buf_group = buffer_group;
+                submission->user_data = receiver.id;
+
+                submit();
+
+                receiver.is_armed = true;
+                ++_armed_receivers;
+
+                if (!_is_waiting_for_completions)
+                {
+                    wait_for_completions_async();
+                }
+
+                return true;
+            }
+
+            void cancel(detail::uring_receiver& receiver) noexcept
+            {
+                if (receiver.is_canceling)
+                {
+                    return;
+                }
+
+                io_uring_sqe* submission = next_submission();
+
+                if (!submission)
+                {
+                    return;
+                }
+
+                submission->opcode = IORING_OP_ASYNC_CANCEL;
+                submission->fd = -1;
+                submission->addr = receiver.id;
+                submission->user_data = cancel_user_data;
+
+                submit();
+
+                receiver.is_canceling = true;
+            }
+
+            void recycle_buffer(uint16_t buffer_id) noexcept
+            {
+                io_uring_buf& buffer = _buffer_ring[_buffer_ring_tail & (_buffers_count - 1)];
+
+                buffer.addr = reinterpret_cast<uint64_t>(_buffers + buffer_id * _buffer_size);
+                buffer.len = static_cast<uint32_t>(_buffer_size);
+                buffer.bid = buffer_id;
+
+                ++_buffer_ring_tail;
+                ++_free_buffers;
+
+                // The tail of the ring overlays the reserved field of its first entry
+                std::atomic_ref<uint16_t>{_buffer_ring[0].resv}.store(_buffer_ring_tail, std::memory_order_release);
+            }
+
+            void process_completions() noexcept
+            {
+                for (;;)
+                {
+                    unsigned head = *_cq_head;
+                    unsigned tail = std::atomic_ref<unsigned>{*_cq_tail}.load(std::memory_order_acquire);
+
+                    for (; head != tail; ++head)
+                    {
+                        const io_uring_cqe& completion = _cqes[head & _cq_mask];
+
+                        process_completion(completion.user_data, completion.res, completion.flags);
+                    }
+
+                    std::atomic_ref<unsigned>{*_cq_head}.store(head, std::memory_order_release);
+
+                    // Completions that didn't fit into the queue are kept by the kernel until it is entered
+                    if (!(std::atomic_ref<unsigned>{*_sq_flags}.load(std::memory_order_relaxed) & IORING_SQ_CQ_OVERFLOW))
+                    {
+                        break;
+                    }
+
+                    syscall(__NR_io_uring_enter, _ring_fd, 0, 0, IORING_ENTER_GETEVENTS, nullptr, 0);
+                }
+            }
+
+            void process_completion(uint64_t user_data, int32_t result, uint32_t flags) noexcept
+            {
+                bool has_buffer = flags & IORING_CQE_F_BUFFER;
+                uint16_t buffer_id = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+
+                if (has_buffer)
+                {
+                    --_free_buffers;
+                }
+
+                auto receiver_iterator = _receivers.find(user_data);
+
+                if (user_data == cancel_user_data || receiver_iterator == _receivers.end())
+                {
+                    if (has_buffer)
+                    {
+                        recycle_buffer(buffer_id);
+                    }
+
+                    return;
+                }
+
+                detail::uring_receiver& receiver = *receiver_iterator->second;
+
+                if (has_buffer)
+                {
+                    if (result > 0 && !receiver.is_detached)
+                    {
+                        receiver.chunks.push_back({buffer_id, 0, static_cast<uint32_t>(result)});
+                    }
+                    else
+                    {
+                        recycle_buffer(buffer_id);
+                    }
+                }
+
+                if (result == 0)
+                {
+                    receiver.error = boost::asio::error::eof;
+                }
+                else if (result == -EINVAL && receiver.chunks.empty() && !receiver.error)
+                {
+                    // Multishot receive is not supported by the kernel(before Linux 6.0),
+                    // nothing is received yet, so the socket is read through the reactor from now on
+                    _is_multishot_supported = false;
+                }
+                else if (result < 0 && result != -ENOBUFS && result != -ECANCELED)
+                {
+                    receiver.error = boost::system::error_code{-result, boost::system::system_category()};
+                }
+
+                if (!(flags & IORING_CQE_F_MORE))
+                {
+                    // The operation is over, it is rearmed by the next read if there are free buffers
+                    if (receiver.is_armed)
+                    {
+                        --_armed_receivers;
+                    }
+
+                    receiver.is_armed = false;
+                    receiver.is_canceling = false;
+
+                    if (receiver.is_detached)
+                    {
+                        _receivers.erase(receiver_iterator);
+
+                        return;
+                    }
+                }
+                else if (receiver.chunks.size() >= _max_connection_buffers)
+                {
+                    // Pause the receiving of the connection until its reader takes the data,
+                    // meanwhile the data is kept in the socket and TCP flow control slows the sender down
+                    cancel(receiver);
+                }
+
+                if (receiver.waiter)
+                {
+                    receiver.waiter->cancel();
+                    receiver.waiter = nullptr;
+                }
+            }
+
+            // Block until at least one operation is completed or the deadline expires and process the completions.
+            void wait_for_completions(std::chrono::steady_clock::time_point deadline) noexcept
+            {
+                if (deadline == std::chrono::steady_clock::time_point::max())
+                {
+                    syscall(__NR_io_uring_enter, _ring_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+                }
+                else
+                {
+                    std::chrono::nanoseconds timeout = std::max(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now()),
+                        std::chrono::nanoseconds::zero());
+
+                    __kernel_timespec timeout_spec{};
+                    timeout_spec.tv_sec = timeout.count() / 1'000'000'000;
+                    timeout_spec.tv_nsec = timeout.count() % 1'000'000'000;
+
+                    io_uring_getevents_arg argument{};
+                    argument.ts = reinterpret_cast<uint64_t>(&timeout_spec);
+
+                    syscall(
+                        __NR_io_uring_enter, 
+                        _ring_fd, 
+                        0, 
+                        1, 
+                        IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, 
+                        &argument, 
+                        sizeof(argument));
+                }
+
+                process_completions();
+            }
+#else
+            void wait_for_completions(std::chrono::steady_clock::time_point) noexcept
+            {}
+#endif
+
+            // Start the receiving of the socket or return nullptr if io_uring is not available.
+            detail::uring_receiver* start_receiving(int socket)
+            {
+                if (!is_available())
+                {
+                    return nullptr;
+                }
+
+                auto receiver = std::make_unique<detail::uring_receiver>();
+
+                receiver->id = _next_receiver_id++;
+                receiver->socket = socket;
+
+                return _receivers.emplace(receiver->id, std::move(receiver)).first->second.get();
+            }
+
+            // Stop the receiving of the socket, the receiver is removed once the receive operation is completed.
+            void stop_receiving(detail::uring_receiver& receiver) noexcept
+            {
+#if defined(MULTIPART_FORM_DATA_HAS_IO_URING)
+                receiver.is_detached = true;
+                receiver.waiter = nullptr;
+
+                for (const detail::uring_chunk& chunk : receiver.chunks)
+                {
+                    recycle_buffer(chunk.buffer_id);
+                }
+
+                receiver.chunks.clear();
+
+                if (receiver.is_armed)
+                {
+                    cancel(receiver);
+                }
+                else
+                {
+                    _receivers.erase(receiver.id);
+                }
+#else
+                _receivers.erase(receiver.id);
+#endif
+            }
+
+            // Arm the receive operation if it isn't and determine how the next read has to be done.
+            detail::uring_read_state prepare_read(detail::uring_receiver& receiver) noexcept
+            {
+                if (!receiver.chunks.empty() || receiver.error)
+                {
+                    return detail::uring_read_state::ready;
+                }
+
+#if defined(MULTIPART_FORM_DATA_HAS_IO_URING)
+                if (!receiver.is_armed && _is_multishot_supported && _free_buffers != 0)
+                {
+                    arm(receiver);
+                }
+#endif
+
+                return receiver.is_armed ? detail::uring_read_state::pending : detail::uring_read_state::unarmed;
+            }
+
+            // Copy the received data to the buffer and return the taken buffers to the ring.
+            // The error is set only if there is no data left.
+            size_t take(detail::uring_receiver& receiver, boost::asio::mutable_buffer buffer, boost::system::error_code& error_code) noexcept
+            {
+                size_t copied = 0;
+
+#if defined(MULTIPART_FORM_DATA_HAS_IO_URING)
+                char* destination = static_cast<char*>(buffer.data());
+
+                while (copied < buffer.size() && !receiver.chunks.empty())
+                {
+                    detail::uring_chunk& chunk = receiver.chunks.front();
+
+                    size_t size = std::min<size_t>(chunk.size, buffer.size() - copied);
+
+                    std::memcpy(destination + copied, _buffers + chunk.buffer_id * _buffer_size + chunk.offset, size);
+
+                    copied += size;
+                    chunk.offset += static_cast<uint32_t>(size);
+                    chunk.size -= static_cast<uint32_t>(size);
+
+                    if (chunk.size == 0)
+                    {
+                        recycle_buffer(chunk.buffer_id);
+                        receiver.chunks.pop_front();
+                    }
+                }
+#else
+                static_cast<void>(buffer);
+#endif
+
+                if (copied == 0)
+                {
+                    error_code = receiver.error;
+                }
+
+                return copied;
+            }
+
+            size_t _buffers_count;
+            size_t _buffer_size;
+            size_t _max_connection_buffers;
+            std::pmr::memory_resource* _upstream;
+            std::error_code _setup_error{};
+            int _ring_fd{-1};
+            bool _is_multishot_supported{true};
+            size_t _free_buffers{0};
+            // Number of the receive operations in flight and whether the eventfd is waited for their completions
+            size_t _armed_receivers{0};
+            bool _is_waiting_for_completions{false};
+            uint64_t _next_receiver_id{cancel_user_data + 1};
+            std::unordered_map<uint64_t, std::unique_ptr<detail::uring_receiver>> _receivers{};
+
+#if defined(MULTIPART_FORM_DATA_HAS_IO_URING)
+            static constexpr unsigned submission_entries = 256;
+
+            void* _ring{nullptr};
+            size_t _ring_size{0};
+            io_uring_sqe* _sqes{nullptr};
+            size_t _sqes_size{0};
+            unsigned* _sq_head{nullptr};
+            unsigned* _sq_tail{nullptr};
+            unsigned* _sq_flags{nullptr};
+            unsigned* _sq_array{nullptr};
+            unsigned _sq_mask{0};
+            unsigned _sq_entries{0};
+            unsigned _local_sq_tail{0};
+            unsigned* _cq_head{nullptr};
+            unsigned* _cq_tail{nullptr};
+            io_uring_cqe* _cqes{nullptr};
+            unsigned _cq_mask{0};
+            // Entries of io_uring_buf_ring, its flexible array is shifted in C++, so the ring is addressed as an array
+            io_uring_buf* _buffer_ring{nullptr};
+            size_t _buffer_ring_size{0};
+            uint16_t _buffer_ring_tail{0};
+            char* _buffers{nullptr};
+            std::optional<boost::asio::posix::stream_descriptor> _eventfd{};
+#endif
+    };
+
+    // TCP stream that receives through the uring_context and sends through the asio reactor. It can be used as
+    // the stream of the downloader instead of beast::tcp_stream, which it wraps for the writes and the reads that
+    // are done through the reactor. It is the lowest layer itself, so the timeouts that are set through
+    // beast::get_lowest_layer are applied to all reads including the ones that wait for io_uring. Unlike 
+    // beast::tcp_stream, the synchronous reads time out as well: they fail with beast::error::timeout 
+    // and the stream is closed.
+    class uring_stream
+    {
+        public:
+            using executor_type = boost::beast::tcp_stream::executor_type;
+
+            /**
+             * @param context context that receives the data of the socket, it has to outlive the stream.
+             * @param socket connected socket.
+             */
+            uring_stream(uring_context& context, boost::asio::ip::tcp::socket&& socket)
+                :
+                _context{&context},
+                _stream{std::move(socket)},
+                _waiter{_stream.get_executor()}
+            {
+                _receiver = _context->start_receiving(_stream.socket().native_handle());
+            }
+
+            uring_stream(const uring_stream&) = delete;
+            uring_stream& operator=(const uring_stream&) = delete;
+
+            ~uring_stream()
+            {
+                stop_receiving();
+            }
+
+            executor_type get_executor() noexcept
+            {
+                return _stream.get_executor();
+            }
+
+            boost::asio::ip::tcp::socket& socket() noexcept
+            {
+                return _stream.socket();
+            }
+
+            // Whether the data is received through io_uring, otherwise the stream reads through the asio reactor.
+            bool is_receiving_with_uring() const noexcept
+            {
+                return _receiver != nullptr;
+            }
+
+            // Whether the next read would wait for the data that is received through io_uring. Then the reader can 
+            // release its buffer and wait for the data with wait_data or async_wait_data, because the data is received
+            // into the provided buffers. The reads through the reactor are never idle, they need the buffer to wait.
+            bool is_idle()
+            {
+                return _receiver && _context->prepare_read(*_receiver) == detail::uring_read_state::pending;
+            }
+
+            // Wait until the data or the error is received without the buffer of the reader. The wait expires 
+            // at the expiry of the reads, then it fails with beast::error::timeout and the stream is closed.
+            void wait_data(boost::system::error_code& error_code)
+            {
+                error_code = {};
+
+                while (is_idle())
+                {
+                    if (std::chrono::steady_clock::now() >= _deadline)
+                    {
+                        close();
+                        error_code = boost::beast::error::timeout;
+
+                        return;
+                    }
+
+                    _context->wait_for_completions(_deadline);
+                }
+            }
+
+            template<typename token_t>
+            auto async_wait_data(token_t&& token)
+            {
+                return boost::asio::async_compose<token_t, void(boost::system::error_code)>(
+                    wait_data_operation{*this},
+                    token,
+                    _stream);
+            }
+
+            void expires_after(std::chrono::steady_clock::duration expiry_time)
+            {
+                _stream.expires_after(expiry_time);
+                _deadline = std::chrono::steady_clock::now() + expiry_time;
+            }
+
+            void expires_at(std::chrono::steady_clock::time_point expiry_time)
+            {
+                _stream.expires_at(expiry_time);
+                _deadline = expiry_time;
+            }
+
+            void expires_never()
+            {
+                _stream.expires_never();
+                _deadline = std::chrono::steady_clock::time_point::max();
+            }
+
+            // Stop the receiving and close the socket, the pending read is completed with operation_aborted.
+            void close()
+            {
+                stop_receiving();
+                _waiter.cancel();
+                _stream.close();
+            }
+
+            template<typename mutable_buffers_t>
+            size_t read_some(const mutable_buffers_t& buffers)
+            {
+                boost::system::error_code error_code;
+
+                size_t bytes_transferred = read_some(buffers, error_code);
+
+                if (error_code)
+                {
+                    throw boost::system::system_error{error_code};
+                }
+
+                return bytes_transferred;
+            }
+
+            template<typename mutable_buffers_t>
+            size_t read_some(const mutable_buffers_t& buffers, boost::system::error_code& error_code)
+            {
+                error_code = {};
+
+                if (!_receiver)
+                {
+                    return wait_readable(error_code) ? _stream.read_some(buffers, error_code) : 0;
+                }
+
+                boost::asio::mutable_buffer buffer = first_buffer(buffers);
+
+                if (buffer.size() == 0)
+                {
+                    return 0;
+                }
+
+                for (;;)
+                {
+                    switch (_context->prepare_read(*_receiver))
+                    {
+                        case detail::uring_read_state::ready:
+                            return _context->take(*_receiver, buffer, error_code);
+                        case detail::uring_read_state::pending:
+                            if (std::chrono::steady_clock::now() >= _deadline)
+                            {
+                                close();
+                                error_code = boost::beast::error::timeout;
+
+                                return 0;
+                            }
+
+                            _context->wait_for_completions(_deadline);
+                            break;
+                        case detail::uring_read_state::unarmed:
+                            return wait_readable(error_code) ? _stream.read_some(buffer, error_code) : 0;
+                    }
+                }
+            }
+
+            template<typename mutable_buffers_t, typename token_t>
+            auto async_read_some(const mutable_buffers_t& buffers, token_t&& token)
+            {
+                return boost::asio::async_compose<token_t, void(boost::system::error_code, size_t)>(
+                    read_some_operation{*this, first_buffer(buffers)},
+                    token,
+                    _stream);
+            }
+
+            template<typename const_buffers_t>
+            size_t write_some(const const_buffers_t& buffers)
+            {
+                return _stream.write_some(buffers);
+            }
+
+            template<typename const_buffers_t>
+            size_t write_some(const const_buffers_t& buffers, boost::system::error_code& error_code)
+            {
+                return _stream.write_some(buffers, error_code);
+            }
+
+            template<typename const_buffers_t, typename token_t>
+            auto async_write_some(const const_buffers_t& buffers, token_t&& token)
+            {
+                return _stream.async_write_some(buffers, std::forward<token_t>(token));
+            }
+
+        private:
+            // Asynchronous read that takes the received data, waits for it or reads the socket through the reactor.
+            struct read_some_operation
+            {
+                enum class state
+                {
+                    starting,
+                    waiting,
+                    taking,
+                    reading_socket
+                };
+
+                uring_stream& stream;
+                boost::asio::mutable_buffer buffer;
+                state current_state{state::starting};
+
+                template<typename self_t>
+                void operator()(self_t& self, boost::system::error_code error_code = {}, size_t bytes_transferred = 0)
+                {
+                    switch (current_state)
+                    {
+                        case state::starting:
+                            return start(self);
+                        case state::waiting:
+                            if (!stream._receiver)
+                            {
+                                return self.complete(boost::asio::error::operation_aborted, 0);
+                            }
+
+                            // The timer expired rather than was canceled by the context
+                            if (!error_code)
+                            {
+                                stream.close();
+
+                                return self.complete(boost::beast::error::timeout, 0);
+                            }
+
+                            return start(self);
+                        case state::taking:
+                            if (!stream._receiver)
+                            {
+                                return self.complete(boost::asio::error::operation_aborted, 0);
+                            }
+
+                            bytes_transferred = stream._context->take(*stream._receiver, buffer, error_code);
+
+                            return self.complete(error_code, bytes_transferred);
+                        case state::reading_socket:
+                            return self.complete(error_code, bytes_transferred);
+                    }
+                }
+
+                template<typename self_t>
+                void start(self_t& self)
+                {
+                    if (!stream._receiver || buffer.size() == 0)
+                    {
+                        current_state = state::reading_socket;
+
+                        return stream._stream.async_read_some(buffer, std::move(self));
+                    }
+
+                    switch (stream._context->prepare_read(*stream._receiver))
+                    {
+                        case detail::uring_read_state::ready:
+                            // Complete through the executor rather than inside of the initiating function
+                            current_state = state::taking;
+
+                            return boost::asio::post(std::move(self));
+                        case detail::uring_read_state::pending:
+                            current_state = state::waiting;
+                            stream._receiver->waiter = &stream._waiter;
+                            stream._waiter.expires_at(stream._deadline);
+
+                            return stream._waiter.async_wait(std::move(self));
+                        case detail::uring_read_state::unarmed:
+                            current_state = state::reading_socket;
+
+                            return stream._stream.async_read_some(buffer, std::move(self));
+                    }
+                }
+            };
+
+            // Asynchronous wait for the data that doesn't hold a buffer, it completes through the executor.
+            struct wait_data_operation
+            {
+                enum class state
+                {
+                    starting,
+                    waiting,
+                    completing
+                };
+
+                uring_stream& stream;
+                state current_state{state::starting};
+
+                template<typename self_t>
+                void operator()(self_t& self, boost::system::error_code error_code = {})
+                {
+                    switch (current_state)
+                    {
+                        case state::starting:
+                            break;
+                        case state::waiting:
+                            if (!stream._receiver)
+                            {
+                                return self.complete(boost::asio::error::operation_aborted);
+                            }
+
+                            // The timer expired rather than was canceled by the context
+                            if (!error_code)
+                            {
+                                stream.close();
+
+                                return self.complete(boost::beast::error::timeout);
+                            }
+
+                            break;
+                        case state::completing:
+                            return self.complete(error_code);
+                    }
+
+                    if (stream.is_idle())
+                    {
+                        current_state = state::waiting;
+                        stream._receiver->waiter = &stream._waiter;
+                        stream._waiter.expires_at(stream._deadline);
+
+                        return stream._waiter.async_wait(std::move(self));
+                    }
+
+                    if (current_state == state::waiting)
+                    {
+                        return self.complete(boost::system::error_code{});
+                    }
+
+                    // Complete through the executor rather than inside of the initiating function
+                    current_state = state::completing;
+
+                    return boost::asio::post(std::move(self));
+                }
+            };
+
+            template<typename mutable_buffers_t>
+            static boost::asio::mutable_buffer first_buffer(const mutable_buffers_t& buffers) noexcept
+            {
+                for (auto iterator = boost::asio::buffer_sequence_begin(buffers);
+                    iterator != boost::asio::buffer_sequence_end(buffers);
+                    ++iterator)
+                {
+                    boost::asio::mutable_buffer buffer{*iterator};
+
+                    if (buffer.size() != 0)
+                    {
+                        return buffer;
+                    }
+                }
+
+                return boost::asio::mutable_buffer{};
+            }
+
+            // Wait until the socket is readable before the synchronous read through the reactor, which doesn't
+            // time out by itself. Return false if the deadline expires, then the stream is closed.
+            bool wait_readable(boost::system::error_code& error_code)
+            {
+#if defined(__unix__)
+                while (_deadline != std::chrono::steady_clock::time_point::max())
+                {
+                    std::chrono::milliseconds timeout = std::chrono::ceil<std::chrono::milliseconds>(
+                        _deadline - std::chrono::steady_clock::now());
+
+                    if (timeout.count() <= 0)
+                    {
+                        close();
+                        error_code = boost::beast::error::timeout;
+
+                        return false;
+                    }
+
+                    pollfd socket_events{.fd = _stream.socket().native_handle(), .events = POLLIN, .revents = 0};
+
+                    int result = ::poll(
+                        &socket_events, 
+                        1, 
+                        static_cast<int>(std::min<int64_t>(timeout.count(), std::numeric_limits<int>::max())));
+
+                    if (result > 0 || (result < 0 && errno != EINTR))
+                    {
+                        break;
+                    }
+                }
+#else
+                static_cast<void>(error_code);
+#endif
+
+                return true;
+            }
+
+            void stop_receiving() noexcept
+            {
+                if (_receiver)
+                {
+                    _context->stop_receiving(*_receiver);
+                    _receiver = nullptr;
+                }
+            }
+
+            uring_context* _context;
+            boost::beast::tcp_stream _stream;
+            // Timer that the reads wait on for the received data, it is canceled by the context when the data arrives
+            boost::asio::steady_timer _waiter;
+            std::chrono::steady_clock::time_point _deadline{std::chrono::steady_clock::time_point::max()};
+            detail::uring_receiver* _receiver{nullptr};
+    };
+}
+
+#endif
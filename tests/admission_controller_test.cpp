@@ -0,0 +1,40 @@
+#include <multipart_form_data/admission_controller.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+// The controller that rejected the new downloads because of the write latency has to admit them again after the writes
+// are over, otherwise the server that rejects everything never writes and stays rejecting until it is restarted.
+int main()
+{
+    multipart_form_data::admission_controller admission_control{
+        multipart_form_data::admission_thresholds{
+            .write_latency_target = std::chrono::milliseconds(50),
+            .sample_interval = std::chrono::milliseconds(100)}};
+
+    for (size_t i = 0; i < 40; ++i)
+    {
+        admission_control.record_write_latency(std::chrono::milliseconds(400));
+    }
+
+    if (admission_control.admit())
+    {
+        std::cerr << "the download is admitted with the write latency " << admission_control.write_latency().count() << "ns\n";
+
+        return 1;
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    if (!admission_control.admit())
+    {
+        std::cerr
+            << "the download is rejected after the idle period with the write latency "
+            << admission_control.write_latency().count() << "ns and the pressure " << admission_control.pressure() << "\n";
+
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,150 @@
+#include <allocation_counting.hpp>
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Replacement functions of global operator new and operator delete. They are defined in their own translation unit,
+// so the compiler doesn't see that the memory of operator new is freed with std::free at the call sites. Each form
+// of operator new has the matching form of operator delete, the aligned memory is allocated with std::aligned_alloc,
+// so all of them are freed with std::free.
+namespace
+{
+    thread_local uint64_t thread_allocations{0};
+
+    void* allocate(std::size_t size) noexcept
+    {
+        ++thread_allocations;
+
+        return std::malloc(size == 0 ? 1 : size);
+    }
+
+    void* allocate(std::size_t size, std::align_val_t alignment) noexcept
+    {
+        ++thread_allocations;
+
+        std::size_t alignment_size = static_cast<std::size_t>(alignment);
+        // The size of std::aligned_alloc has to be a multiple of the alignment
+        std::size_t rounded_size = (size + alignment_size - 1) & ~(alignment_size - 1);
+
+        return std::aligned_alloc(alignment_size, rounded_size == 0 ? alignment_size : rounded_size);
+    }
+}
+
+namespace allocation_counting
+{
+    uint64_t thread_allocations_count() noexcept
+    {
+        return thread_allocations;
+    }
+}
+
+void* operator new(std::size_t size)
+{
+    if (void* pointer = allocate(size))
+    {
+        return pointer;
+    }
+
+    throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    if (void* pointer = allocate(size, alignment))
+    {
+        return pointer;
+    }
+
+    throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocate(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocate(size, alignment);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    std::free(pointer);
+}
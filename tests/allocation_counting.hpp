@@ -0,0 +1,14 @@
+#ifndef ALLOCATION_COUNTING_HPP
+#define ALLOCATION_COUNTING_HPP
+
+#include <cstdint>
+
+// Counting of heap allocations of the current thread. It is made by the replacement of global operator new
+// in allocation_counting.cpp, so only the tests that are linked with it count allocations.
+namespace allocation_counting
+{
+    // Number of allocations made by the current thread since it is started.
+    uint64_t thread_allocations_count() noexcept;
+}
+
+#endif
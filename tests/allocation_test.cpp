@@ -0,0 +1,340 @@
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/version.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <multipart_form_data/multipart_form_data.hpp>
+
+#include <allocation_counting.hpp>
+#include <memory_stream.hpp>
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+
+// Observer of the reads that records the number of allocations that the reading thread made since the previous read,
+// i.e. while the data that was served before the read was processed, along with the number of those bytes.
+class allocation_recorder
+{
+    public:
+        struct read_record
+        {
+            size_t served_size;
+            uint64_t allocations;
+        };
+
+        explicit allocation_recorder(size_t reads_capacity)
+        {
+            // The vector doesn't grow while the packets are read, so the test itself doesn't allocate
+            _reads.reserve(reads_capacity);
+        }
+
+        const std::vector<read_record>& reads() const noexcept
+        {
+            return _reads;
+        }
+
+        void operator()(size_t served_size) noexcept
+        {
+            uint64_t allocations_count = allocation_counting::thread_allocations_count();
+
+            if (_reads.size() < _reads.capacity())
+            {
+                _reads.push_back({served_size, allocations_count - _allocations_count});
+            }
+
+            _allocations_count = allocations_count;
+        }
+
+    private:
+        uint64_t _allocations_count{0};
+        std::vector<read_record> _reads{};
+};
+
+using memory_stream = memory_streaming::memory_stream<allocation_recorder>;
+
+constexpr size_t parts_count = 4;
+constexpr size_t file_size = 8 * 1024 * 1024;
+constexpr size_t packets_size = 256 * 1024;
+constexpr size_t read_size = 64 * 1024;
+// Allocations of the transition from one part to the next: the file of the previous part is closed, and the path 
+// of the next one is made and its file is opened. It takes 9-13 allocations with libstdc++.
+constexpr uint64_t max_part_allocations = 16;
+
+// Request body of several files along with the ranges of the delimiters and the part headers between them.
+struct multipart_body
+{
+    std::string data{};
+    std::vector<std::pair<size_t, size_t>> transitions{};
+};
+
+multipart_body make_body(size_t file_size = ::file_size)
+{
+    multipart_body body;
+
+    for (size_t part = 0; part < parts_count; ++part)
+    {
+        size_t transition_start = body.data.size();
+
+        body.data += part == 0 ? "" : "\r\n";
+        body.data +=
+            "------boundary\r\n"
+            "Content-Disposition: form-data; name=\"file\"; filename=\"file" + std::to_string(part) + ".bin\"\r\n"
+            "Content-Type: application/octet-stream\r\n\r\n";
+
+        body.transitions.emplace_back(transition_start, body.data.size());
+
+        for (size_t i = 0; i < file_size; ++i)
+        {
+            body.data += static_cast<char>('a' + i % 26);
+        }
+    }
+
+    body.transitions.emplace_back(body.data.size(), body.data.size() + 20);
+    body.data += "\r\n------boundary--\r\n";
+
+    return body;
+}
+
+// Download the files of the request body with the sync or the async downloader and check that the reads of the packets
+// after the first ones don't allocate, and that the transition to each next part allocates a bounded number of times.
+bool check_download(bool is_async)
+{
+    // Reads of the first packets that open the file and grow the buffer up to the packets size
+    constexpr size_t warm_up_size = 8 * packets_size;
+
+    multipart_body body = make_body();
+
+    std::filesystem::path output_directory = std::filesystem::temp_directory_path() / "multipart_form_data_allocation_test";
+    std::filesystem::create_directories(output_directory);
+
+    asio::io_context io_context;
+    memory_stream stream{
+        io_context, 
+        body.data, 
+        read_size, 
+        memory_streaming::data_end::eof, 
+        allocation_recorder{body.data.size() / read_size + 16 * parts_count}};
+    beast::flat_buffer buffer;
+    multipart_form_data::downloader<memory_stream, beast::flat_buffer> form_data{stream, buffer};
+    beast::error_code error_code;
+    std::vector<std::filesystem::path> file_paths;
+
+    if (is_async)
+    {
+        form_data.async_download(
+            "multipart/form-data; boundary=----boundary",
+            {
+                .packets_size = packets_size,
+                .output_directory = output_directory
+            },
+            [&error_code, &file_paths](beast::error_code result, std::vector<std::filesystem::path>&& downloaded_paths)
+            {
+                error_code = result;
+                file_paths = std::move(downloaded_paths);
+            },
+            std::make_shared<int>(0));
+
+        io_context.run();
+    }
+    else
+    {
+        file_paths = form_data.sync_download(
+            "multipart/form-data; boundary=----boundary",
+            {
+                .packets_size = packets_size,
+                .output_directory = output_directory
+            },
+            error_code);
+    }
+
+    // The allocations of closing the last file are recorded as the ones of the read after the terminating boundary
+    stream.observer()(body.data.size());
+
+    std::filesystem::remove_all(output_directory);
+
+    const char* mode = is_async ? "async" : "sync";
+
+    if (error_code || file_paths.size() != parts_count)
+    {
+        std::cerr << mode << ": the download failed: " << error_code.message() << "\n";
+
+        return false;
+    }
+
+    const std::vector<allocation_recorder::read_record>& reads = stream.observer().reads();
+    std::vector<uint64_t> part_allocations(body.transitions.size(), 0);
+    bool is_passed = true;
+
+    for (size_t i = 0; i < reads.size(); ++i)
+    {
+        if (reads[i].served_size < body.transitions.front().second + warm_up_size)
+        {
+            continue;
+        }
+
+        // The transition is processed once its delimiter and part header are served, at the latest by the next read
+        auto transition = std::find_if(
+            body.transitions.begin(), 
+            body.transitions.end(),
+            [&reads, i](const std::pair<size_t, size_t>& range)
+            {
+                return reads[i].served_size > range.first && reads[i].served_size <= range.second + read_size;
+            });
+
+        if (transition != body.transitions.end())
+        {
+            part_allocations[transition - body.transitions.begin()] += reads[i].allocations;
+        }
+        else if (reads[i].allocations != 0)
+        {
+            std::cerr 
+                << mode << ": read " << i << " of " << reads.size() << " at " << reads[i].served_size << " bytes: " 
+                << reads[i].allocations << " allocations\n";
+
+            is_passed = false;
+        }
+    }
+
+    for (size_t part = 1; part < part_allocations.size(); ++part)
+    {
+        if (part_allocations[part] > max_part_allocations)
+        {
+            std::cerr 
+                << mode << ": transition " << part << ": " << part_allocations[part] << " allocations, "
+                << max_part_allocations << " at most are expected\n";
+
+            is_passed = false;
+        }
+    }
+
+    return is_passed;
+}
+
+// Download the request body from the loopback connection by beast::tcp_stream with the timer of operations_timeout 
+// and return the number of allocations of the thread of the io_context, or nothing if the download fails.
+std::optional<uint64_t> count_tcp_stream_allocations(const std::string& body, bool is_strand)
+{
+    std::filesystem::path output_directory = std::filesystem::temp_directory_path() / "multipart_form_data_allocation_test";
+    std::filesystem::create_directories(output_directory);
+
+    asio::io_context io_context;
+    asio::ip::tcp::acceptor acceptor{io_context, asio::ip::tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}};
+    asio::ip::tcp::socket client{io_context};
+
+    client.connect(acceptor.local_endpoint());
+
+    beast::tcp_stream stream = is_strand 
+        ? beast::tcp_stream{acceptor.accept(asio::make_strand(io_context))}
+        : beast::tcp_stream{acceptor.accept()};
+
+    std::thread sending_thread{
+        [&client, &body]()
+        {
+            beast::error_code error_code;
+
+            asio::write(client, asio::buffer(body), error_code);
+        }};
+
+    beast::flat_buffer buffer;
+    multipart_form_data::downloader<beast::tcp_stream, beast::flat_buffer> form_data{stream, buffer};
+    beast::error_code error_code;
+    size_t files_count = 0;
+
+    uint64_t start_allocations_count = allocation_counting::thread_allocations_count();
+
+    form_data.async_download(
+        "multipart/form-data; boundary=----boundary",
+        {
+            .packets_size = packets_size,
+            .operations_timeout = std::chrono::seconds(30),
+            .output_directory = output_directory
+        },
+        [&error_code, &files_count](beast::error_code result, std::vector<std::filesystem::path>&& downloaded_paths)
+        {
+            error_code = result;
+            files_count = downloaded_paths.size();
+        },
+        std::make_shared<int>(0));
+
+    io_context.run();
+
+    uint64_t allocations_count = allocation_counting::thread_allocations_count() - start_allocations_count;
+
+    sending_thread.join();
+    std::filesystem::remove_all(output_directory);
+
+    if (error_code || files_count != parts_count)
+    {
+        std::cerr << "tcp_stream: the download failed: " << error_code.message() << "\n";
+
+        return std::nullopt;
+    }
+
+    return allocations_count;
+}
+
+// The timer of beast::tcp_stream is started and canceled for each read, so it is checked apart from the memory stream 
+// that doesn't expire. The reads of the loopback connection are of any size, so the allocations are compared between 
+// the bodies of the same parts but of the different number of packets: they must not grow with the packets.
+bool check_tcp_stream_download(bool is_strand)
+{
+    const char* mode = is_strand ? "tcp_stream on strand" : "tcp_stream";
+
+#if BOOST_VERSION <= 107400
+    // beast's stream timer copies the strand executor to the heap for each operation on Boost 1.74, 
+    // it is outside of the downloader
+    if (is_strand)
+    {
+        std::cerr << mode << ": skipped, the timer allocates for each operation on Boost 1.74 and older\n";
+
+        return true;
+    }
+#endif
+
+    std::optional<uint64_t> small_allocations_count = count_tcp_stream_allocations(make_body(file_size / 4).data, is_strand);
+    std::optional<uint64_t> large_allocations_count = count_tcp_stream_allocations(make_body(file_size).data, is_strand);
+
+    if (!small_allocations_count || !large_allocations_count)
+    {
+        return false;
+    }
+
+    if (*large_allocations_count > *small_allocations_count + parts_count)
+    {
+        std::cerr 
+            << mode << ": " << *large_allocations_count << " allocations for " << file_size << " bytes files, " 
+            << *small_allocations_count << " for " << file_size / 4 << " bytes ones\n";
+
+        return false;
+    }
+
+    return true;
+}
+
+// Once the buffer has grown to the packets size, reading and writing of the packets of the file body must not allocate
+// at all and each next part allocates a bounded number of times, so the cost of the download doesn't depend 
+// on the number of packets.
+int main()
+{
+    bool is_sync_passed = check_download(false);
+    bool is_async_passed = check_download(true);
+    bool is_tcp_stream_passed = check_tcp_stream_download(false);
+    bool is_strand_passed = check_tcp_stream_download(true);
+
+    return is_sync_passed && is_async_passed && is_tcp_stream_passed && is_strand_passed ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/beast/core.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <multipart_form_data/multipart_form_data.hpp>
+
+#include <memory_stream.hpp>
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+
+// Observer of the reads that records the number of the published downloads at the first read.
+class registry_observer
+{
+    public:
+        explicit registry_observer(const multipart_form_data::download_registry& registry)
+            : _registry{&registry}
+        {}
+
+        std::optional<size_t> published_downloads() const noexcept
+        {
+            return _published_downloads;
+        }
+
+        void operator()() noexcept
+        {
+            if (!_published_downloads)
+            {
+                _published_downloads = _registry->size();
+            }
+        }
+
+    private:
+        const multipart_form_data::download_registry* _registry;
+        std::optional<size_t> _published_downloads{};
+};
+
+using rest_stream = memory_streaming::memory_stream<registry_observer>;
+
+// The request body that is read along with the request header up to the final "--" but without the line break after it
+// is not over yet, so it has to be downloaded as usual with its state published.
+int main()
+{
+    std::string body =
+        "------boundary\r\n"
+        "Content-Disposition: form-data; name=\"file\"; filename=\"file.txt\"\r\n"
+        "Content-Type: text/plain\r\n\r\n"
+        "text\r\n"
+        "------boundary--";
+    std::string rest = "\r\n";
+
+    std::filesystem::path output_directory = std::filesystem::temp_directory_path() / "multipart_form_data_buffered_body_test";
+    std::filesystem::create_directories(output_directory);
+
+    asio::io_context io_context;
+    multipart_form_data::download_registry registry;
+    rest_stream stream{
+        io_context, rest, std::numeric_limits<size_t>::max(), memory_streaming::data_end::eof, registry_observer{registry}};
+    beast::flat_buffer buffer;
+    buffer.commit(asio::buffer_copy(buffer.prepare(body.size()), asio::buffer(body)));
+    multipart_form_data::downloader<rest_stream, beast::flat_buffer> form_data{stream, buffer};
+    beast::error_code error_code;
+
+    std::vector<std::filesystem::path> file_paths = form_data.sync_download(
+        "multipart/form-data; boundary=----boundary",
+        {
+            .output_directory = output_directory,
+            .active_downloads = &registry
+        },
+        error_code);
+
+    std::filesystem::remove_all(output_directory);
+
+    if (error_code || file_paths.size() != 1)
+    {
+        std::cerr << "the download failed: " << error_code.message() << "\n";
+
+        return 1;
+    }
+
+    if (stream.observer().published_downloads() != 1)
+    {
+        std::cerr << "the download isn't published while the rest of the request body is read\n";
+
+        return 1;
+    }
+
+    return 0;
+}
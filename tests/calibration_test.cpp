@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <system_error>
+
+#include <multipart_form_data/calibration.hpp>
+
+constexpr size_t benchmark_size = 1024 * 1024;
+
+// Whether the packets size is one of the candidates of the benchmark.
+bool is_candidate(size_t packets_size)
+{
+    return std::find(
+        multipart_form_data::detail::calibration_packets_sizes.begin(),
+        multipart_form_data::detail::calibration_packets_sizes.end(),
+        packets_size) != multipart_form_data::detail::calibration_packets_sizes.end();
+}
+
+// The cache has to be kept outside of the output directory and by the host and the device, the planted packets size
+// has to be rejected, and the benchmark must not leave any file in the output directory.
+int main()
+{
+    std::filesystem::path root = std::filesystem::temp_directory_path() / "multipart_form_data_calibration_test";
+    std::filesystem::path output_directory = root / "output";
+    std::filesystem::path cache_path = root / "cache";
+
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(output_directory);
+
+    std::string key = multipart_form_data::detail::calibration_cache_key(output_directory);
+
+    auto finish =
+        [&root](int result)
+        {
+            std::filesystem::remove_all(root);
+
+            return result;
+        };
+
+    std::error_code error_code;
+
+    multipart_form_data::calibrate(output_directory, output_directory / "cache", error_code, benchmark_size);
+
+    if (error_code != std::errc::invalid_argument)
+    {
+        std::cerr << "the cache in the output directory is accepted\n";
+
+        return finish(1);
+    }
+
+    // The entry of another host is kept along with the one of this host
+    {
+        std::ofstream cache_file{cache_path};
+
+        cache_file << "version 2\n" << "other-host 1 16777216 1 1\n";
+    }
+
+    error_code.clear();
+
+    multipart_form_data::calibration result = multipart_form_data::calibrate(output_directory, cache_path, error_code, benchmark_size);
+
+    if (error_code || result.is_cached || !is_candidate(result.packets_size))
+    {
+        std::cerr << "the first calibration is " << result.packets_size << " bytes: " << error_code.message() << "\n";
+
+        return finish(1);
+    }
+
+    if (!std::filesystem::is_empty(output_directory))
+    {
+        std::cerr << "the benchmark left a file in the output directory\n";
+
+        return finish(1);
+    }
+
+    result = multipart_form_data::calibrate(output_directory, cache_path, error_code, benchmark_size);
+
+    if (error_code || !result.is_cached)
+    {
+        std::cerr << "the calibration isn't loaded from the cache\n";
+
+        return finish(1);
+    }
+
+    {
+        std::ifstream cache_file{cache_path};
+        std::string content{std::istreambuf_iterator<char>{cache_file}, std::istreambuf_iterator<char>{}};
+
+        if (content.find("other-host 1 16777216 1 1\n") == std::string::npos)
+        {
+            std::cerr << "the entry of another host is lost\n";
+
+            return finish(1);
+        }
+    }
+
+    // The planted packets size of many gigabytes is rejected and the benchmark is run again
+    {
+        std::ofstream cache_file{cache_path};
+
+        cache_file << "version 2\n" << key << " 8589934592 1 1\n";
+    }
+
+    result = multipart_form_data::calibrate(output_directory, cache_path, error_code, benchmark_size);
+
+    if (error_code || result.is_cached || !is_candidate(result.packets_size))
+    {
+        std::cerr << "the planted packets size of " << result.packets_size << " bytes is used\n";
+
+        return finish(1);
+    }
+
+    // A file of the output directory with the name of the benchmark file is not overwritten
+    {
+        std::ofstream uploaded_file{output_directory / ".multipart_form_data_calibration.tmp"};
+
+        uploaded_file << "upload";
+    }
+
+    result = multipart_form_data::calibrate(output_directory, {}, error_code, benchmark_size);
+
+    std::ifstream uploaded_file{output_directory / ".multipart_form_data_calibration.tmp"};
+    std::string uploaded_content;
+
+    uploaded_file >> uploaded_content;
+
+    if (error_code || uploaded_content != "upload")
+    {
+        std::cerr << "the file of the output directory is overwritten by the benchmark\n";
+
+        return finish(1);
+    }
+
+    // The real reason of the failure to open the benchmark file is reported
+    result = multipart_form_data::calibrate(root / "missing", {}, error_code, benchmark_size);
+
+    if (error_code != std::errc::no_such_file_or_directory)
+    {
+        std::cerr << "the failure to open the benchmark file is reported as \"" << error_code.message() << "\"\n";
+
+        return finish(1);
+    }
+
+    return finish(0);
+}
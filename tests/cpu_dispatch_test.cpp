@@ -0,0 +1,158 @@
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <multipart_form_data/cpu_dispatch.hpp>
+
+// Search kernel along with its name to report the mismatch.
+struct named_kernel
+{
+    multipart_form_data::detail::find_kernel kernel;
+    std::string_view name;
+};
+
+// All kernels that the CPU supports, the ones that it doesn't support are skipped.
+std::vector<named_kernel> supported_kernels()
+{
+    std::vector<named_kernel> kernels{{multipart_form_data::detail::find_generic, "generic"}};
+
+#if defined(MULTIPART_FORM_DATA_X86_DISPATCH)
+    const multipart_form_data::cpu_features& features = multipart_form_data::detected_cpu_features();
+
+    if (features.avx2)
+    {
+        kernels.push_back({multipart_form_data::detail::find_avx2, "avx2"});
+    }
+    else
+    {
+        std::cerr << "avx2 is not supported by the CPU, its kernel is skipped\n";
+    }
+
+    if (features.avx512bw)
+    {
+        kernels.push_back({multipart_form_data::detail::find_avx512bw, "avx512bw"});
+    }
+    else
+    {
+        std::cerr << "avx512bw is not supported by the CPU, its kernel is skipped\n";
+    }
+#endif
+
+    return kernels;
+}
+
+// Compare the result of the kernel with the one of std::string_view::find.
+bool check(const named_kernel& kernel, std::string_view data, std::string_view pattern)
+{
+    size_t expected = data.find(pattern);
+    size_t result = kernel.kernel(data.data(), data.size(), pattern.data(), pattern.size());
+
+    if (result == expected)
+    {
+        return true;
+    }
+
+    std::cerr
+        << kernel.name << ": the pattern of " << pattern.size() << " bytes in the data of " << data.size()
+        << " bytes is found at " << static_cast<int64_t>(result) << " instead of " << static_cast<int64_t>(expected) << "\n";
+
+    return false;
+}
+
+// Every kernel has to find the same first occurrence as std::string_view::find. The data is made of a few distinct bytes,
+// so there are a lot of positions where only the first and the last bytes of the pattern match. The pattern is planted
+// at each position of the data of each size around two blocks of the widest kernel, so the occurrences straddle the blocks
+// of 32 and 64 bytes and lie in the tails that are searched by the narrower kernels.
+int main()
+{
+    constexpr size_t max_size = 3 * 2 * 64 + 8;
+
+    std::vector<named_kernel> kernels = supported_kernels();
+    std::mt19937 random{12345};
+    std::uniform_int_distribution<int> byte_distribution{0, 3};
+    constexpr std::string_view alphabet = "-\r\nb";
+
+    auto random_string =
+        [&](size_t size)
+        {
+            std::string result(size, ' ');
+
+            for (char& byte : result)
+            {
+                byte = alphabet[byte_distribution(random)];
+            }
+
+            return result;
+        };
+
+    // The storage is wider than the data, so the data starts at the different alignments
+    std::string storage = random_string(max_size + 64);
+
+    for (size_t pattern_size : {1, 2, 3, 4, 5, 8, 16, 31, 33, 40, 65, 70})
+    {
+        std::string pattern = random_string(pattern_size);
+
+        // The first and the last bytes of the pattern differ from the background, so each candidate is checked fully
+        pattern.front() = 'x';
+        pattern.back() = 'y';
+
+        for (size_t size = 0; size <= max_size; ++size)
+        {
+            size_t offset = size % 64;
+            std::string_view data{storage.data() + offset, size};
+
+            for (const named_kernel& kernel : kernels)
+            {
+                if (!check(kernel, data, pattern))
+                {
+                    return 1;
+                }
+            }
+
+            for (size_t position = 0; position + pattern_size <= size; ++position)
+            {
+                std::string planted{data};
+
+                planted.replace(position, pattern_size, pattern);
+
+                // The decoy differs in the middle byte only, so it is found by the first and the last bytes
+                if (pattern_size > 2 && position > pattern_size)
+                {
+                    std::string decoy = pattern;
+
+                    decoy[pattern_size / 2] = decoy[pattern_size / 2] == '-' ? 'b' : '-';
+                    planted.replace(position - pattern_size, pattern_size, decoy);
+                }
+
+                for (const named_kernel& kernel : kernels)
+                {
+                    if (!check(kernel, planted, pattern))
+                    {
+                        return 1;
+                    }
+                }
+            }
+        }
+    }
+
+    // Patterns of the same bytes as the data have many occurrences, so the first one is the nontrivial part
+    for (size_t iteration = 0; iteration < 20000; ++iteration)
+    {
+        std::string data = random_string(random() % (max_size + 1));
+        std::string pattern = random_string(1 + random() % 6);
+
+        for (const named_kernel& kernel : kernels)
+        {
+            if (!check(kernel, data, pattern))
+            {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/beast/core.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <multipart_form_data/multipart_form_data.hpp>
+
+#include <memory_stream.hpp>
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+
+using memory_stream = memory_streaming::memory_stream<>;
+
+// Download the request body of one file with the sync or the async downloader while the budget has one slot
+// and return the result.
+beast::error_code download(bool is_async, multipart_form_data::descriptor_budget& budget, std::chrono::steady_clock::duration timeout)
+{
+    std::string body =
+        "------boundary\r\n"
+        "Content-Disposition: form-data; name=\"file\"; filename=\"file.txt\"\r\n"
+        "Content-Type: text/plain\r\n\r\n"
+        "text\r\n"
+        "------boundary--\r\n";
+
+    std::filesystem::path output_directory = std::filesystem::temp_directory_path() / "multipart_form_data_descriptor_budget_test";
+    std::filesystem::create_directories(output_directory);
+
+    asio::io_context io_context;
+    memory_stream stream{io_context, body};
+    beast::flat_buffer buffer;
+    multipart_form_data::downloader<memory_stream, beast::flat_buffer> form_data{stream, buffer};
+    beast::error_code error_code;
+
+    if (is_async)
+    {
+        form_data.async_download(
+            "multipart/form-data; boundary=----boundary",
+            {
+                .operations_timeout = timeout,
+                .output_directory = output_directory,
+                .file_descriptors = &budget
+            },
+            [&error_code](beast::error_code result, std::vector<std::filesystem::path>&&)
+            {
+                error_code = result;
+            },
+            std::make_shared<int>(0));
+
+        io_context.run();
+    }
+    else
+    {
+        form_data.sync_download(
+            "multipart/form-data; boundary=----boundary",
+            {
+                .operations_timeout = timeout,
+                .output_directory = output_directory,
+                .file_descriptors = &budget
+            },
+            error_code);
+    }
+
+    std::filesystem::remove_all(output_directory);
+
+    return error_code;
+}
+
+// The download that waits behind the holder of the only slot has to fail with descriptor_wait_timeout once
+// operations_timeout expires and leave the queue, and it has to succeed if the slot is returned in time.
+bool check_download(bool is_async)
+{
+    const char* mode = is_async ? "async" : "sync";
+
+    multipart_form_data::descriptor_budget budget{1};
+    multipart_form_data::descriptor_budget::waiter holder;
+
+    budget.acquire(holder);
+
+    auto start = std::chrono::steady_clock::now();
+
+    beast::error_code error_code = download(is_async, budget, std::chrono::milliseconds(200));
+
+    if (error_code != multipart_form_data::error::descriptor_wait_timeout)
+    {
+        std::cerr << mode << ": the download behind the stalled holder finished with \"" << error_code.message() << "\"\n";
+
+        return false;
+    }
+
+    if (std::chrono::steady_clock::now() - start > std::chrono::seconds(5))
+    {
+        std::cerr << mode << ": the waiting timed out too late\n";
+
+        return false;
+    }
+
+    if (budget.waiting_downloads() != 0 || budget.used_descriptors() != 1)
+    {
+        std::cerr << mode << ": the timed out download is left in the budget\n";
+
+        return false;
+    }
+
+    std::thread releasing_thread{
+        [&budget, &holder]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+            budget.release(holder);
+        }};
+
+    error_code = download(is_async, budget, std::chrono::seconds(10));
+
+    releasing_thread.join();
+
+    if (error_code)
+    {
+        std::cerr << mode << ": the download failed after the slot was returned: " << error_code.message() << "\n";
+
+        return false;
+    }
+
+    if (budget.used_descriptors() != 0)
+    {
+        std::cerr << mode << ": the slot isn't returned after the download\n";
+
+        return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    bool is_sync_passed = check_download(false);
+    bool is_async_passed = check_download(true);
+
+    return is_sync_passed && is_async_passed ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+#include <multipart_form_data/detail/handler_allocator.hpp>
+
+#include <cstddef>
+#include <iostream>
+#include <memory_resource>
+#include <set>
+#include <vector>
+
+// Memory resource that checks that the memory is deallocated by the resource that allocated it.
+class tracking_resource : public std::pmr::memory_resource
+{
+    public:
+        size_t outstanding_allocations() const noexcept
+        {
+            return _pointers.size();
+        }
+
+        size_t foreign_deallocations() const noexcept
+        {
+            return _foreign_deallocations;
+        }
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override
+        {
+            void* pointer = std::pmr::new_delete_resource()->allocate(bytes, alignment);
+
+            _pointers.insert(pointer);
+
+            return pointer;
+        }
+
+        void do_deallocate(void* pointer, size_t bytes, size_t alignment) override
+        {
+            if (_pointers.erase(pointer) == 0)
+            {
+                ++_foreign_deallocations;
+
+                return;
+            }
+
+            std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+
+        std::set<void*> _pointers{};
+        size_t _foreign_deallocations{0};
+};
+
+// The blocks that are in use while the upstream is switched, the ones that don't fit into the kept blocks
+// and the over-aligned ones have to be returned to the memory resource they were allocated from.
+int main()
+{
+    tracking_resource first_upstream;
+    tracking_resource second_upstream;
+
+    {
+        multipart_form_data::detail::handler_memory handler_memory;
+        handler_memory.upstream(&first_upstream);
+
+        struct allocation
+        {
+            void* pointer;
+            size_t bytes;
+            size_t alignment;
+        };
+
+        std::vector<allocation> allocations;
+
+        // More states at once than the kept blocks, and an over-aligned one
+        for (size_t i = 0; i < multipart_form_data::detail::handler_memory::blocks_count + 4; ++i)
+        {
+            allocations.push_back({handler_memory.allocate(64 + i, alignof(std::max_align_t)), 64 + i, alignof(std::max_align_t)});
+        }
+
+        allocations.push_back({handler_memory.allocate(256, 64), 256, 64});
+
+        handler_memory.upstream(&second_upstream);
+
+        for (const allocation& current_allocation : allocations)
+        {
+            handler_memory.deallocate(current_allocation.pointer, current_allocation.bytes, current_allocation.alignment);
+        }
+
+        // The blocks of the new upstream are kept until the handler memory is destroyed
+        void* pointer = handler_memory.allocate(64, alignof(std::max_align_t));
+        handler_memory.deallocate(pointer, 64, alignof(std::max_align_t));
+        pointer = handler_memory.allocate(128, 64);
+        handler_memory.deallocate(pointer, 128, 64);
+
+        if (first_upstream.outstanding_allocations() != 0)
+        {
+            std::cerr << first_upstream.outstanding_allocations() << " allocations of the previous upstream aren't returned\n";
+
+            return 1;
+        }
+    }
+
+    if (first_upstream.foreign_deallocations() != 0 || second_upstream.foreign_deallocations() != 0)
+    {
+        std::cerr 
+            << first_upstream.foreign_deallocations() + second_upstream.foreign_deallocations() 
+            << " blocks are returned to the memory resource that didn't allocate them\n";
+
+        return 1;
+    }
+
+    if (second_upstream.outstanding_allocations() != 0)
+    {
+        std::cerr << second_upstream.outstanding_allocations() << " blocks are leaked by the handler memory\n";
+
+        return 1;
+    }
+
+    return 0;
+}
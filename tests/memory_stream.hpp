@@ -0,0 +1,177 @@
+#ifndef MEMORY_STREAM_HPP
+#define MEMORY_STREAM_HPP
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/beast/core/bind_handler.hpp>
+#include <boost/system/system_error.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+// Stream of the tests that serves the request body from memory instead of the socket.
+namespace memory_streaming
+{
+    // Observer of the reads that does nothing.
+    struct no_read_observer
+    {
+        void operator()() noexcept
+        {}
+    };
+
+    // What the reads do once all the data of the stream is served.
+    enum class data_end
+    {
+        // The reads fail with asio::error::eof as the ones of the closed connection.
+        eof,
+        // The reads never complete as the ones of the client that stopped sending.
+        stall
+    };
+
+    // Stream that serves the data by reads of at most read_size bytes. The handlers of the asynchronous reads are posted
+    // to the executor, so the operations that wrap them allocate their states as they do with a socket. Each read invokes
+    // the observer before anything is copied, e.g. to record the state of the downloader at the read. The observer gets 
+    // the number of bytes that are served before the read if it accepts it.
+    // The stalled asynchronous read keeps the work of the io_context until it is destroyed along with the handler.
+    // The stream is the lowest layer itself and the data is in memory, so the expiry is accepted but the reads don't time out.
+    template<typename read_observer_t = no_read_observer>
+    class memory_stream
+    {
+        public:
+            using executor_type = boost::asio::io_context::executor_type;
+
+            memory_stream(
+                boost::asio::io_context& io_context,
+                std::string_view data,
+                size_t read_size = std::numeric_limits<size_t>::max(),
+                data_end end = data_end::eof,
+                read_observer_t observer = {})
+                :
+                _executor{io_context.get_executor()},
+                _data{data},
+                _read_size{std::max<size_t>(read_size, 1)},
+                _end{end},
+                _observer{std::move(observer)}
+            {}
+
+            executor_type get_executor() const noexcept
+            {
+                return _executor;
+            }
+
+            read_observer_t& observer() noexcept
+            {
+                return _observer;
+            }
+
+            template<typename mutable_buffer_sequence>
+            size_t read_some(const mutable_buffer_sequence& buffers, boost::system::error_code& error_code)
+            {
+                observe();
+
+                error_code = {};
+
+                // async_read_until reads into the empty buffer if the delimiter is already buffered,
+                // it completes right away as with a socket
+                if (boost::asio::buffer_size(buffers) == 0)
+                {
+                    return 0;
+                }
+
+                if (_data.empty())
+                {
+                    if (_end == data_end::eof)
+                    {
+                        error_code = boost::asio::error::eof;
+                    }
+                    else
+                    {
+                        error_code = boost::asio::error::would_block;
+                    }
+
+                    return 0;
+                }
+
+                size_t bytes_transferred = boost::asio::buffer_copy(
+                    buffers,
+                    boost::asio::buffer(_data.data(), std::min(_read_size, _data.size())));
+
+                _data.remove_prefix(bytes_transferred);
+                _served_size += bytes_transferred;
+
+                return bytes_transferred;
+            }
+
+            template<typename mutable_buffer_sequence>
+            size_t read_some(const mutable_buffer_sequence& buffers)
+            {
+                boost::system::error_code error_code;
+                size_t bytes_transferred = read_some(buffers, error_code);
+
+                if (error_code)
+                {
+                    throw boost::system::system_error{error_code};
+                }
+
+                return bytes_transferred;
+            }
+
+            template<typename mutable_buffer_sequence, typename read_handler>
+            void async_read_some(const mutable_buffer_sequence& buffers, read_handler&& handler)
+            {
+                if (_data.empty() && _end == data_end::stall && boost::asio::buffer_size(buffers) != 0)
+                {
+                    observe();
+
+                    _stalled_read.emplace(boost::asio::make_work_guard(_executor));
+
+                    return;
+                }
+
+                boost::system::error_code error_code;
+                size_t bytes_transferred = read_some(buffers, error_code);
+
+                boost::asio::post(
+                    _executor,
+                    boost::beast::bind_front_handler(std::forward<read_handler>(handler), error_code, bytes_transferred));
+            }
+
+            void expires_after(std::chrono::steady_clock::duration) noexcept
+            {}
+
+            void expires_never() noexcept
+            {}
+
+        private:
+            void observe()
+            {
+                if constexpr (std::is_invocable_v<read_observer_t&, size_t>)
+                {
+                    _observer(_served_size);
+                }
+                else
+                {
+                    _observer();
+                }
+            }
+
+            executor_type _executor;
+            std::string_view _data;
+            size_t _served_size{0};
+            size_t _read_size;
+            data_end _end;
+            read_observer_t _observer;
+            std::optional<boost::asio::executor_work_guard<executor_type>> _stalled_read{};
+    };
+}
+
+#endif
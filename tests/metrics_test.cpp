@@ -0,0 +1,62 @@
+#include <boost/asio/io_context.hpp>
+#include <boost/beast/core.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include <multipart_form_data/multipart_form_data.hpp>
+
+#include <memory_stream.hpp>
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+
+// Stream whose reads never complete, e.g. the client that stopped sending in the middle of the request body.
+// The handlers of the reads are destroyed along with the io_context.
+using stalled_stream = memory_streaming::memory_stream<>;
+
+// The downloader that is destroyed in the middle of the downloading process has to count it as finished,
+// otherwise the gauge of the active downloads grows with each such download.
+int main()
+{
+    multipart_form_data::download_metrics metrics;
+
+    {
+        asio::io_context io_context;
+        stalled_stream stream{io_context, {}, std::numeric_limits<size_t>::max(), memory_streaming::data_end::stall};
+        beast::flat_buffer buffer;
+        multipart_form_data::downloader<stalled_stream, beast::flat_buffer> form_data{stream, buffer};
+
+        form_data.async_download(
+            "multipart/form-data; boundary=----boundary",
+            {
+                .metrics = &metrics
+            },
+            [](beast::error_code, std::vector<std::filesystem::path>&&)
+            {},
+            std::make_shared<int>(0));
+
+        io_context.run_for(std::chrono::milliseconds(10));
+
+        if (metrics.active_downloads() != 1)
+        {
+            std::cerr << "the download isn't active while it waits for the request body\n";
+
+            return 1;
+        }
+    }
+
+    if (metrics.active_downloads() != 0)
+    {
+        std::cerr << metrics.active_downloads() << " active downloads after the downloader is destroyed\n";
+
+        return 1;
+    }
+
+    return 0;
+}
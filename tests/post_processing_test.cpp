@@ -0,0 +1,110 @@
+#include <boost/asio/io_context.hpp>
+#include <boost/beast/core.hpp>
+
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <multipart_form_data/multipart_form_data.hpp>
+
+#include <memory_stream.hpp>
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+
+using memory_stream = memory_streaming::memory_stream<>;
+
+// Download the request body with the handler of the post-processing that throws and return the result.
+beast::error_code download(bool is_async, multipart_form_data::download_metrics& metrics)
+{
+    std::string body =
+        "------boundary\r\n"
+        "Content-Disposition: form-data; name=\"file\"; filename=\"file.txt\"\r\n"
+        "Content-Type: text/plain\r\n\r\n"
+        "text\r\n"
+        "------boundary--\r\n";
+
+    std::filesystem::path output_directory = std::filesystem::temp_directory_path() / "multipart_form_data_post_processing_test";
+    std::filesystem::create_directories(output_directory);
+
+    multipart_form_data::post_processing_pool post_processing{1};
+    asio::io_context io_context;
+    memory_stream stream{io_context, body};
+    beast::flat_buffer buffer;
+    multipart_form_data::downloader<memory_stream, beast::flat_buffer> form_data{stream, buffer};
+    beast::error_code error_code;
+
+    multipart_form_data::downloader<memory_stream, beast::flat_buffer>::settings<> settings{
+        .output_directory = output_directory,
+        .metrics = &metrics,
+        .post_processing = &post_processing,
+        .on_process_file_handler =
+            [](const std::filesystem::path&)
+            {
+                throw std::runtime_error{"the file can't be processed"};
+            },
+        .wait_for_post_processing = true
+    };
+
+    if (is_async)
+    {
+        form_data.async_download(
+            "multipart/form-data; boundary=----boundary",
+            std::move(settings),
+            [&error_code](beast::error_code result, std::vector<std::filesystem::path>&&)
+            {
+                error_code = result;
+            },
+            std::make_shared<int>(0));
+
+        io_context.run();
+    }
+    else
+    {
+        form_data.sync_download("multipart/form-data; boundary=----boundary", std::move(settings), error_code);
+    }
+
+    std::filesystem::remove_all(output_directory);
+
+    return error_code;
+}
+
+// The failure of the post-processing has to be told apart from the download that is aborted by the handlers of the settings.
+int main()
+{
+    size_t label_index = 0;
+
+    while (multipart_form_data::download_metrics::error_labels[label_index].first != multipart_form_data::error::post_processing_failed)
+    {
+        ++label_index;
+    }
+
+    for (bool is_async : {false, true})
+    {
+        const char* mode = is_async ? "async" : "sync";
+
+        multipart_form_data::download_metrics metrics{1};
+        beast::error_code error_code = download(is_async, metrics);
+
+        if (error_code != multipart_form_data::error::post_processing_failed)
+        {
+            std::cerr << mode << ": the download finished with \"" << error_code.message() << "\"\n";
+
+            return 1;
+        }
+
+        if (metrics.errors(label_index) != 1)
+        {
+            std::cerr << mode << ": the failed post-processing isn't counted in the metrics\n";
+
+            return 1;
+        }
+    }
+
+    return 0;
+}
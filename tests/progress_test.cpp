@@ -0,0 +1,77 @@
+#include <multipart_form_data/progress.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The final events of the downloads have to be delivered even if the intermediate ones filled the queue while
+// the callback was busy, since no event comes after them.
+int main()
+{
+    std::atomic<bool> is_released{false};
+    std::mutex mutex;
+    std::vector<uint64_t> finished_downloads;
+
+    {
+        multipart_form_data::progress_reporter progress{
+            [&](const multipart_form_data::progress_event& event)
+            {
+                // The consumer is stalled until all events are published
+                while (!is_released.load())
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+
+                if (event.is_finished)
+                {
+                    std::lock_guard lock{mutex};
+
+                    finished_downloads.push_back(event.download_id);
+                }
+            },
+            std::chrono::milliseconds(100),
+            1024 * 1024,
+            8};
+
+        for (uint64_t i = 0; i < 100; ++i)
+        {
+            progress.publish({.download_id = i % 2, .received_bytes = i});
+        }
+
+        if (progress.dropped_events() == 0)
+        {
+            std::cerr << "the intermediate events aren't dropped with the full queue\n";
+
+            is_released.store(true);
+
+            return 1;
+        }
+
+        for (uint64_t i = 0; i < 2; ++i)
+        {
+            if (!progress.publish({.download_id = i, .is_finished = true}))
+            {
+                std::cerr << "the final event of the download " << i << " is dropped\n";
+
+                is_released.store(true);
+
+                return 1;
+            }
+        }
+
+        is_released.store(true);
+    }
+
+    if (finished_downloads != std::vector<uint64_t>{0, 1})
+    {
+        std::cerr << finished_downloads.size() << " final events are delivered instead of 2\n";
+
+        return 1;
+    }
+
+    return 0;
+}
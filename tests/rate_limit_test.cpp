@@ -0,0 +1,170 @@
+#include <boost/asio/io_context.hpp>
+#include <boost/beast/core.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <multipart_form_data/multipart_form_data.hpp>
+
+#include <memory_stream.hpp>
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+
+constexpr size_t packets_size = 1024 * 1024;
+constexpr size_t lowered_burst = 64 * 1024;
+
+// Memory resource that records the sizes of the allocations once the limit is lowered.
+class recording_resource : public std::pmr::memory_resource
+{
+    public:
+        bool is_recording{false};
+        std::vector<size_t> allocations{};
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override
+        {
+            if (is_recording)
+            {
+                allocations.push_back(bytes);
+            }
+
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* pointer, size_t bytes, size_t alignment) override
+        {
+            std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+};
+
+// Observer of the reads that lowers the burst of the bucket in the middle of the file body.
+struct limit_changer
+{
+    multipart_form_data::token_bucket* rate_limit;
+    recording_resource* memory_resource;
+    size_t reads{0};
+
+    void operator()()
+    {
+        if (++reads == 40)
+        {
+            rate_limit->limit(1024 * 1024 * 1024, lowered_burst);
+            memory_resource->is_recording = true;
+        }
+    }
+};
+
+using memory_stream = memory_streaming::memory_stream<limit_changer>;
+
+// Download the file of a few packets while the burst is lowered and return the allocations of the buffer after that.
+std::optional<std::vector<size_t>> download(bool is_async)
+{
+    std::string body =
+        "------boundary\r\n"
+        "Content-Disposition: form-data; name=\"file\"; filename=\"file.bin\"\r\n"
+        "Content-Type: application/octet-stream\r\n\r\n";
+
+    body += std::string(4 * packets_size, 'a');
+    body += "\r\n------boundary--\r\n";
+
+    std::filesystem::path output_directory = std::filesystem::temp_directory_path() / "multipart_form_data_rate_limit_test";
+    std::filesystem::create_directories(output_directory);
+
+    multipart_form_data::token_bucket rate_limit{1024 * 1024 * 1024, 16 * packets_size};
+    recording_resource memory_resource;
+    asio::io_context io_context;
+    memory_stream stream{
+        io_context,
+        body,
+        std::numeric_limits<size_t>::max(),
+        memory_streaming::data_end::eof,
+        limit_changer{&rate_limit, &memory_resource}};
+    beast::flat_buffer buffer;
+    multipart_form_data::downloader<memory_stream, beast::flat_buffer> form_data{stream, buffer, &memory_resource};
+    beast::error_code error_code;
+
+    multipart_form_data::downloader<memory_stream, beast::flat_buffer>::settings<> settings{
+        .packets_size = packets_size,
+        .output_directory = output_directory,
+        .rate_limit = &rate_limit
+    };
+
+    if (is_async)
+    {
+        form_data.async_download(
+            "multipart/form-data; boundary=----boundary",
+            std::move(settings),
+            [&error_code](beast::error_code result, std::vector<std::filesystem::path>&&)
+            {
+                error_code = result;
+            },
+            std::make_shared<int>(0));
+
+        io_context.run();
+    }
+    else
+    {
+        form_data.sync_download("multipart/form-data; boundary=----boundary", std::move(settings), error_code);
+    }
+
+    std::filesystem::remove_all(output_directory);
+
+    if (error_code)
+    {
+        std::cerr << (is_async ? "async" : "sync") << ": the download failed: " << error_code.message() << "\n";
+
+        return std::nullopt;
+    }
+
+    return memory_resource.allocations;
+}
+
+// The limit of the bucket is changed while the download is in progress, so the packets after the change have to be
+// capped by the new burst: the buffer of 1 MB packets is shrunk and doesn't grow beyond the new packets size again.
+int main()
+{
+    for (bool is_async : {false, true})
+    {
+        const char* mode = is_async ? "async" : "sync";
+
+        std::optional<std::vector<size_t>> allocations = download(is_async);
+
+        if (!allocations)
+        {
+            return 1;
+        }
+
+        if (allocations->empty())
+        {
+            std::cerr << mode << ": the buffer isn't shrunk after the burst is lowered\n";
+
+            return 1;
+        }
+
+        size_t max_allocation = *std::max_element(allocations->begin(), allocations->end());
+
+        if (max_allocation > 2 * lowered_burst)
+        {
+            std::cerr << mode << ": the buffer of " << max_allocation << " bytes is allocated for the burst of " << lowered_burst << " bytes\n";
+
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core.hpp>
+
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+
+#include <multipart_form_data/multipart_form_data.hpp>
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+
+using tcp = asio::ip::tcp;
+
+// The low watermark has to be a part of the packet that is actually read. The rate limit caps the packets by the burst
+// of the bucket, so the low watermark can't be derived from the requested packets size that is much larger.
+int main()
+{
+    constexpr size_t file_size = 1024 * 1024;
+    constexpr size_t burst = 64 * 1024;
+
+    std::string body =
+        "------boundary\r\n"
+        "Content-Disposition: form-data; name=\"file\"; filename=\"file.bin\"\r\n"
+        "Content-Type: application/octet-stream\r\n\r\n"
+        "------boundary\r\n"
+        "Content-Disposition: form-data; name=\"file\"; filename=\"file.bin\"\r\n"
+        "Content-Type: application/octet-stream\r\n\r\n";
+
+    // The first part is empty, so the header of the second one is read from the socket with the tuning applied
+    body += std::string(file_size, 'a');
+    body += "\r\n------boundary--\r\n";
+
+    std::filesystem::path output_directory = std::filesystem::temp_directory_path() / "multipart_form_data_socket_tuning_test";
+    std::filesystem::create_directories(output_directory);
+
+    asio::io_context io_context;
+    tcp::acceptor acceptor{io_context, tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}};
+    tcp::socket client{io_context};
+
+    client.connect(acceptor.local_endpoint());
+
+    tcp::socket socket = acceptor.accept();
+
+    std::thread sending_thread{
+        [&client, &body]()
+        {
+            boost::system::error_code error_code;
+
+            asio::write(client, asio::buffer(body), error_code);
+        }};
+
+    multipart_form_data::token_bucket rate_limit{1024 * 1024 * 1024, burst};
+    beast::flat_buffer buffer;
+    multipart_form_data::downloader<tcp::socket, beast::flat_buffer> form_data{socket, buffer};
+    beast::error_code error_code;
+    std::vector<int> low_watermarks;
+
+    form_data.sync_download(
+        "multipart/form-data; boundary=----boundary",
+        {
+            .output_directory = output_directory,
+            .on_read_file_header_handler =
+                [&socket, &low_watermarks](std::string_view)
+                {
+                    int low_watermark = 0;
+                    socklen_t size = sizeof(low_watermark);
+
+                    getsockopt(socket.native_handle(), SOL_SOCKET, SO_RCVLOWAT, &low_watermark, &size);
+
+                    low_watermarks.push_back(low_watermark);
+
+                    return std::filesystem::path{};
+                },
+            .tune_socket = true,
+            .content_length = body.size(),
+            .rate_limit = &rate_limit
+        },
+        error_code);
+
+    sending_thread.join();
+
+    std::filesystem::remove_all(output_directory);
+
+    if (error_code || low_watermarks.size() != 2)
+    {
+        std::cerr << "the download failed: " << error_code.message() << "\n";
+
+        return 1;
+    }
+
+    // The packets are capped by the burst, so the low watermark is its part instead of the one of 10 MB packets
+    if (low_watermarks[1] <= 1 || static_cast<size_t>(low_watermarks[1]) > burst / 4)
+    {
+        std::cerr << "the low watermark is " << low_watermarks[1] << " bytes for the packets of " << burst << " bytes\n";
+
+        return 1;
+    }
+
+    return 0;
+}
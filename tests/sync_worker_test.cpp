@@ -0,0 +1,117 @@
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/write.hpp>
+
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <poll.h>
+
+#include <sync_downloading.hpp>
+
+// Connect to the acceptor, send the data and pass the accepted connection to the queue.
+tcp::socket connect(asio::io_context& io_context, tcp::acceptor& acceptor, connection_queue& queue, std::string_view data)
+{
+    tcp::socket client{io_context};
+
+    client.connect(acceptor.local_endpoint());
+
+    tcp::socket socket = acceptor.accept();
+
+    asio::write(client, asio::buffer(data));
+
+    queue.try_push(socket);
+
+    return client;
+}
+
+// Read the response until the connection is closed or the timeout expires.
+std::string read_response(tcp::socket& client, std::chrono::milliseconds timeout)
+{
+    std::string response;
+    std::chrono::steady_clock::time_point expiry = std::chrono::steady_clock::now() + timeout;
+
+    for (;;)
+    {
+        std::chrono::milliseconds rest = std::chrono::ceil<std::chrono::milliseconds>(expiry - std::chrono::steady_clock::now());
+        pollfd socket_events{.fd = client.native_handle(), .events = POLLIN, .revents = 0};
+
+        if (rest.count() <= 0 || ::poll(&socket_events, 1, static_cast<int>(rest.count())) <= 0)
+        {
+            return response;
+        }
+
+        std::array<char, 4096> data;
+        beast::error_code error_code;
+        size_t bytes_transferred = client.read_some(asio::buffer(data), error_code);
+
+        response.append(data.data(), bytes_transferred);
+
+        if (error_code || response.find("downloaded") != std::string::npos)
+        {
+            return response;
+        }
+    }
+}
+
+// The only worker of the pool gets a client that sends one byte of the header and a client that stops in the middle
+// of the body before the one that sends the whole request. The stalled clients have to be dropped by the timeouts,
+// so the whole request is served in time instead of waiting behind them forever.
+int main()
+{
+    constexpr std::string_view file_name = "multipart_form_data_sync_worker_test.txt";
+
+    std::string body =
+        "------boundary\r\n"
+        "Content-Disposition: form-data; name=\"file\"; filename=\"" + std::string{file_name} + "\"\r\n"
+        "Content-Type: text/plain\r\n\r\n"
+        "text\r\n"
+        "------boundary--\r\n";
+
+    std::string header =
+        "POST / HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "Content-Type: multipart/form-data; boundary=----boundary\r\n"
+        "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+
+    asio::io_context io_context;
+    tcp::acceptor acceptor{io_context, tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}};
+    connection_queue queue{8};
+    sync_worker worker{io_context, queue, std::chrono::milliseconds(200), std::chrono::milliseconds(300)};
+    std::thread worker_thread{[&worker]() { worker.run(); }};
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    tcp::socket one_byte_client = connect(io_context, acceptor, queue, header.substr(0, 1));
+    tcp::socket stalled_body_client = connect(io_context, acceptor, queue, header + body.substr(0, body.size() / 2));
+    tcp::socket client = connect(io_context, acceptor, queue, header + body);
+
+    std::string response = read_response(client, std::chrono::seconds(5));
+    std::chrono::steady_clock::duration duration = std::chrono::steady_clock::now() - start;
+
+    queue.close();
+    worker_thread.join();
+
+    std::filesystem::remove(std::filesystem::path{".."} / file_name);
+
+    if (response.find("Successfully downloaded files") == std::string::npos)
+    {
+        std::cerr << "the request behind the stalled clients isn't served, the response is \"" << response << "\"\n";
+
+        return 1;
+    }
+
+    if (duration > std::chrono::seconds(3))
+    {
+        std::cerr << "the stalled clients held the worker for "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(duration).count() << " ms\n";
+
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,249 @@
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <multipart_form_data/multipart_form_data.hpp>
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+
+using tcp = asio::ip::tcp;
+
+// Connect a client to the acceptor and return the accepted socket.
+tcp::socket connect(tcp::acceptor& acceptor, tcp::socket& client)
+{
+    client.connect(acceptor.local_endpoint());
+
+    return acceptor.accept();
+}
+
+// The synchronous read of the stream that doesn't receive anything has to fail at the deadline.
+bool check_sync_read_timeout(asio::io_context& io_context, multipart_form_data::uring_context& context, tcp::acceptor& acceptor)
+{
+    tcp::socket client{io_context};
+    multipart_form_data::uring_stream stream{context, connect(acceptor, client)};
+
+    stream.expires_after(std::chrono::milliseconds(200));
+
+    char data[16];
+    boost::system::error_code error_code;
+
+    auto start = std::chrono::steady_clock::now();
+
+    stream.read_some(asio::buffer(data), error_code);
+
+    if (error_code != beast::error::timeout)
+    {
+        std::cerr << "sync read finished with \"" << error_code.message() << "\" instead of the timeout\n";
+
+        return false;
+    }
+
+    if (std::chrono::steady_clock::now() - start > std::chrono::seconds(5))
+    {
+        std::cerr << "sync read timed out too late\n";
+
+        return false;
+    }
+
+    return true;
+}
+
+// io_context::run has to return once the only stream received its data and is closed.
+bool check_run_returns(asio::io_context& io_context, multipart_form_data::uring_context& context, tcp::acceptor& acceptor)
+{
+    tcp::socket client{io_context};
+    multipart_form_data::uring_stream stream{context, connect(acceptor, client)};
+
+    asio::write(client, asio::buffer(std::string_view{"data"}));
+
+    char data[16];
+    size_t received_size = 0;
+
+    stream.async_read_some(
+        asio::buffer(data),
+        [&](const boost::system::error_code&, size_t bytes_transferred)
+        {
+            received_size = bytes_transferred;
+
+            stream.close();
+        });
+
+    std::future<void> run_result = std::async(std::launch::async, [&]() { io_context.run(); });
+
+    if (run_result.wait_for(std::chrono::seconds(5)) != std::future_status::ready)
+    {
+        std::cerr << "io_context::run didn't return after the stream was closed\n";
+
+        io_context.stop();
+
+        return false;
+    }
+
+    if (received_size == 0)
+    {
+        std::cerr << "nothing is received\n";
+
+        return false;
+    }
+
+    return true;
+}
+
+// The download whose client stops in the middle of the file body has to write the received part of the packet
+// and release its buffer while it waits for the rest, then the file has to be whole once the rest arrives.
+bool check_idle_download(
+    asio::io_context& io_context, 
+    multipart_form_data::uring_context& context, 
+    tcp::acceptor& acceptor, 
+    bool is_async)
+{
+    const char* mode = is_async ? "async" : "sync";
+
+    std::string file_data(256 * 1024, ' ');
+
+    for (size_t i = 0; i < file_data.size(); ++i)
+    {
+        file_data[i] = static_cast<char>('a' + i % 26);
+    }
+
+    std::string first_half =
+        "------boundary\r\n"
+        "Content-Disposition: form-data; name=\"file\"; filename=\"file.bin\"\r\n"
+        "Content-Type: application/octet-stream\r\n\r\n" + file_data.substr(0, file_data.size() / 2);
+    std::string second_half = file_data.substr(file_data.size() / 2) + "\r\n------boundary--\r\n";
+
+    std::filesystem::path output_directory = std::filesystem::temp_directory_path() / "multipart_form_data_uring_test";
+    std::filesystem::create_directories(output_directory);
+
+    tcp::socket client{io_context};
+    multipart_form_data::uring_stream stream{context, connect(acceptor, client)};
+    multipart_form_data::download_metrics metrics;
+    beast::flat_buffer buffer;
+    multipart_form_data::downloader<multipart_form_data::uring_stream, beast::flat_buffer> form_data{stream, buffer};
+    beast::error_code error_code;
+    std::vector<std::filesystem::path> file_paths;
+    int64_t idle_buffer_memory = -1;
+
+    asio::write(client, asio::buffer(first_half));
+
+    // The rest is sent once the downloader has taken the first half and waits for the data
+    std::thread sending_thread{
+        [&]()
+        {
+            while (metrics.bytes_received() < first_half.size())
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+            idle_buffer_memory = metrics.buffer_memory();
+
+            asio::write(client, asio::buffer(second_half));
+        }};
+
+    multipart_form_data::downloader<multipart_form_data::uring_stream, beast::flat_buffer>::settings<> settings{
+        .packets_size = 1024 * 1024,
+        .output_directory = output_directory,
+        .metrics = &metrics
+    };
+
+    if (is_async)
+    {
+        form_data.async_download(
+            "multipart/form-data; boundary=----boundary",
+            std::move(settings),
+            [&error_code, &file_paths, &stream](beast::error_code result, std::vector<std::filesystem::path>&& downloaded_paths)
+            {
+                error_code = result;
+                file_paths = std::move(downloaded_paths);
+
+                // The armed stream keeps the context waiting for the completions, so run returns once it's closed
+                stream.close();
+            },
+            std::make_shared<int>(0));
+
+        io_context.restart();
+        io_context.run();
+    }
+    else
+    {
+        file_paths = form_data.sync_download("multipart/form-data; boundary=----boundary", std::move(settings), error_code);
+    }
+
+    sending_thread.join();
+
+    std::string downloaded_data;
+
+    if (file_paths.size() == 1)
+    {
+        std::ifstream file{file_paths.front(), std::ios::binary};
+
+        downloaded_data.assign(std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{});
+    }
+
+    std::filesystem::remove_all(output_directory);
+
+    if (error_code || downloaded_data != file_data)
+    {
+        std::cerr << mode << ": the download failed: " << error_code.message() << "\n";
+
+        return false;
+    }
+
+    // The part of the packet that can be the beginning of the boundary is kept only
+    if (context.is_available() && idle_buffer_memory > 1024)
+    {
+        std::cerr << mode << ": the idle download holds the buffer of " << idle_buffer_memory << " bytes\n";
+
+        return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    asio::io_context io_context;
+    multipart_form_data::uring_context context{io_context};
+
+    if (!context.is_available())
+    {
+        std::cerr << "io_uring is not available, the reads go through the reactor: " << context.setup_error().message() << "\n";
+    }
+
+    tcp::acceptor acceptor{io_context, tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}};
+
+    if (!check_sync_read_timeout(io_context, context, acceptor))
+    {
+        return 1;
+    }
+
+    if (!check_run_returns(io_context, context, acceptor))
+    {
+        return 1;
+    }
+
+    if (!check_idle_download(io_context, context, acceptor, false) || !check_idle_download(io_context, context, acceptor, true))
+    {
+        return 1;
+    }
+
+    return 0;
+}